@@ -0,0 +1,567 @@
+/*
+ Micro-benchmarks of the render path.
+
+ Runs every hot kernel in isolation on synthetic frames, at 640x360, 1080p and 4K by
+ default, and reports the median time per frame, the pixel rate and the effective memory
+ bandwidth next to a memcpy of the same frame. With --json the results are printed as one
+ JSON document, so runs can be stored and compared.
+
+ Bandwidth figures are nominal: every kernel declares how many bytes per pixel it reads
+ and writes in one pass, overlays included, so they show how close a kernel gets to the
+ memcpy baseline rather than exact DRAM traffic.
+
+ The audio analysis FFT is measured separately, per transform size: the median time of
+ one real transform and its error against a double-precision reference DFT.
+
+ Build (Linux or macOS, from the repository root):
+
+   cc -std=c99 -O2 -D_GNU_SOURCE -IMilky/Visualizer -o milky-bench \
+      Milky/Bench/bench.c $(find Milky/Visualizer -name '*.c') -lm -lpthread
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "video.h"
+#include "audio/sound.h"
+#include "audio/fft.h"
+#include "video/draw.h"
+#include "video/blend.h"
+#include "video/stroke.h"
+#include "video/blur.h"
+#include "video/palette.h"
+#include "video/bitdepth.h"
+#include "video/transform.h"
+#include "video/mesh.h"
+#include "video/kernels.h"
+#include "video/effects/chaser.h"
+
+// upper bound for timed calls per kernel and size
+#define MILKY_BENCH_MAX_SAMPLES 4096
+
+// upper bound for --size arguments
+#define MILKY_BENCH_MAX_SIZES 8
+
+// number of samples of the synthetic waveform
+#define MILKY_BENCH_WAVEFORM 1024
+
+// real FFT sizes of the analysis table: the app's analysis sizes and beyond
+static const size_t milky_benchFftSizes[] = { 128, 256, 512, 1024, 2048, 4096, 8192 };
+
+// buffers and state shared by all kernels of one canvas size
+typedef struct {
+    size_t width;
+    size_t height;
+    size_t frameSize;
+    uint8_t *frame;
+    uint8_t *scratch;
+    uint8_t waveform[MILKY_BENCH_WAVEFORM];
+    uint8_t spectrum[MILKY_BENCH_WAVEFORM];
+    float emphasized[MILKY_BENCH_WAVEFORM];
+    MilkyPalette palette;
+    MilkyRotationState rotation;
+    MilkySoundState sound;
+    MilkyChaserState chasers;
+    MilkyWarpMesh mesh;
+    MilkyRenderContext *context;
+    size_t call;
+} MilkyBench;
+
+// one benchmarked kernel: a single call processes one frame
+typedef struct {
+    const char *name;
+    size_t bytesPerPixel; // nominal bytes read and written per pixel
+    void (*run)(MilkyBench *bench);
+} MilkyBenchKernel;
+
+static void benchMemcpy(MilkyBench *bench) {
+    memcpy(bench->scratch, bench->frame, bench->frameSize);
+}
+
+static void benchSetPixel(MilkyBench *bench) {
+    for (size_t y = 0; y < bench->height; y++) {
+        for (size_t x = 0; x < bench->width; x++) {
+            setPixel(bench->frame, bench->width, bench->height, (int)x, (int)y, 255, 255, 255, 128);
+        }
+    }
+}
+
+static void benchBlendSpan(MilkyBench *bench) {
+    // the pixels of benchSetPixel(), one span per row
+    uint32_t color = premultiplyColor(255, 255, 255, 128);
+    for (size_t y = 0; y < bench->height; y++) {
+        blendSpan(bench->frame, bench->width, bench->height, 0, (int)y, (int)bench->width, color, MILKY_BLEND_OVER);
+    }
+}
+
+static void benchDrawLine(MilkyBench *bench) {
+    // a polyline across the canvas, one segment per waveform sample
+    int previousY = (int)(bench->waveform[0] * bench->height / 256);
+    for (size_t i = 1; i < MILKY_BENCH_WAVEFORM; i++) {
+        int x0 = (int)((i - 1) * bench->width / MILKY_BENCH_WAVEFORM);
+        int x1 = (int)(i * bench->width / MILKY_BENCH_WAVEFORM);
+        int y = (int)(bench->waveform[i] * bench->height / 256);
+        drawLine(bench->frame, bench->width, bench->height, x0, previousY, x1, y, 255, 255, 255, 255);
+        previousY = y;
+    }
+}
+
+static void benchStrokePolyline(MilkyBench *bench) {
+    // the same polyline as one thick stroke with joins and a fading tail
+    MilkyStrokePoint points[MILKY_BENCH_WAVEFORM];
+    for (size_t i = 0; i < MILKY_BENCH_WAVEFORM; i++) {
+        points[i] = (MilkyStrokePoint){
+            (float)(i * bench->width) / MILKY_BENCH_WAVEFORM,
+            bench->waveform[i] * (float)bench->height / 256,
+            (float)i / (MILKY_BENCH_WAVEFORM - 1)
+        };
+    }
+    MilkyStrokeStyle style = { .width = 3.0f, .color = premultiplyColor(255, 255, 255, 255), .mode = MILKY_BLEND_OVER };
+    strokePolyline(bench->frame, bench->width, bench->height, points, MILKY_BENCH_WAVEFORM, &style, 1, 0, bench->height);
+}
+
+static void benchBlurFrame(MilkyBench *bench) {
+    blurFrame(bench->frame, bench->frameSize, 2, 0.9f);
+}
+
+static void benchPreserveMassFade(MilkyBench *bench) {
+    preserveMassFade(bench->frame, bench->scratch, bench->frameSize);
+}
+
+static void benchApplyPalette(MilkyBench *bench) {
+    applyPaletteToRows(&bench->palette, bench->frame, bench->width, 0, bench->height);
+}
+
+static void benchReduceBitDepth(MilkyBench *bench) {
+    reduceBitDepth(bench->frame, bench->width, bench->height, 16);
+}
+
+static void benchRotate(MilkyBench *bench) {
+    rotate(&bench->rotation, bench->scratch, bench->frame, bench->width, bench->height);
+}
+
+static void benchScale(MilkyBench *bench) {
+    scale(bench->frame, bench->scratch, 1.02f, bench->width, bench->height);
+}
+
+static void benchWarpAffine(MilkyBench *bench) {
+    warpAffine(bench->frame, bench->scratch, bench->width, bench->height, 0.02f, 1.02f, 0.7f, MILKY_WARP_SAMPLE_NEAREST);
+}
+
+static void benchMeshWarp(MilkyBench *bench) {
+    meshWarp(&bench->mesh, bench->frame, bench->scratch, 0.7f, MILKY_WARP_SAMPLE_NEAREST);
+}
+
+static void benchRenderWaveform(MilkyBench *bench) {
+    // the layers of render()
+    static const MilkyStrokeStyle layers[] = {
+        { .width = MILKY_WAVEFORM_THICKNESS, .glow = 1.0f, .glowAlpha = 0.25f, .color = 0xFFFFFFFFu, .mode = MILKY_BLEND_OVER },
+        { .width = MILKY_WAVEFORM_THICKNESS + 2, .color = 0x40404040u, .mode = MILKY_BLEND_OVER, .offsetY = 1.0f }
+    };
+    renderWaveform(&bench->sound, bench->frame, bench->width, bench->height,
+                   bench->emphasized, MILKY_BENCH_WAVEFORM, layers, 2);
+}
+
+static void benchRenderChasers(MilkyBench *bench) {
+    renderChasers(&bench->chasers, 0.016f * (float)bench->call, bench->frame, 0.7f, 2, bench->width, bench->height, 42, 2);
+}
+
+static void benchRenderManyChasers(MilkyBench *bench) {
+    renderChasers(&bench->chasers, 0.016f * (float)bench->call, bench->frame, 0.7f, MILKY_MAX_CHASERS, bench->width, bench->height, 42, 2);
+}
+
+static void benchUpscale(MilkyBench *bench) {
+    // from the lowest but one step of the resolution governor
+    upscaleFrame(bench->context, bench->frame, bench->width * 5 / 8, bench->height * 5 / 8,
+                 bench->scratch, bench->width, bench->height);
+}
+
+static void benchRender(MilkyBench *bench) {
+    render(bench->context, bench->frame, bench->width, bench->height, bench->waveform, bench->spectrum,
+           MILKY_BENCH_WAVEFORM, MILKY_BENCH_WAVEFORM, 32, NULL, 0.035f, 1000 + bench->call * 16, 44100);
+}
+
+static const MilkyBenchKernel milky_benchKernels[] = {
+    { "memcpy", 8, benchMemcpy },
+    { "setPixel", 8, benchSetPixel },
+    { "blendSpan", 8, benchBlendSpan },
+    { "drawLine", 0, benchDrawLine },
+    { "strokePolyline", 0, benchStrokePolyline },
+    { "blurFrame", 8, benchBlurFrame },
+    { "preserveMassFade", 12, benchPreserveMassFade },
+    { "applyPalette", 8, benchApplyPalette },
+    { "reduceBitDepth", 8, benchReduceBitDepth },
+    { "rotate", 24, benchRotate },
+    { "scale", 16, benchScale },
+    { "warpAffine", 12, benchWarpAffine },
+    { "meshWarp", 12, benchMeshWarp },
+    { "renderWaveform", 0, benchRenderWaveform },
+    { "renderChasers", 0, benchRenderChasers },
+    { "renderManyChasers", 0, benchRenderManyChasers },
+    { "upscale", 6, benchUpscale },
+    { "render", 0, benchRender }
+};
+
+/**
+ * Fills a buffer with reproducible pseudo-random bytes (xorshift32).
+ */
+static void fillBytes(uint8_t *buf, size_t size, uint32_t seed) {
+    uint32_t state = seed ? seed : 1;
+    for (size_t i = 0; i < size; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        buf[i] = (uint8_t)(state >> 24);
+    }
+}
+
+/**
+ * Allocates the buffers of one canvas size and fills them with synthetic content.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int setupBench(MilkyBench *bench, size_t width, size_t height, size_t threads) {
+    memset(bench, 0, sizeof(MilkyBench));
+    bench->width = width;
+    bench->height = height;
+    bench->frameSize = width * height * 4;
+    bench->frame = (uint8_t *)malloc(bench->frameSize);
+    bench->scratch = (uint8_t *)malloc(bench->frameSize);
+    bench->context = createRenderContext();
+    if (!bench->frame || !bench->scratch || !bench->context) {
+        fprintf(stderr, "Failed to allocate %zux%zu benchmark buffers\n", width, height);
+        return -1;
+    }
+    setRenderThreadCount(bench->context, threads);
+    setRenderSeed(bench->context, 1);
+
+    fillBytes(bench->frame, bench->frameSize, 0xC0FFEEu);
+    fillBytes(bench->scratch, bench->frameSize, 0xBEEFu);
+    for (size_t i = 0; i < MILKY_BENCH_WAVEFORM; i++) {
+        bench->waveform[i] = (uint8_t)(128 + 100 * sinf(i * 0.05f));
+        bench->spectrum[i] = (uint8_t)((i * 7) & 255);
+    }
+    smoothBassEmphasizedWaveform(&bench->sound, bench->waveform, MILKY_BENCH_WAVEFORM, bench->emphasized, width, 0.7f);
+    seedRandom(&bench->palette.random, 1, MILKY_RANDOM_PALETTE);
+    updatePalette(&bench->palette, 1, 0);
+
+    // the zoom of the default preset with a slight rotation
+    MilkyMotionParams motion = { .zoom = 1.35f, .theta = 0.02f, .time = 1.0f };
+    initWarpMesh(&bench->mesh);
+    meshEvaluate(&bench->mesh, &motion, width, height);
+    return 0;
+}
+
+static void teardownBench(MilkyBench *bench) {
+    destroyRenderContext(bench->context);
+    free(bench->frame);
+    free(bench->scratch);
+}
+
+static double nowSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Calls a kernel until `minSeconds` have passed (at least three times) and returns the
+ * median time of one call in nanoseconds.
+ */
+static double timeKernel(const MilkyBenchKernel *kernel, MilkyBench *bench, double minSeconds, size_t *calls) {
+    static double samples[MILKY_BENCH_MAX_SAMPLES];
+    size_t count = 0;
+
+    kernel->run(bench); // warm-up: caches, lazily built tables, worker threads
+    bench->call++;
+
+    double start = nowSeconds();
+    while (count < MILKY_BENCH_MAX_SAMPLES && (count < 3 || nowSeconds() - start < minSeconds)) {
+        double before = nowSeconds();
+        kernel->run(bench);
+        samples[count++] = (nowSeconds() - before) * 1e9;
+        bench->call++;
+    }
+
+    qsort(samples, count, sizeof(double), compareDoubles);
+    *calls = count;
+    return samples[count / 2];
+}
+
+/**
+ * Compares a spectrum of fftForwardReal() with a double-precision DFT of the same samples.
+ *
+ * @param rmsError Receives the RMS error of all bins, relative to the largest magnitude.
+ * @return         The largest error of a bin, relative to the largest magnitude.
+ */
+static double compareWithDft(const float *input, size_t n, const float *re, const float *im, double *rmsError) {
+    double maxError = 0.0, sumSquares = 0.0, maxMagnitude = 0.0;
+    for (size_t k = 0; k <= n / 2; k++) {
+        double sumRe = 0.0, sumIm = 0.0;
+        for (size_t j = 0; j < n; j++) {
+            double angle = -2.0 * M_PI * (double)((j * k) % n) / (double)n;
+            sumRe += input[j] * cos(angle);
+            sumIm += input[j] * sin(angle);
+        }
+
+        // packed layout: the Nyquist bin is stored in im[0]
+        double binRe = k == 0 ? re[0] : (k == n / 2 ? im[0] : re[k]);
+        double binIm = k == 0 || k == n / 2 ? 0.0 : im[k];
+        double error = hypot(binRe - sumRe, binIm - sumIm);
+        double magnitude = hypot(sumRe, sumIm);
+        if (error > maxError) maxError = error;
+        if (magnitude > maxMagnitude) maxMagnitude = magnitude;
+        sumSquares += error * error;
+    }
+    *rmsError = sqrt(sumSquares / (double)(n / 2 + 1)) / maxMagnitude;
+    return maxError / maxMagnitude;
+}
+
+/**
+ * Times real transforms of one size until `minSeconds` have passed (at least three) and
+ * returns the median time of one transform in nanoseconds.
+ */
+static double timeFft(const MilkyFftPlan *plan, const float *input, float *re, float *im, double minSeconds, size_t *calls) {
+    static double samples[MILKY_BENCH_MAX_SAMPLES];
+    size_t count = 0;
+
+    fftForwardReal(plan, input, re, im);
+
+    double start = nowSeconds();
+    while (count < MILKY_BENCH_MAX_SAMPLES && (count < 3 || nowSeconds() - start < minSeconds)) {
+        double before = nowSeconds();
+        for (int r = 0; r < 16; r++) {
+            fftForwardReal(plan, input, re, im);
+        }
+        samples[count++] = (nowSeconds() - before) * 1e9 / 16;
+    }
+
+    qsort(samples, count, sizeof(double), compareDoubles);
+    *calls = count * 16;
+    return samples[count / 2];
+}
+
+/**
+ * Runs the FFT table: speed and accuracy of every size of milky_benchFftSizes.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int benchFft(FILE *report, int json, double minSeconds) {
+    const size_t maxSize = milky_benchFftSizes[sizeof(milky_benchFftSizes) / sizeof(milky_benchFftSizes[0]) - 1];
+    float *input = (float *)malloc(maxSize * sizeof(float));
+    float *re = (float *)malloc(maxSize / 2 * sizeof(float));
+    float *im = (float *)malloc(maxSize / 2 * sizeof(float));
+    if (!input || !re || !im) {
+        fprintf(stderr, "Failed to allocate the FFT benchmark buffers\n");
+        free(input);
+        free(re);
+        free(im);
+        return -1;
+    }
+
+    // a tone, a harmonic and noise, like a window of music
+    uint8_t noise[4096];
+    fillBytes(noise, sizeof(noise), 0xF00Du);
+    for (size_t i = 0; i < maxSize; i++) {
+        input[i] = 0.5f * sinf(i * 0.0627f) + 0.25f * sinf(i * 0.3301f) + (noise[i % sizeof(noise)] - 127.5f) / 1024.0f;
+    }
+
+    if (json) {
+        fprintf(report, ",\n  \"fftVariant\": \"%s\",\n  \"fft\": [", getFftVariant());
+    } else {
+        fprintf(report, "fft: %s\n\n%-18s %11s %14s %10s %10s %9s\n", getFftVariant(),
+                "transform", "size", "ns/transform", "Msamples/s", "max error", "rms error");
+    }
+
+    size_t sizeCount = sizeof(milky_benchFftSizes) / sizeof(milky_benchFftSizes[0]);
+    for (size_t s = 0; s < sizeCount; s++) {
+        size_t n = milky_benchFftSizes[s];
+        const MilkyFftPlan *plan = getFftPlan(n);
+        if (!plan) continue;
+
+        size_t calls = 0;
+        double ns = timeFft(plan, input, re, im, minSeconds, &calls);
+        double rmsError;
+        double maxError = compareWithDft(input, n, re, im, &rmsError);
+
+        if (json) {
+            fprintf(report, "%s\n    { \"size\": %zu, \"calls\": %zu, \"nsPerTransform\": %.1f, "
+                    "\"maxError\": %.3e, \"rmsError\": %.3e }",
+                    s == 0 ? "" : ",", n, calls, ns, maxError, rmsError);
+        } else {
+            fprintf(report, "%-18s %11zu %14.1f %10.1f %10.2e %9.2e\n", "fftForwardReal", n, ns, n / ns * 1e3,
+                    maxError, rmsError);
+        }
+    }
+    if (json) {
+        fprintf(report, "\n  ]");
+    } else {
+        fputc('\n', report);
+    }
+
+    free(input);
+    free(re);
+    free(im);
+    return 0;
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "\n"
+        "  -s, --size WxH         canvas size, may be repeated (default 640x360, 1920x1080, 3840x2160)\n"
+        "  -f, --filter NAME      only run kernels whose name contains NAME (\"fft\" for the FFT table)\n"
+        "  -k, --kernels NAME     force a SIMD kernel and FFT set (avx2, sse2, neon, scalar)\n"
+        "  -T, --time SECONDS     minimum time per kernel and size (default 0.25)\n"
+        "  -t, --threads N        render threads of the full render() benchmark, 0 = all cores (default 1)\n"
+        "  -j, --json             print the results as JSON\n",
+        program);
+}
+
+int main(int argc, char **argv) {
+    static const struct option longOptions[] = {
+        { "size", required_argument, NULL, 's' },
+        { "filter", required_argument, NULL, 'f' },
+        { "kernels", required_argument, NULL, 'k' },
+        { "time", required_argument, NULL, 'T' },
+        { "threads", required_argument, NULL, 't' },
+        { "json", no_argument, NULL, 'j' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    size_t widths[MILKY_BENCH_MAX_SIZES] = { 640, 1920, 3840 };
+    size_t heights[MILKY_BENCH_MAX_SIZES] = { 360, 1080, 2160 };
+    size_t sizeCount = 3;
+    int customSizes = 0;
+    const char *filter = NULL;
+    double minSeconds = 0.25;
+    size_t threads = 1;
+    int json = 0;
+
+    int option;
+    while ((option = getopt_long(argc, argv, "s:f:k:T:t:jh", longOptions, NULL)) != -1) {
+        switch (option) {
+            case 's': {
+                unsigned long width = 0, height = 0;
+                if (sscanf(optarg, "%lux%lu", &width, &height) != 2 || width == 0 || height == 0) {
+                    fprintf(stderr, "Invalid size: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                if (!customSizes) sizeCount = 0;
+                customSizes = 1;
+                if (sizeCount < MILKY_BENCH_MAX_SIZES) {
+                    widths[sizeCount] = width;
+                    heights[sizeCount] = height;
+                    sizeCount++;
+                }
+                break;
+            }
+            case 'f':
+                filter = optarg;
+                break;
+            case 'k':
+                if (!setKernels(optarg) || !setFftVariant(optarg)) return EXIT_FAILURE;
+                break;
+            case 'T':
+                minSeconds = atof(optarg);
+                break;
+            case 't':
+                threads = (size_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'j':
+                json = 1;
+                break;
+            case 'h':
+                printUsage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    // the renderer reports events on stdout, which would break the JSON document
+    FILE *report = stdout;
+    if (json) {
+        fflush(stdout);
+        report = fdopen(dup(STDOUT_FILENO), "w");
+        if (!report || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            fprintf(stderr, "Failed to redirect stdout\n");
+            return EXIT_FAILURE;
+        }
+        fprintf(report, "{\n  \"kernelSet\": \"%s\",\n  \"threads\": %zu,\n  \"results\": [", getKernels()->name, threads);
+    } else {
+        fprintf(report, "kernel set: %s\n\n%-18s %11s %14s %10s %10s %9s\n", getKernels()->name,
+                "kernel", "size", "ns/frame", "Mpx/s", "GB/s", "of memcpy");
+    }
+
+    size_t kernelCount = sizeof(milky_benchKernels) / sizeof(milky_benchKernels[0]);
+    int first = 1;
+    for (size_t s = 0; s < sizeCount; s++) {
+        MilkyBench *bench = (MilkyBench *)malloc(sizeof(MilkyBench));
+        if (!bench || setupBench(bench, widths[s], heights[s], threads) != 0) {
+            if (bench) teardownBench(bench);
+            free(bench);
+            return EXIT_FAILURE;
+        }
+
+        double pixels = (double)widths[s] * heights[s];
+        double memcpyGbPerSecond = 0.0;
+        for (size_t k = 0; k < kernelCount; k++) {
+            const MilkyBenchKernel *kernel = &milky_benchKernels[k];
+            int isBaseline = k == 0;
+            if (!isBaseline && filter && !strstr(kernel->name, filter)) continue;
+
+            size_t calls = 0;
+            double ns = timeKernel(kernel, bench, minSeconds, &calls);
+            double mpxPerSecond = pixels / ns * 1e3;
+            double gbPerSecond = kernel->bytesPerPixel * pixels / ns;
+            if (isBaseline) memcpyGbPerSecond = gbPerSecond;
+            double ofMemcpy = memcpyGbPerSecond > 0 ? gbPerSecond / memcpyGbPerSecond : 0.0;
+
+            if (json) {
+                fprintf(report, "%s\n    { \"kernel\": \"%s\", \"width\": %zu, \"height\": %zu, \"calls\": %zu, "
+                        "\"nsPerFrame\": %.0f, \"mpxPerSecond\": %.2f, \"gbPerSecond\": %.3f, "
+                        "\"memcpyGbPerSecond\": %.3f, \"ofMemcpy\": %.3f }",
+                        first ? "" : ",", kernel->name, widths[s], heights[s], calls,
+                        ns, mpxPerSecond, gbPerSecond, memcpyGbPerSecond, ofMemcpy);
+                first = 0;
+            } else if (kernel->bytesPerPixel) {
+                fprintf(report, "%-18s %5zux%-5zu %14.0f %10.1f %10.2f %8.0f%%\n", kernel->name,
+                        widths[s], heights[s], ns, mpxPerSecond, gbPerSecond, ofMemcpy * 100);
+            } else {
+                fprintf(report, "%-18s %5zux%-5zu %14.0f %10.1f %10s %9s\n", kernel->name,
+                        widths[s], heights[s], ns, mpxPerSecond, "-", "-");
+            }
+        }
+
+        teardownBench(bench);
+        free(bench);
+        if (!json) fputc('\n', report);
+    }
+
+    if (json) {
+        fprintf(report, "\n  ]");
+    }
+    if ((!filter || strstr("fftForwardReal", filter)) && benchFft(report, json, minSeconds) != 0) {
+        return EXIT_FAILURE;
+    }
+    if (json) {
+        fprintf(report, "\n}\n");
+    }
+    fclose(report);
+    return EXIT_SUCCESS;
+}
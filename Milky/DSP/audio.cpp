@@ -1,62 +1,60 @@
 #include "audio.hpp"
 
-// Global variable for FFTManager, initialized in StartAudioCapture and freed in StopAudioDeviceWithIOProc
+// Global variable for FFTManager, created by the first performFFT() call
 static FFTManager *fftManager = NULL;
 const int fftSizes[NUM_FFT_SIZES] = {128, 256, 512, 1024, 2048};
 
-// Global audio data variables
-uint8_t globalWaveform[MAX_WAVEFORM_SAMPLES];   // Adjust size as needed
-uint8_t globalSpectrum[2048];   // Adjust size as needed
-size_t globalWaveformLength = 0;
-size_t globalSpectrumLength = 0;
+// Audio features, published by the analysis thread and acquired by the render loop
+static MilkyFeatureExchange audioFeatures;
+static pthread_once_t audioFeaturesOnce = PTHREAD_ONCE_INIT;
 
-static pthread_mutex_t audioDataMutex = PTHREAD_MUTEX_INITIALIZER;
+// State of the analysis (STFT, band levels and energy spike detection); only the analysis thread touches it
+static MilkyAnalyzer audioAnalyzer;
+static int audioAnalyzerReady = 0;
 
-// FPS counting
-double lastTime = 0;
-int frameCounter = 0;
-
-static double lastFpsLogTime = 0;
-static int audioFrameCounter = 0;
-static double lastAudioUpdateTime = 0;
-static double lastFFTUpdateTime = 0;
-const double audioUpdateInterval = 1.0 / 90.0; // 30 updates per second
-const double fftUpdateInterval = 1.0 / 20.0;   // 15 updates per second
-const double fpsLogInterval = 1.0;             // Log FPS every second
+// Samples of the tapped stream, from the IO callback (producer) to the analysis thread (consumer).
+// The ring, the semaphore and the thread are created by the first StartAudioCapture() and kept for
+// the lifetime of the process; the callback wakes the thread through the semaphore once audioRingReady
+// is set. Signaling a Mach semaphore neither locks nor allocates, so it is safe on the IO thread.
+static MilkySampleRing audioRing;
+static int audioRingReady = 0;
+static semaphore_t analysisWakeup;
+static pthread_t analysisThread;
 
 // Initialize an FFT processor for a specific size
 FFTProcessor *initializeFFTProcessor(int fftSize) {
     FFTProcessor *processor = (FFTProcessor *)malloc(sizeof(FFTProcessor));
-    int log2n = log2f(fftSize);
-    processor->fftSetup = vDSP_create_fftsetup(log2n, kFFTRadix2);
+    processor->plan = getFftPlan(fftSize);
+    processor->fftSize = fftSize;
+    processor->input = (float *)calloc(fftSize, sizeof(float));
     processor->realp = (float *)calloc(fftSize / 2, sizeof(float));
     processor->imagp = (float *)calloc(fftSize / 2, sizeof(float));
-    processor->complexBuffer.realp = processor->realp;
-    processor->complexBuffer.imagp = processor->imagp;
+    processor->magnitudes = (float *)calloc(fftSize / 2, sizeof(float));
     return processor;
 }
 
-// Initialize FFTManager with pre-created FFT setups for different sizes
+// Initialize FFTManager with pre-created FFT plans for different sizes
 FFTManager *initializeFFTManager() {
     FFTManager *manager = (FFTManager *)malloc(sizeof(FFTManager));
     for (int i = 0; i < NUM_FFT_SIZES; i++) {
         manager->processors[i] = initializeFFTProcessor(fftSizes[i]);
-        if (!manager->processors[i]->fftSetup) {
-            fprintf(stderr, "Failed to create FFT setup for size %d\n", fftSizes[i]);
+        if (!manager->processors[i]->plan) {
+            fprintf(stderr, "Failed to create FFT plan for size %d\n", fftSizes[i]);
         }
     }
     return manager;
 }
 
-// Free resources in FFTProcessor
+// Free resources in FFTProcessor; the plan is shared and stays cached
 void freeFFTProcessor(FFTProcessor *processor) {
-    vDSP_destroy_fftsetup(processor->fftSetup);
+    free(processor->input);
     free(processor->realp);
     free(processor->imagp);
+    free(processor->magnitudes);
     free(processor);
 }
 
-// Free all FFT setups in the manager
+// Free all FFT processors in the manager
 void freeFFTManager(FFTManager *manager) {
     for (int i = 0; i < NUM_FFT_SIZES; i++) {
         freeFFTProcessor(manager->processors[i]);
@@ -65,47 +63,48 @@ void freeFFTManager(FFTManager *manager) {
 }
 
 void performFFT(const float *samples, int sampleCount, unsigned char *frequencyBins) {
-    // Find the appropriate FFT setup based on the sample count
-    int fftSize = 0;
+    if (!fftManager) {
+        fftManager = initializeFFTManager();
+    }
+
+    // Find the appropriate FFT size based on the sample count
     FFTProcessor *processor = NULL;
     for (int i = 0; i < NUM_FFT_SIZES; i++) {
         if (fftSizes[i] >= sampleCount) {
-            fftSize = fftSizes[i];
             processor = fftManager->processors[i];
             break;
         }
     }
 
-    // Fall back to the largest size if no suitable size found
+    // Fall back to the largest size if no suitable size found; the newest samples are dropped
     if (!processor) {
-        fftSize = fftSizes[NUM_FFT_SIZES - 1];
         processor = fftManager->processors[NUM_FFT_SIZES - 1];
     }
-
-    // Prepare the complex buffer with the samples
-    vDSP_ctoz((DSPComplex *)samples, 2, &processor->complexBuffer, 1, sampleCount / 2);
-
-    // Perform the FFT
-    vDSP_fft_zrip(processor->fftSetup, &processor->complexBuffer, 1, log2f(fftSize), FFT_FORWARD);
-
-    // Calculate magnitudes
-    float magnitudes[fftSize / 2];
-    vDSP_zvmags(&processor->complexBuffer, 1, magnitudes, 1, sampleCount / 2);
-
-    // Take the square root to get amplitude spectrum
-    float sqrtMagnitudes[fftSize / 2];
-    vvsqrtf(sqrtMagnitudes, magnitudes, (int *)&sampleCount);
-
-    // Normalize and scale to 8-bit values (0–255)
-    float scale = 2.0f / fftSize;
-    for (int i = 0; i < sampleCount / 2; i++) {
-        float scaledValue = sqrtMagnitudes[i] * scale * 127.5f + 128;
+    if (!processor->plan) {
+        return;
+    }
+    int fftSize = processor->fftSize;
+    int bins = fftSize / 2;
+
+    // Copy the samples and zero-pad them to the transform size
+    int used = sampleCount < fftSize ? sampleCount : fftSize;
+    memcpy(processor->input, samples, used * sizeof(float));
+    memset(processor->input + used, 0, (fftSize - used) * sizeof(float));
+
+    // Perform the FFT; the result is packed like vDSP's (Nyquist bin in imagp[0])
+    fftForwardReal(processor->plan, processor->input, processor->realp, processor->imagp);
+    fftMagnitudes(processor->realp, processor->imagp, processor->magnitudes, bins);
+
+    // Normalize and scale to 8-bit values (0–255). vDSP's real FFT returned twice the
+    // spectrum, which the scale keeps, so the visuals stay as they were
+    float scale = 2.0f * 2.0f / fftSize;
+    for (int i = 0; i < bins; i++) {
+        float scaledValue = processor->magnitudes[i] * scale * 127.5f + 128;
         int clampedValue = scaledValue < 0 ? 0 : (scaledValue > 255 ? 255 : (int)scaledValue);
         frequencyBins[i] = (unsigned char)clampedValue;
     }
 }
 
-
 // Helper function to get the current time in seconds
 double getCurrentTimeInSeconds(void) {
     struct timespec now;
@@ -113,6 +112,8 @@ double getCurrentTimeInSeconds(void) {
     return now.tv_sec + (now.tv_nsec / 1e9);
 }
 
+// Real-time IO callback: appends the input to the sample ring, wakes the analysis thread and returns.
+// It must not lock, allocate or log; all analysis happens on the analysis thread.
 OSStatus AudioDeviceIOProcCallback(
     AudioDeviceID inDevice,
     const AudioTimeStamp *inNow,
@@ -122,80 +123,125 @@ OSStatus AudioDeviceIOProcCallback(
     const AudioTimeStamp *inOutputTime,
     void *inClientData
 ) {
-    double currentTime = getCurrentTimeInSeconds();
-    
-    float *inputBuffer = (float *)inInputData->mBuffers[0].mData;
-    UInt32 sampleCount = inInputData->mBuffers[0].mDataByteSize / sizeof(float);
-
-    // Process audio data at 30 Hz
-    if (currentTime - lastAudioUpdateTime >= audioUpdateInterval) {
-        lastAudioUpdateTime = currentTime;
-
-        if (inInputData && inInputData->mNumberBuffers > 0) {
-
-            // Convert inputBuffer to waveform
-            uint8_t waveform[MAX_WAVEFORM_SAMPLES];
-            for (UInt32 i = 0; i < MAX_WAVEFORM_SAMPLES && i < sampleCount; i++) {
-                waveform[i] = (uint8_t)((inputBuffer[i] + 1.0f) * 127.5f);
-            }
-            
-            // Update global waveform data
-            pthread_mutex_lock(&audioDataMutex);
-            memcpy(globalWaveform, waveform, MAX_WAVEFORM_SAMPLES);
-            globalWaveformLength = MAX_WAVEFORM_SAMPLES;
-            pthread_mutex_unlock(&audioDataMutex);
-        }
-        audioFrameCounter++;
+    if (inInputData && inInputData->mNumberBuffers > 0) {
+        const AudioBuffer *buffer = &inInputData->mBuffers[0];
+        size_t channels = buffer->mNumberChannels > 0 ? buffer->mNumberChannels : 1;
+        size_t frameCount = buffer->mDataByteSize / (sizeof(float) * channels);
+        writeSampleRing(&audioRing, (const float *)buffer->mData, frameCount, channels);
+        semaphore_signal(analysisWakeup);
+    }
+    return noErr;
+}
+
+// Sets up the feature exchange and the analysis state, once
+static void initAudioFeatures(void) {
+    initFeatureExchange(&audioFeatures);
+    audioAnalyzerReady = initAnalyzer(&audioAnalyzer, MILKY_ANALYZER_WINDOW, MILKY_ANALYZER_HOP, MILKY_ANALYZER_WINDOW_FUNCTION) == 0;
+}
+
+// Drains the sample ring: runs the STFT over every hop written since the last call, so no
+// sample is skipped and the energy detector sees every spectrum, then publishes the newest
+// spectrum with the newest samples as the waveform. Without a new spectrum nothing is
+// published, so a pending spike stays in the snapshot until the render loop has seen it.
+// Runs on the analysis thread only.
+static void processAudioSamples(void) {
+    if (analyzeSamples(&audioAnalyzer, &audioRing) == 0) {
+        return;
     }
+    if (collectAudioFeatures(&audioAnalyzer, &audioRing, beginFeatureWrite(&audioFeatures)) == 0) {
+        publishFeatures(&audioFeatures);
+    }
+}
 
-    // Perform FFT at 15 Hz
-    if (currentTime - lastFFTUpdateTime >= fftUpdateInterval) {
-        lastFFTUpdateTime = currentTime;
+// Analysis thread: sleeps until the IO callback has written new samples, then analyzes them.
+// The semaphore counts every signal, so after a stall the thread wakes once per callback it
+// missed; the first wakeup drains the ring and the others find no new hop and publish nothing.
+static void *analysisLoop(void *arg) {
+    pthread_once(&audioFeaturesOnce, initAudioFeatures);
+    if (!audioAnalyzerReady) {
+        return NULL;
+    }
+    for (;;) {
+        semaphore_wait(analysisWakeup);
+        processAudioSamples();
+    }
+    return NULL;
+}
 
-        if (inInputData && inInputData->mNumberBuffers > 0) {
+// Creates the wakeup semaphore and starts the analysis thread, once
+static int startAudioAnalysis(void) {
+    if (semaphore_create(mach_task_self(), &analysisWakeup, SYNC_POLICY_FIFO, 0) != KERN_SUCCESS) {
+        fprintf(stderr, "Failed to create the audio analysis semaphore\n");
+        return -1;
+    }
 
-            // Perform FFT
-            uint8_t spectrum[2048];
-            performFFT(inputBuffer, sampleCount, spectrum);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
 
-            // Update global spectrum data
-            pthread_mutex_lock(&audioDataMutex);
-            memcpy(globalSpectrum, spectrum, 2048);
-            globalSpectrumLength = 2048;
-            pthread_mutex_unlock(&audioDataMutex);
-        }
+    // Below the render thread: a late spectrum only delays the visuals, a late frame is visible
+    if (pthread_attr_set_qos_class_np(&attr, QOS_CLASS_USER_INITIATED, 0) != 0) {
+        fprintf(stderr, "Failed to set QoS class; using default.\n");
     }
-    
-    // Log audio FPS every second
-    if (currentTime - lastFpsLogTime >= fpsLogInterval) {
-        double fps = audioFrameCounter / (currentTime - lastFpsLogTime);
-        printf("Audio FPS: %.2f\n", fps);
-        lastFpsLogTime = currentTime;
-        audioFrameCounter = 0;
+    if (pthread_create(&analysisThread, &attr, analysisLoop, NULL) != 0) {
+        fprintf(stderr, "Failed to create the audio analysis thread\n");
+        pthread_attr_destroy(&attr);
+        return -1;
     }
-    return noErr;
+    pthread_detach(analysisThread);
+    pthread_attr_destroy(&attr);
+    return 0;
 }
 
+// Returns the newest audio features to the render loop. The snapshot is read in place and stays
+// unchanged until the next call; before any audio is analyzed its waveform and spectrum are empty.
+const MilkyAudioFeatures *acquireAudioFeatures(void) {
+    pthread_once(&audioFeaturesOnce, initAudioFeatures);
+    return acquireFeatures(&audioFeatures);
+}
 
-// Update audio data
-void updateAudioData(const uint8_t *waveform, const uint8_t *spectrum, size_t waveformLength, size_t spectrumLength) {
-    pthread_mutex_lock(&audioDataMutex);
-    
-    // Ensure we don't overflow the global buffers
-    globalWaveformLength = (waveformLength <= sizeof(globalWaveform)) ? waveformLength : sizeof(globalWaveform);
-    globalSpectrumLength = (spectrumLength <= sizeof(globalSpectrum)) ? spectrumLength : sizeof(globalSpectrum);
-    
-    // Copy data into the global buffers
-    memcpy(globalWaveform, waveform, globalWaveformLength);
-    memcpy(globalSpectrum, spectrum, globalSpectrumLength);
-    
-    pthread_mutex_unlock(&audioDataMutex);
+// Reads the counters of the sample ring (written samples, overruns, underruns)
+void getAudioRingStats(MilkySampleRingStats *stats) {
+    if (!__atomic_load_n(&audioRingReady, __ATOMIC_ACQUIRE)) {
+        memset(stats, 0, sizeof(MilkySampleRingStats));
+        return;
+    }
+    getSampleRingStats(&audioRing, stats);
 }
 
+// Reads the nominal sample rate of a device, 0 if it is unknown
+static Float64 getNominalSampleRate(AudioObjectID deviceId) {
+    AudioObjectPropertyAddress address = {
+        kAudioDevicePropertyNominalSampleRate,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    Float64 sampleRate = 0;
+    UInt32 size = sizeof(sampleRate);
+    if (AudioObjectGetPropertyData(deviceId, &address, 0, NULL, &size, &sampleRate) != noErr) {
+        return 0;
+    }
+    return sampleRate;
+}
+
+
 void StartAudioCapture(AudioObjectID aggregatedDeviceId, AudioDeviceIOProcID *deviceProcID) {
     OSStatus status;
-    // Initialize FFTManager with multiple FFT setups
-    fftManager = initializeFFTManager();
+
+    // Create the sample ring and start the analysis before the callback can run; later captures reuse them
+    Float64 sampleRate = getNominalSampleRate(aggregatedDeviceId);
+    if (!__atomic_load_n(&audioRingReady, __ATOMIC_ACQUIRE)) {
+        if (initSampleRing(&audioRing, MILKY_AUDIO_RING_SAMPLES, sampleRate > 0 ? sampleRate : 44100.0) != 0) {
+            return;
+        }
+        if (startAudioAnalysis() != 0) {
+            freeSampleRing(&audioRing);
+            return;
+        }
+        __atomic_store_n(&audioRingReady, 1, __ATOMIC_RELEASE);
+    } else {
+        // The device may run at another rate than on the previous capture; the analysis thread reads it concurrently
+        setSampleRingRate(&audioRing, sampleRate);
+    }
 
     // Register the callback
     status = AudioDeviceCreateIOProcID(aggregatedDeviceId, AudioDeviceIOProcCallback, NULL, deviceProcID);
@@ -218,6 +264,5 @@ void StartAudioCapture(AudioObjectID aggregatedDeviceId, AudioDeviceIOProcID *de
 void StopAudioDeviceWithIOProc(AudioDeviceID aggregateDeviceID, AudioDeviceIOProcID *deviceProcID) {
     AudioDeviceStop(aggregateDeviceID, *deviceProcID);
     AudioDeviceDestroyIOProcID(aggregateDeviceID, *deviceProcID);
-    freeFFTManager(fftManager);
     printf("Audio streaming stopped.\n");
 }
@@ -4,29 +4,35 @@
 #include <AudioToolbox/AudioToolbox.h>
 #include <CoreAudio/CoreAudio.h>
 #include <CoreAudio/AudioHardware.h>
-#include <Accelerate/Accelerate.h>
+#include <mach/mach.h>
+#include <mach/semaphore.h>
+#include <pthread.h>
 #include <vector>
 #include <unordered_map>
 #include <iostream>
 #include <cmath>
 #include <memory>
 
+#include "../Visualizer/audio/ring.h"
+#include "../Visualizer/audio/features.h"
+#include "../Visualizer/audio/energy.h"
+#include "../Visualizer/audio/fft.h"
+#include "../Visualizer/audio/analyzer.h"
+
 #define NUM_FFT_SIZES 5
-#define MAX_WAVEFORM_SAMPLES 1024
 extern const int fftSizes[NUM_FFT_SIZES]; // Declare fftSizes as extern
 
-// Declare the variables as extern for global access
-extern uint8_t globalWaveform[MAX_WAVEFORM_SAMPLES];
-extern uint8_t globalSpectrum[2048];
-extern size_t globalWaveformLength;
-extern size_t globalSpectrumLength;
+// capacity of the sample ring: about 370 ms at 44.1 kHz, so the consumer may stall for several frames
+#define MILKY_AUDIO_RING_SAMPLES 16384
 
-// Structure to hold FFT setup and buffers for real and imaginary components
+// Structure to hold the FFT plan and the buffers of one transform size
 typedef struct {
-    FFTSetup fftSetup;
-    DSPSplitComplex complexBuffer;
+    const MilkyFftPlan *plan;
+    int fftSize;
+    float *input;       // the samples, zero-padded to fftSize
     float *realp;
     float *imagp;
+    float *magnitudes;
 } FFTProcessor;
 
 // Structure to manage multiple FFT setups for different sizes
@@ -42,13 +48,15 @@ void freeFFTProcessor(FFTProcessor *processor);
 FFTManager *initializeFFTManager();
 void freeFFTManager(FFTManager *manager);
 
-// Perform FFT on the provided sample data
+// Perform FFT on the provided sample data; writes fftSize / 2 bins for the smallest fftSize >= sampleCount
 void performFFT(const float *samples, int sampleCount, unsigned char *frequencyBins);
 
 // Helper function to get the current time in seconds
 double getCurrentTimeInSeconds(void);
 
-void updateAudioData(const uint8_t *waveform, const uint8_t *spectrum, size_t waveformLength, size_t spectrumLength);
+// Returns the newest features published by the analysis thread; called by the render loop
+const MilkyAudioFeatures *acquireAudioFeatures(void);
+void getAudioRingStats(MilkySampleRingStats *stats);
 
 // Functions to start and stop audio capture
 void StartAudioCapture(AudioObjectID aggregatedDeviceId, AudioDeviceIOProcID *deviceProcID);
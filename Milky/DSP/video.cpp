@@ -15,7 +15,15 @@ const useconds_t milky_minSleepTime = 1000; // Minimum sleep time (1 ms)
 const useconds_t milky_maxSleepTime = 33000; // Maximum sleep time (33 ms)
 const double milky_fpsAdjustmentFactor = 0.1; // Adjustment factor for sleep time
 
+typedef struct MilkyRenderContext MilkyRenderContext;
+typedef struct MilkyPresetParams MilkyPresetParams;
+
+extern "C" MilkyRenderContext *createRenderContext(void);
+extern "C" void destroyRenderContext(MilkyRenderContext *context);
+extern "C" const MilkyPresetParams *getPresetParams(size_t presetIndex);
+
 extern "C" void render(
+   MilkyRenderContext *context,    // Render context created by createRenderContext()
    uint8_t *frame,                 // Canvas frame buffer (RGBA format)
    size_t canvasWidthPx,           // Canvas width in pixels
    size_t canvasHeightPx,          // Canvas height in pixels
@@ -24,7 +32,7 @@ extern "C" void render(
    size_t waveformLength,          // Length of the waveform data array
    size_t spectrumLength,          // Length of the spectrum data array
    uint8_t bitDepth,               // Bit depth of the rendering
-   float *presetsBuffer,           // Preset data
+   const MilkyPresetParams *preset, // Compiled preset (see getPresetParams()), NULL for the defaults
    float speed,                    // Speed factor for the rendering
    size_t currentTime,             // Current time in milliseconds,
    size_t sampleRate               // Waveform sample rate (samples per second)
@@ -57,6 +65,27 @@ void memoryBarrier() {
     __sync_synchronize();
 }
 
+// Print the frame time percentiles of every render stage on one line
+static void logStageTimings(const MilkyRenderContext *renderContext) {
+    MilkyStageTiming timings[MILKY_STAGE_COUNT];
+    size_t count = getRenderStageTimings(renderContext, timings, MILKY_STAGE_COUNT);
+
+    fprintf(stdout, "Render stages (p50/p99 us):");
+    for (size_t s = 0; s < count; s++) {
+        fprintf(stdout, " %s %.0f/%.0f", getRenderStageName((MilkyRenderStage)s),
+                timings[s].p50 / 1000.0, timings[s].p99 / 1000.0);
+    }
+    fprintf(stdout, "\n");
+}
+
+// Print how many samples the audio tap delivered and how many the analysis missed
+static void logAudioRingStats(void) {
+    MilkySampleRingStats stats;
+    getAudioRingStats(&stats);
+    fprintf(stdout, "Audio samples: %llu written, %llu overrun, %llu underruns\n",
+            (unsigned long long)stats.written, (unsigned long long)stats.overruns, (unsigned long long)stats.underruns);
+}
+
 // Render loop function
 void *renderLoop(void *arg) {
     RenderLoopArgs *args = (RenderLoopArgs *)arg;
@@ -67,6 +96,23 @@ void *renderLoop(void *arg) {
     
     // Initial buffer to write to
     int currentBufferIndex = 0;
+
+    // All visualizer state of this loop lives in its own render context
+    MilkyRenderContext *renderContext = createRenderContext();
+    if (!renderContext) {
+        return NULL;
+    }
+
+    // The governor lowers the internal resolution when frames run over budget; frames rendered
+    // below the output size go through this buffer and are upscaled into the shared buffers
+    MilkyResolutionGovernor governor;
+    initResolutionGovernor(&governor, args->desiredFPS);
+    uint8_t *governedFrame = (uint8_t *)malloc(args->canvasWidthPx * args->canvasHeightPx * 4);
+    if (!governedFrame) {
+        fprintf(stderr, "Failed to allocate the governed frame buffer\n");
+        destroyRenderContext(renderContext);
+        return NULL;
+    }
     
     while (renderLoopRunning) {
         size_t currentTime = getCurrentTimeMillis();
@@ -76,30 +122,46 @@ void *renderLoop(void *arg) {
             currentFPS = 1.0 / deltaTime;
         }
 
-        // Log FPS every second
+        // Log FPS and the per-stage frame times (p50/p99 in microseconds) every second
         if (currentTime - lastFpsLogTime >= 1000) {
             fprintf(stdout, "Render FPS: %.2f\n", currentFPS);
+            logStageTimings(renderContext);
+            logAudioRingStats();
             lastFpsLogTime = currentTime;
         }
 
         lastFrameTime = currentTime;
+
+        // Take the newest features of the analysis thread; the snapshot stays unchanged
+        // until the next frame, so the frame reads it in place
+        const MilkyAudioFeatures *features = acquireAudioFeatures();
         // Select the buffer to write to
        uint8_t *frameBuffer = (currentBufferIndex == 0) ? bufferA : bufferB;
 
-        render(
-            frameBuffer,
-            args->canvasWidthPx,
-            args->canvasHeightPx,
-            globalWaveform,
-            globalSpectrum,
-            globalWaveformLength,
-            globalSpectrumLength,
+        size_t renderWidthPx, renderHeightPx;
+        getGovernedSize(&governor, args->canvasWidthPx, args->canvasHeightPx, &renderWidthPx, &renderHeightPx);
+        int governed = renderWidthPx != args->canvasWidthPx || renderHeightPx != args->canvasHeightPx;
+        uint64_t frameStart = profilerNow();
+
+        renderAudioFeatures(
+            renderContext,
+            governed ? governedFrame : frameBuffer,
+            renderWidthPx,
+            renderHeightPx,
+            features,
             args->bitDepth,
-            NULL,
+            getPresetParams(0), // the first loaded preset, if any
             0.035f,
             currentTime,
             args->sampleRate
         );
+        if (governed) {
+            upscaleFrame(renderContext, governedFrame, renderWidthPx, renderHeightPx, frameBuffer, args->canvasWidthPx, args->canvasHeightPx);
+        }
+        if (updateResolutionGovernor(&governor, profilerNow() - frameStart)) {
+            getGovernedSize(&governor, args->canvasWidthPx, args->canvasHeightPx, &renderWidthPx, &renderHeightPx);
+            fprintf(stdout, "Render resolution: %zux%zu\n", renderWidthPx, renderHeightPx);
+        }
     
         // Memory barrier to ensure writes are visible
         memoryBarrier();
@@ -132,6 +194,8 @@ void *renderLoop(void *arg) {
         toggleBuffer();
     }
 
+    destroyRenderContext(renderContext);
+    free(governedFrame);
     return NULL;
 }
 
@@ -0,0 +1,56 @@
+#include "analysis.h"
+
+/**
+ * Prepares the sample ring and the analyzer.
+ *
+ * @param analysis   The analysis state to initialize.
+ * @param sampleRate The sample rate of the stream.
+ * @return           0 on success, -1 on failure.
+ */
+int initAnalysis(MilkyAnalysis *analysis, double sampleRate) {
+    memset(analysis, 0, sizeof(MilkyAnalysis));
+    if (initSampleRing(&analysis->ring, MILKY_ANALYSIS_RING_SAMPLES, sampleRate) != 0) {
+        return -1;
+    }
+    if (initAnalyzer(&analysis->analyzer, MILKY_ANALYZER_WINDOW, MILKY_ANALYZER_HOP, MILKY_ANALYZER_WINDOW_FUNCTION) != 0) {
+        freeSampleRing(&analysis->ring);
+        return -1;
+    }
+
+    // the stream starts with a window of silence, so the first frame has a full waveform
+    analysis->written = -(long long)MILKY_ANALYZER_WINDOW;
+    return 0;
+}
+
+/**
+ * Frees the sample ring and the analyzer.
+ *
+ * @param analysis The analysis state to free.
+ */
+void freeAnalysis(MilkyAnalysis *analysis) {
+    freeAnalyzer(&analysis->analyzer);
+    freeSampleRing(&analysis->ring);
+}
+
+/**
+ * Computes the audio features render() receives for one video frame. The stream is fed
+ * up to the frame's presentation time, as the live audio tap would have delivered it,
+ * and analyzed exactly like the app does (see audio/analyzer.c), so frames look the
+ * same as in the app.
+ *
+ * @param analysis   The analysis state; receives the features in `features`.
+ * @param source     The PCM stream to analyze.
+ * @param frameIndex The index of the video frame.
+ * @param fps        The video frame rate.
+ */
+void analyzeFrame(MilkyAnalysis *analysis, const MilkyPcmSource *source, size_t frameIndex, size_t fps) {
+    long long end = (long long)((unsigned long long)frameIndex * source->sampleRate / fps);
+    while (analysis->written < end) {
+        size_t count = end - analysis->written < MILKY_ANALYSIS_CHUNK ? (size_t)(end - analysis->written) : MILKY_ANALYSIS_CHUNK;
+        readPcmMono(source, analysis->written, count, analysis->chunk);
+        writeSampleRing(&analysis->ring, analysis->chunk, count, 1);
+        analysis->written += (long long)count;
+        analyzeSamples(&analysis->analyzer, &analysis->ring);
+    }
+    collectAudioFeatures(&analysis->analyzer, &analysis->ring, &analysis->features);
+}
@@ -0,0 +1,35 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pcm.h"
+#include "audio/ring.h"
+#include "audio/analyzer.h"
+
+// capacity of the sample ring, like the app's
+#define MILKY_ANALYSIS_RING_SAMPLES 16384
+
+// the stream is written to the ring in chunks of at most this many samples, and analyzed
+// after each, so no sample is overwritten before it was analyzed
+#define MILKY_ANALYSIS_CHUNK 4096
+
+// the audio analysis of the headless renderer: the PCM stream runs through a sample ring
+// and the same analyzer as the app's live audio tap, one video frame at a time
+typedef struct {
+    MilkySampleRing ring;
+    MilkyAnalyzer analyzer;
+    MilkyAudioFeatures features;  // the features of the last analyzed frame
+    long long written;            // the next stream sample to write to the ring
+    float chunk[MILKY_ANALYSIS_CHUNK];
+} MilkyAnalysis;
+
+int initAnalysis(MilkyAnalysis *analysis, double sampleRate);
+void freeAnalysis(MilkyAnalysis *analysis);
+void analyzeFrame(MilkyAnalysis *analysis, const MilkyPcmSource *source, size_t frameIndex, size_t fps);
+
+#endif // ANALYSIS_H
@@ -0,0 +1,676 @@
+/*
+ Headless offline renderer.
+
+ Drives the C renderer from a WAV or raw float PCM file instead of the live audio tap and
+ writes every frame as raw RGBA or as a YUV4MPEG2 stream, as fast as the CPU allows. Video
+ time advances by exactly one frame per rendered frame, independent of the wall clock.
+ The frames are the renderer's canvas, before the app's Metal post-processing.
+
+ With --seed the output is reproducible, and --golden compares the frames against a stored
+ raw RGBA rendering instead of (or in addition to) writing them, failing when any frame
+ drifts further than the given max-error / PSNR threshold. That turns any audio fixture
+ into a regression test for changes to the render path.
+
+ --presets renders with a preset of a binary preset bank (see presetbank.c), and
+ --convert-presets turns a flattened float preset file into such a bank.
+
+ Build (Linux or macOS, from the repository root):
+
+   cc -std=c99 -O2 -D_GNU_SOURCE -IMilky/Visualizer -o milky-headless \
+      $(find Milky/Headless Milky/Visualizer -name '*.c') -lm -lpthread
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../Visualizer/video.h"
+#include "../Visualizer/video/kernels.h"
+#include "../Visualizer/presetbank.h"
+#include "../Visualizer/audio/analyzer.h"
+#include "pcm.h"
+#include "analysis.h"
+
+// output formats of the headless renderer
+typedef enum {
+    MILKY_OUTPUT_RGBA = 0,
+    MILKY_OUTPUT_Y4M
+} MilkyOutputFormat;
+
+// command line options
+typedef struct {
+    const char *inputPath;
+    const char *outputPath; // NULL = stdout, unless comparing against golden frames
+    const char *goldenPath; // raw RGBA frames to compare against, NULL = no comparison
+    const char *bankPath;   // preset bank to render with, NULL = default parameters
+    size_t preset;          // index of the preset in the bank
+    int convertPresets;     // convert the input from flattened presets to a bank instead of rendering
+    MilkyOutputFormat format;
+    size_t width;
+    size_t height;
+    size_t fps;
+    size_t threads;
+    size_t maxFrames;       // 0 = until the end of the audio
+    size_t rawSampleRate;
+    size_t rawChannels;
+    uint8_t bitDepth;
+    MilkyDitherMode dither;
+    uint64_t seed;
+    int hasSeed;
+    int maxError;           // largest allowed per-channel difference to the golden frames
+    double minPsnr;         // smallest allowed PSNR in dB (0 = not checked)
+    int quiet;
+} MilkyHeadlessOptions;
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+        "Usage: %s [options] <input.wav | input.raw>\n"
+        "\n"
+        "  -o, --output FILE      write frames to FILE, '-' for stdout (default, unless --golden)\n"
+        "  -f, --format FORMAT    'y4m' (default) or 'rgba' (raw frames, 4 bytes per pixel)\n"
+        "  -W, --width PX         canvas width (default 1280)\n"
+        "  -H, --height PX        canvas height (default 720)\n"
+        "  -r, --fps N            frames per second of audio time (default 60)\n"
+        "  -n, --frames N         stop after N frames (default: whole file)\n"
+        "  -b, --bit-depth N      bit depth of the rendering: 8, 16, 24 or 32 (default 32)\n"
+        "      --dither MODE      below 32 bits: 'ordered' (default), 'none' or 'diffusion'\n"
+        "  -t, --threads N        render threads, 0 = one per core (default 0)\n"
+        "      --rate HZ          sample rate of raw input (default 44100)\n"
+        "      --channels N       channel count of raw input (default 2)\n"
+        "  -s, --seed N           seed the random streams, so the output is reproducible\n"
+        "      --golden FILE      compare the frames against FILE (raw RGBA) and fail on drift\n"
+        "      --max-error N      largest allowed channel difference per pixel (default 0, or 255 with --min-psnr)\n"
+        "      --min-psnr DB      smallest allowed PSNR per frame (default: not checked)\n"
+        "      --presets FILE     render with a preset of the preset bank FILE\n"
+        "      --preset N         index of the preset in the bank (default 0)\n"
+        "      --convert-presets  convert the input, flattened float presets, to a preset bank written to --output\n"
+        "      --selftest         check the SIMD kernels, the analyzer and the render clock, then exit\n"
+        "  -q, --quiet            do not print the frame rate summary\n"
+        "\n"
+        "Raw input is interleaved little-endian 32-bit float.\n",
+        program);
+}
+
+/**
+ * Parses a positive decimal option value.
+ *
+ * @return 0 on success, -1 (with a message) if the value is not a number.
+ */
+static int parseSize(const char *name, const char *value, size_t *out) {
+    char *end = NULL;
+    unsigned long long parsed = strtoull(value, &end, 10);
+    if (!value[0] || *end != '\0') {
+        fprintf(stderr, "Invalid value for %s: %s\n", name, value);
+        return -1;
+    }
+    *out = (size_t)parsed;
+    return 0;
+}
+
+// frames and canvas of the self-test of the render clock
+#define MILKY_CLOCK_TEST_FRAMES 40
+#define MILKY_CLOCK_TEST_WIDTH 160
+#define MILKY_CLOCK_TEST_HEIGHT 90
+
+/**
+ * Renders the self-test frames with the ripple of the motion enabled, starting at the given
+ * wall-clock time in milliseconds.
+ *
+ * @return 0 on success, -1 if the frames could not be rendered.
+ */
+static int renderClockTest(size_t timeBase, uint8_t *frames) {
+    MilkyRenderContext *context = createRenderContext();
+    if (!context) {
+        return -1;
+    }
+    setRenderSeed(context, 1);
+
+    MilkyPresetParams preset = *getDefaultPresetParams();
+    preset.magic = 2.0f;
+
+    uint8_t waveform[MILKY_FEATURES_MAX_WAVEFORM], spectrum[MILKY_FEATURES_MAX_SPECTRUM];
+    size_t frameSize = MILKY_CLOCK_TEST_WIDTH * MILKY_CLOCK_TEST_HEIGHT * 4;
+    for (size_t f = 0; f < MILKY_CLOCK_TEST_FRAMES; f++) {
+        for (size_t i = 0; i < MILKY_FEATURES_MAX_WAVEFORM; i++) {
+            waveform[i] = (uint8_t)(128 + 90 * sinf((float)(i + 7 * f) * 0.07f));
+        }
+        for (size_t i = 0; i < MILKY_FEATURES_MAX_SPECTRUM; i++) {
+            spectrum[i] = (uint8_t)(128 + (i * 5 + f * 3) % 96);
+        }
+        render(context, frames + f * frameSize, MILKY_CLOCK_TEST_WIDTH, MILKY_CLOCK_TEST_HEIGHT,
+               waveform, spectrum, MILKY_FEATURES_MAX_WAVEFORM, MILKY_FEATURES_MAX_SPECTRUM,
+               32, &preset, 0.035f, timeBase + f * 1000 / 60, 44100);
+    }
+    destroyRenderContext(context);
+    return 0;
+}
+
+/**
+ * Checks that the animation depends on the time elapsed since the first frame only: the app
+ * passes epoch milliseconds, which must animate exactly like a clock starting near zero.
+ *
+ * @return 0 if the renderings match, 1 otherwise.
+ */
+static size_t verifyRenderClock(void) {
+    size_t size = MILKY_CLOCK_TEST_FRAMES * MILKY_CLOCK_TEST_WIDTH * MILKY_CLOCK_TEST_HEIGHT * 4;
+    uint8_t *reference = (uint8_t *)malloc(size);
+    uint8_t *epoch = (uint8_t *)malloc(size);
+    size_t failed = 1;
+
+    // about 2023-11 in Unix epoch milliseconds
+    if (reference && epoch && renderClockTest(1000, reference) == 0
+        && renderClockTest((size_t)1700000000000ull, epoch) == 0) {
+        failed = memcmp(reference, epoch, size) != 0;
+    }
+    free(reference);
+    free(epoch);
+    return failed;
+}
+
+/**
+ * Parses the command line.
+ *
+ * @return 0 to render, 1 to exit successfully (help, self-test), -1 on invalid options.
+ */
+static int parseOptions(int argc, char **argv, MilkyHeadlessOptions *options) {
+    enum { OPTION_RATE = 256, OPTION_CHANNELS, OPTION_SELFTEST, OPTION_GOLDEN, OPTION_MAX_ERROR, OPTION_MIN_PSNR, OPTION_DITHER,
+           OPTION_PRESETS, OPTION_PRESET, OPTION_CONVERT_PRESETS };
+    static const struct option longOptions[] = {
+        { "output", required_argument, NULL, 'o' },
+        { "format", required_argument, NULL, 'f' },
+        { "width", required_argument, NULL, 'W' },
+        { "height", required_argument, NULL, 'H' },
+        { "fps", required_argument, NULL, 'r' },
+        { "frames", required_argument, NULL, 'n' },
+        { "bit-depth", required_argument, NULL, 'b' },
+        { "dither", required_argument, NULL, OPTION_DITHER },
+        { "threads", required_argument, NULL, 't' },
+        { "rate", required_argument, NULL, OPTION_RATE },
+        { "channels", required_argument, NULL, OPTION_CHANNELS },
+        { "seed", required_argument, NULL, 's' },
+        { "golden", required_argument, NULL, OPTION_GOLDEN },
+        { "max-error", required_argument, NULL, OPTION_MAX_ERROR },
+        { "min-psnr", required_argument, NULL, OPTION_MIN_PSNR },
+        { "presets", required_argument, NULL, OPTION_PRESETS },
+        { "preset", required_argument, NULL, OPTION_PRESET },
+        { "convert-presets", no_argument, NULL, OPTION_CONVERT_PRESETS },
+        { "selftest", no_argument, NULL, OPTION_SELFTEST },
+        { "quiet", no_argument, NULL, 'q' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    *options = (MilkyHeadlessOptions){
+        .maxError = -1,
+        .format = MILKY_OUTPUT_Y4M,
+        .width = 1280,
+        .height = 720,
+        .fps = 60,
+        .rawSampleRate = 44100,
+        .rawChannels = 2,
+        .bitDepth = 32
+    };
+
+    int option;
+    size_t value;
+    while ((option = getopt_long(argc, argv, "o:f:W:H:r:n:b:t:s:qh", longOptions, NULL)) != -1) {
+        switch (option) {
+            case 'o':
+                options->outputPath = optarg;
+                break;
+            case 'f':
+                if (strcmp(optarg, "y4m") == 0) {
+                    options->format = MILKY_OUTPUT_Y4M;
+                } else if (strcmp(optarg, "rgba") == 0) {
+                    options->format = MILKY_OUTPUT_RGBA;
+                } else {
+                    fprintf(stderr, "Unknown output format: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'W':
+                if (parseSize("--width", optarg, &options->width) != 0) return -1;
+                break;
+            case 'H':
+                if (parseSize("--height", optarg, &options->height) != 0) return -1;
+                break;
+            case 'r':
+                if (parseSize("--fps", optarg, &options->fps) != 0) return -1;
+                break;
+            case 'n':
+                if (parseSize("--frames", optarg, &options->maxFrames) != 0) return -1;
+                break;
+            case 'b':
+                if (parseSize("--bit-depth", optarg, &value) != 0) return -1;
+                options->bitDepth = (uint8_t)value;
+                break;
+            case OPTION_DITHER:
+                if (strcmp(optarg, "ordered") == 0) {
+                    options->dither = MILKY_DITHER_ORDERED;
+                } else if (strcmp(optarg, "none") == 0) {
+                    options->dither = MILKY_DITHER_NONE;
+                } else if (strcmp(optarg, "diffusion") == 0) {
+                    options->dither = MILKY_DITHER_DIFFUSION;
+                } else {
+                    fprintf(stderr, "Unknown dither mode: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 't':
+                if (parseSize("--threads", optarg, &options->threads) != 0) return -1;
+                break;
+            case OPTION_RATE:
+                if (parseSize("--rate", optarg, &options->rawSampleRate) != 0) return -1;
+                break;
+            case OPTION_CHANNELS:
+                if (parseSize("--channels", optarg, &options->rawChannels) != 0) return -1;
+                break;
+            case 's':
+                if (parseSize("--seed", optarg, &value) != 0) return -1;
+                options->seed = value;
+                options->hasSeed = 1;
+                break;
+            case OPTION_GOLDEN:
+                options->goldenPath = optarg;
+                break;
+            case OPTION_MAX_ERROR:
+                if (parseSize("--max-error", optarg, &value) != 0) return -1;
+                options->maxError = value > 255 ? 255 : (int)value;
+                break;
+            case OPTION_MIN_PSNR: {
+                char *end = NULL;
+                options->minPsnr = strtod(optarg, &end);
+                if (!optarg[0] || *end != '\0') {
+                    fprintf(stderr, "Invalid value for --min-psnr: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            }
+            case OPTION_PRESETS:
+                options->bankPath = optarg;
+                break;
+            case OPTION_PRESET:
+                if (parseSize("--preset", optarg, &options->preset) != 0) return -1;
+                break;
+            case OPTION_CONVERT_PRESETS:
+                options->convertPresets = 1;
+                break;
+            case OPTION_SELFTEST: {
+                const MilkyKernels *variants[MILKY_KERNELS_MAX_VARIANTS];
+                size_t count = getKernelVariants(variants, MILKY_KERNELS_MAX_VARIANTS);
+                size_t failed = 0;
+                for (size_t v = 0; v < count; v++) {
+                    size_t failures = verifyKernels(variants[v]);
+                    fprintf(stderr, "kernels %-6s %s\n", variants[v]->name, failures ? "FAILED" : "ok");
+                    failed += failures;
+                }
+                size_t analyzerFailures = verifyAnalyzer();
+                fprintf(stderr, "analyzer      %s\n", analyzerFailures ? "FAILED" : "ok");
+                failed += analyzerFailures;
+                size_t clockFailures = verifyRenderClock();
+                fprintf(stderr, "render clock  %s\n", clockFailures ? "FAILED" : "ok");
+                failed += clockFailures;
+                return failed ? -1 : 1;
+            }
+            case 'q':
+                options->quiet = 1;
+                break;
+            case 'h':
+                printUsage(argv[0]);
+                return 1;
+            default:
+                printUsage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    options->inputPath = argv[optind];
+
+    if (options->convertPresets) {
+        if (!options->outputPath || strcmp(options->outputPath, "-") == 0) {
+            fprintf(stderr, "--convert-presets needs an output file\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    if (options->width == 0 || options->height == 0 || options->fps == 0) {
+        fprintf(stderr, "Width, height and frame rate must be positive\n");
+        return -1;
+    }
+
+    // a PSNR threshold alone tolerates any single-pixel difference, otherwise frames must match exactly
+    if (options->maxError < 0) {
+        options->maxError = options->minPsnr > 0 ? 255 : 0;
+    }
+    if (!options->outputPath && !options->goldenPath) {
+        options->outputPath = "-";
+    }
+    return 0;
+}
+
+/**
+ * Converts an RGBA frame to full-range BT.601 4:2:0 planes (chroma averaged per 2x2 block).
+ *
+ * @param frame  The RGBA frame.
+ * @param width  The frame width in pixels.
+ * @param height The frame height in pixels.
+ * @param planes Receives the Y plane followed by the U and V planes.
+ */
+static void convertToYuv420(const uint8_t *frame, size_t width, size_t height, uint8_t *planes) {
+    size_t chromaWidth = (width + 1) / 2;
+    size_t chromaHeight = (height + 1) / 2;
+    uint8_t *lumaPlane = planes;
+    uint8_t *uPlane = lumaPlane + width * height;
+    uint8_t *vPlane = uPlane + chromaWidth * chromaHeight;
+
+    for (size_t i = 0; i < width * height; i++) {
+        const uint8_t *p = frame + i * 4;
+        lumaPlane[i] = (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+
+    for (size_t cy = 0; cy < chromaHeight; cy++) {
+        for (size_t cx = 0; cx < chromaWidth; cx++) {
+            int r = 0, g = 0, b = 0, count = 0;
+            for (size_t y = cy * 2; y < cy * 2 + 2 && y < height; y++) {
+                for (size_t x = cx * 2; x < cx * 2 + 2 && x < width; x++) {
+                    const uint8_t *p = frame + (y * width + x) * 4;
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                    count++;
+                }
+            }
+            r /= count;
+            g /= count;
+            b /= count;
+
+            // offset by 128 << 8 before shifting, so the sums never go negative
+            int u = (-43 * r - 85 * g + 128 * b + 32896) >> 8;
+            int v = (128 * r - 107 * g - 21 * b + 32896) >> 8;
+            uPlane[cy * chromaWidth + cx] = (uint8_t)(u > 255 ? 255 : u);
+            vPlane[cy * chromaWidth + cx] = (uint8_t)(v > 255 ? 255 : v);
+        }
+    }
+}
+
+/**
+ * Takes over stdout for the frame stream. The renderer reports events on stdout, so the
+ * original descriptor is kept for the frames and stdout itself is pointed at stderr.
+ *
+ * @return A stream writing to the original stdout, or NULL on failure.
+ */
+static FILE *openFrameStdout(void) {
+    fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    if (fd < 0) return NULL;
+    if (dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+        close(fd);
+        return NULL;
+    }
+    return fdopen(fd, "wb");
+}
+
+// deviation of one rendered frame from its golden frame
+typedef struct {
+    int maxError;  // largest channel difference
+    double psnr;   // peak signal-to-noise ratio in dB, INFINITY for identical frames
+} MilkyFrameError;
+
+/**
+ * Measures how far a rendered frame deviates from its golden frame, over all four channels.
+ *
+ * @param frame  The rendered RGBA frame.
+ * @param golden The golden RGBA frame.
+ * @param size   The size of both frames in bytes.
+ * @return       The largest difference and the PSNR of the frame.
+ */
+static MilkyFrameError compareFrames(const uint8_t *frame, const uint8_t *golden, size_t size) {
+    MilkyFrameError error = { 0, INFINITY };
+    uint64_t squaredSum = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        int difference = abs((int)frame[i] - (int)golden[i]);
+        if (difference > error.maxError) error.maxError = difference;
+        squaredSum += (uint64_t)(difference * difference);
+    }
+
+    if (squaredSum > 0) {
+        double meanSquaredError = (double)squaredSum / (double)size;
+        error.psnr = 10.0 * log10(255.0 * 255.0 / meanSquaredError);
+    }
+    return error;
+}
+
+static double elapsedSeconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Converts a file of flattened presets (little-endian 32-bit floats, as passed to
+ * parseFlattenedPresetBuffer()) into a preset bank.
+ *
+ * @param inputPath  The flattened presets.
+ * @param outputPath The bank file to write.
+ * @return           0 on success, -1 on failure.
+ */
+static int convertPresetFile(const char *inputPath, const char *outputPath) {
+    FILE *input = fopen(inputPath, "rb");
+    if (!input) {
+        fprintf(stderr, "Failed to open %s\n", inputPath);
+        return -1;
+    }
+
+    size_t capacity = 0;
+    size_t length = 0;
+    float *buffer = NULL;
+    int status = 0;
+    for (;;) {
+        if (length == capacity) {
+            capacity = capacity ? capacity * 2 : 64 * MILKY_MAX_PROPERTY_COUNT_PER_PRESET;
+            float *grown = (float *)realloc(buffer, capacity * sizeof(float));
+            if (!grown) {
+                fprintf(stderr, "Failed to allocate the preset buffer\n");
+                status = -1;
+                break;
+            }
+            buffer = grown;
+        }
+        size_t read = fread(buffer + length, sizeof(float), capacity - length, input);
+        length += read;
+        if (read == 0) break;
+    }
+    if (status == 0 && ferror(input)) {
+        fprintf(stderr, "Failed to read %s\n", inputPath);
+        status = -1;
+    }
+    fclose(input);
+
+    if (status == 0) {
+        status = writePresetBank(outputPath, buffer, length);
+        if (status == 0) {
+            fprintf(stderr, "Wrote %zu presets to %s\n", length / MILKY_MAX_PROPERTY_COUNT_PER_PRESET, outputPath);
+        }
+    }
+    free(buffer);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    MilkyHeadlessOptions options;
+    int parsed = parseOptions(argc, argv, &options);
+    if (parsed != 0) {
+        return parsed > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (options.convertPresets) {
+        return convertPresetFile(options.inputPath, options.outputPath) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    MilkyPresetBank bank = { 0 };
+    const MilkyPresetParams *preset = NULL;
+    if (options.bankPath) {
+        if (openPresetBank(&bank, options.bankPath) != 0) {
+            return EXIT_FAILURE;
+        }
+        preset = getPresetBankParams(&bank, options.preset);
+        if (!preset) {
+            fprintf(stderr, "No preset %zu in %s (%zu presets)\n", options.preset, options.bankPath, getPresetBankCount(&bank));
+            closePresetBank(&bank);
+            return EXIT_FAILURE;
+        }
+    }
+
+    MilkyPcmSource source;
+    if (openPcmSource(&source, options.inputPath, options.rawSampleRate, options.rawChannels) != 0) {
+        closePresetBank(&bank);
+        return EXIT_FAILURE;
+    }
+
+    size_t frameCount = (size_t)((unsigned long long)source.frameCount * options.fps / source.sampleRate);
+    if (options.maxFrames && options.maxFrames < frameCount) {
+        frameCount = options.maxFrames;
+    }
+
+    FILE *output = NULL;
+    if (options.outputPath) {
+        output = strcmp(options.outputPath, "-") == 0 ? openFrameStdout() : fopen(options.outputPath, "wb");
+        if (!output) {
+            fprintf(stderr, "Failed to open %s for writing\n", options.outputPath);
+            closePcmSource(&source);
+            closePresetBank(&bank);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *goldenFile = NULL;
+    if (options.goldenPath) {
+        goldenFile = fopen(options.goldenPath, "rb");
+        if (!goldenFile) {
+            fprintf(stderr, "Failed to open golden frames %s\n", options.goldenPath);
+            if (output) fclose(output);
+            closePcmSource(&source);
+            closePresetBank(&bank);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t frameSize = options.width * options.height * 4;
+    size_t yuvSize = options.width * options.height + 2 * ((options.width + 1) / 2) * ((options.height + 1) / 2);
+    uint8_t *frame = (uint8_t *)calloc(frameSize, 1);
+    uint8_t *yuv = options.format == MILKY_OUTPUT_Y4M ? (uint8_t *)malloc(yuvSize) : NULL;
+    uint8_t *golden = goldenFile ? (uint8_t *)malloc(frameSize) : NULL;
+    MilkyAnalysis *analysis = (MilkyAnalysis *)calloc(1, sizeof(MilkyAnalysis));
+    MilkyRenderContext *context = createRenderContext();
+    int status = EXIT_SUCCESS;
+    size_t driftedFrames = 0;
+    MilkyFrameError worst = { 0, INFINITY };
+    size_t worstFrame = 0;
+
+    if (!frame || (options.format == MILKY_OUTPUT_Y4M && !yuv) || (goldenFile && !golden) || !analysis || !context) {
+        fprintf(stderr, "Failed to allocate the render state\n");
+        status = EXIT_FAILURE;
+        goto cleanup;
+    }
+
+    if (initAnalysis(analysis, source.sampleRate) != 0) {
+        status = EXIT_FAILURE;
+        goto cleanup;
+    }
+    setRenderThreadCount(context, options.threads);
+    setDitherMode(context, options.dither);
+    if (options.hasSeed) {
+        setRenderSeed(context, options.seed);
+    }
+
+    if (output && options.format == MILKY_OUTPUT_Y4M) {
+        fprintf(output, "YUV4MPEG2 W%zu H%zu F%zu:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n",
+                options.width, options.height, options.fps);
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    size_t rendered = 0;
+    for (; rendered < frameCount; rendered++) {
+        analyzeFrame(analysis, &source, rendered, options.fps);
+
+        // video time starts one frame in, render() treats time 0 as "no previous frame"
+        size_t currentTime = (size_t)((unsigned long long)(rendered + 1) * 1000 / options.fps);
+        renderAudioFeatures(context, frame, options.width, options.height, &analysis->features,
+                            options.bitDepth, preset, 0.035f, currentTime, source.sampleRate);
+
+        if (goldenFile) {
+            if (fread(golden, 1, frameSize, goldenFile) != frameSize) {
+                fprintf(stderr, "Golden frames end before frame %zu\n", rendered);
+                status = EXIT_FAILURE;
+                break;
+            }
+            MilkyFrameError error = compareFrames(frame, golden, frameSize);
+            if (error.maxError > options.maxError || (options.minPsnr > 0 && error.psnr < options.minPsnr)) {
+                if (!driftedFrames) {
+                    fprintf(stderr, "Frame %zu drifted: max error %d, PSNR %.2f dB\n", rendered, error.maxError, error.psnr);
+                }
+                driftedFrames++;
+            }
+            if (error.maxError > worst.maxError) worst.maxError = error.maxError;
+            if (error.psnr < worst.psnr) {
+                worst.psnr = error.psnr;
+                worstFrame = rendered;
+            }
+        }
+
+        if (!output) continue;
+
+        int written;
+        if (options.format == MILKY_OUTPUT_Y4M) {
+            convertToYuv420(frame, options.width, options.height, yuv);
+            fputs("FRAME\n", output);
+            written = fwrite(yuv, 1, yuvSize, output) == yuvSize;
+        } else {
+            written = fwrite(frame, 1, frameSize, output) == frameSize;
+        }
+        if (!written) {
+            fprintf(stderr, "Failed to write frame %zu\n", rendered);
+            status = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    if (!options.quiet) {
+        double seconds = elapsedSeconds(&start);
+        fprintf(stderr, "Rendered %zu frames (%zux%zu, %s kernels) in %.2f s: %.1f fps\n",
+                rendered, options.width, options.height, getKernels()->name, seconds,
+                seconds > 0 ? rendered / seconds : 0.0);
+    }
+
+    if (goldenFile && status == EXIT_SUCCESS) {
+        fprintf(stderr, "Golden comparison: %zu of %zu frames drifted, max error %d, worst PSNR %.2f dB (frame %zu)\n",
+                driftedFrames, rendered, worst.maxError, worst.psnr, worstFrame);
+        if (driftedFrames) status = EXIT_FAILURE;
+    }
+
+cleanup:
+    destroyRenderContext(context);
+    if (analysis) freeAnalysis(analysis);
+    free(analysis);
+    free(golden);
+    free(yuv);
+    free(frame);
+    if (output && fclose(output) != 0) status = EXIT_FAILURE;
+    if (goldenFile) fclose(goldenFile);
+    closePcmSource(&source);
+    closePresetBank(&bank);
+    return status;
+}
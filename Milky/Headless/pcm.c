@@ -0,0 +1,223 @@
+#include "pcm.h"
+
+// WAVE format tags
+#define MILKY_WAVE_FORMAT_PCM 0x0001
+#define MILKY_WAVE_FORMAT_FLOAT 0x0003
+#define MILKY_WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+static uint16_t readLe16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLe32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * Picks the sample encoding of a WAV format chunk.
+ *
+ * @param format        The format tag (after resolving WAVE_FORMAT_EXTENSIBLE).
+ * @param bitsPerSample The container size of one sample.
+ * @param encoding      Receives the encoding.
+ * @return              0 on success, -1 if the format is not supported.
+ */
+static int pickEncoding(uint16_t format, uint16_t bitsPerSample, MilkyPcmEncoding *encoding) {
+    if (format == MILKY_WAVE_FORMAT_FLOAT && bitsPerSample == 32) {
+        *encoding = MILKY_PCM_F32;
+        return 0;
+    }
+    if (format != MILKY_WAVE_FORMAT_PCM) return -1;
+
+    switch (bitsPerSample) {
+        case 8: *encoding = MILKY_PCM_U8; return 0;
+        case 16: *encoding = MILKY_PCM_S16; return 0;
+        case 24: *encoding = MILKY_PCM_S24; return 0;
+        case 32: *encoding = MILKY_PCM_S32; return 0;
+        default: return -1;
+    }
+}
+
+/**
+ * Locates the format and data chunks of a mapped WAV file.
+ *
+ * @param source The source whose mapping is parsed; the stream fields are filled in.
+ * @return       0 on success, -1 if the file is not a supported WAV file.
+ */
+static int parseWave(MilkyPcmSource *source) {
+    const uint8_t *file = (const uint8_t *)source->mapping;
+    size_t size = source->mappingSize;
+    int haveFormat = 0;
+    uint16_t blockAlign = 0;
+
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        const uint8_t *chunk = file + offset;
+        size_t chunkSize = readLe32(chunk + 4);
+        size_t available = size - offset - 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && chunkSize <= available) {
+            uint16_t format = readLe16(chunk + 8);
+            uint16_t bitsPerSample = readLe16(chunk + 22);
+            if (format == MILKY_WAVE_FORMAT_EXTENSIBLE && chunkSize >= 26) {
+                format = readLe16(chunk + 32); // first two bytes of the sub-format GUID
+            }
+            source->channels = readLe16(chunk + 10);
+            source->sampleRate = readLe32(chunk + 12);
+            blockAlign = readLe16(chunk + 20);
+            if (pickEncoding(format, bitsPerSample, &source->encoding) != 0) {
+                fprintf(stderr, "Unsupported WAV format %u with %u bits per sample\n", format, bitsPerSample);
+                return -1;
+            }
+            haveFormat = 1;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat || source->channels == 0 || blockAlign == 0) {
+                fprintf(stderr, "WAV data chunk without a valid format chunk\n");
+                return -1;
+            }
+            // streamed files leave the size open, so never read past the end of the file
+            if (chunkSize > available) chunkSize = available;
+
+            source->data = chunk + 8;
+            source->bytesPerFrame = blockAlign;
+            source->frameCount = chunkSize / blockAlign;
+            return 0;
+        }
+
+        // chunks are padded to an even size
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    fprintf(stderr, "WAV file without a data chunk\n");
+    return -1;
+}
+
+/**
+ * Memory-maps a WAV file or a raw PCM file (interleaved 32-bit float).
+ * Raw files carry no header, so their sample rate and channel count have to be given.
+ *
+ * @param source        Receives the mapped stream.
+ * @param path          The file to map.
+ * @param rawSampleRate The sample rate of raw files.
+ * @param rawChannels   The channel count of raw files.
+ * @return              0 on success, -1 on failure.
+ */
+int openPcmSource(MilkyPcmSource *source, const char *path, size_t rawSampleRate, size_t rawChannels) {
+    memset(source, 0, sizeof(MilkyPcmSource));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        fprintf(stderr, "Failed to read the size of %s or it is empty\n", path);
+        close(fd);
+        return -1;
+    }
+
+    source->mappingSize = (size_t)info.st_size;
+    source->mapping = mmap(NULL, source->mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (source->mapping == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s\n", path);
+        source->mapping = NULL;
+        return -1;
+    }
+
+    // frames are read front to back, exactly once
+    madvise(source->mapping, source->mappingSize, MADV_SEQUENTIAL);
+
+    const uint8_t *file = (const uint8_t *)source->mapping;
+    int isWave = source->mappingSize >= 12 && memcmp(file, "RIFF", 4) == 0 && memcmp(file + 8, "WAVE", 4) == 0;
+    if (isWave) {
+        if (parseWave(source) != 0) {
+            closePcmSource(source);
+            return -1;
+        }
+    } else {
+        if (rawChannels == 0 || rawSampleRate == 0) {
+            fprintf(stderr, "Raw PCM needs a sample rate and a channel count\n");
+            closePcmSource(source);
+            return -1;
+        }
+        source->data = file;
+        source->channels = rawChannels;
+        source->sampleRate = rawSampleRate;
+        source->encoding = MILKY_PCM_F32;
+        source->bytesPerFrame = rawChannels * sizeof(float);
+        source->frameCount = source->mappingSize / source->bytesPerFrame;
+    }
+
+    if (source->sampleRate == 0) {
+        fprintf(stderr, "PCM stream without a sample rate\n");
+        closePcmSource(source);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Unmaps a PCM source.
+ *
+ * @param source The source to close.
+ */
+void closePcmSource(MilkyPcmSource *source) {
+    if (source->mapping) {
+        munmap(source->mapping, source->mappingSize);
+    }
+    memset(source, 0, sizeof(MilkyPcmSource));
+}
+
+/**
+ * Decodes one sample to -1..1.
+ */
+static float decodeSample(const uint8_t *p, MilkyPcmEncoding encoding) {
+    switch (encoding) {
+        case MILKY_PCM_U8:
+            return ((int)p[0] - 128) / 128.0f;
+        case MILKY_PCM_S16:
+            return (int16_t)readLe16(p) / 32768.0f;
+        case MILKY_PCM_S24:
+            return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.0f;
+        case MILKY_PCM_S32:
+            return (int32_t)readLe32(p) / 2147483648.0f;
+        case MILKY_PCM_F32: {
+            uint32_t bits = readLe32(p);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+    }
+    return 0.0f;
+}
+
+/**
+ * Reads sample frames as a mono mix (the average of all channels).
+ * Frames before the start or past the end of the stream read as silence.
+ *
+ * @param source     The stream to read.
+ * @param firstFrame The first frame to read, may be negative.
+ * @param count      The number of frames to read.
+ * @param out        Receives `count` samples.
+ */
+void readPcmMono(const MilkyPcmSource *source, long long firstFrame, size_t count, float *out) {
+    size_t sampleBytes = source->bytesPerFrame / source->channels;
+    float scale = 1.0f / (float)source->channels;
+
+    for (size_t i = 0; i < count; i++) {
+        long long frame = firstFrame + (long long)i;
+        if (frame < 0 || (unsigned long long)frame >= source->frameCount) {
+            out[i] = 0.0f;
+            continue;
+        }
+
+        const uint8_t *p = source->data + (size_t)frame * source->bytesPerFrame;
+        float sum = 0.0f;
+        for (size_t c = 0; c < source->channels; c++) {
+            sum += decodeSample(p + c * sampleBytes, source->encoding);
+        }
+        out[i] = sum * scale;
+    }
+}
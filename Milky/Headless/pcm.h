@@ -0,0 +1,39 @@
+#ifndef PCM_H
+#define PCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// sample encodings understood by the PCM reader (little-endian, interleaved)
+typedef enum {
+    MILKY_PCM_U8 = 0,
+    MILKY_PCM_S16,
+    MILKY_PCM_S24,
+    MILKY_PCM_S32,
+    MILKY_PCM_F32
+} MilkyPcmEncoding;
+
+// a memory-mapped PCM stream, either the data chunk of a WAV file or a raw float file
+typedef struct {
+    void *mapping;          // the whole mapped file
+    size_t mappingSize;
+    const uint8_t *data;    // first sample frame
+    size_t frameCount;      // number of sample frames
+    size_t channels;
+    size_t sampleRate;
+    size_t bytesPerFrame;
+    MilkyPcmEncoding encoding;
+} MilkyPcmSource;
+
+int openPcmSource(MilkyPcmSource *source, const char *path, size_t rawSampleRate, size_t rawChannels);
+void closePcmSource(MilkyPcmSource *source);
+void readPcmMono(const MilkyPcmSource *source, long long firstFrame, size_t count, float *out);
+
+#endif // PCM_H
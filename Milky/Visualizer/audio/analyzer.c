@@ -0,0 +1,188 @@
+#include "analyzer.h"
+
+static uint8_t sampleToByte(float value) {
+    value = (value + 1.0f) * 127.5f;
+    return (uint8_t)(value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value));
+}
+
+// upper edges of the frequency bands in Hz, the last band ends at the Nyquist frequency
+static const float milky_bandEdges[MILKY_BAND_COUNT - 1] = { 250.0f, 4000.0f };
+
+/**
+ * Computes the RMS amplitude of every frequency band of the newest spectrum.
+ * The DC bin belongs to no band.
+ */
+static void measureBands(const MilkyStft *stft, double sampleRate, float *bands) {
+    const double binWidth = sampleRate / (double)stft->size;
+    size_t bin = 1;
+    for (size_t b = 0; b < MILKY_BAND_COUNT; b++) {
+        size_t end = stft->bins;
+        if (b < MILKY_BAND_COUNT - 1) {
+            end = (size_t)(milky_bandEdges[b] / binWidth);
+            if (end > stft->bins) end = stft->bins;
+        }
+
+        double sum = 0.0;
+        size_t count = 0;
+        for (; bin < end; bin++, count++) {
+            sum += (double)stft->magnitudes[bin] * stft->magnitudes[bin];
+        }
+        bands[b] = count ? (float)sqrt(sum / (double)count) : 0.0f;
+    }
+}
+
+/**
+ * Initializes an analyzer.
+ *
+ * @param analyzer       The analyzer to initialize.
+ * @param size           The samples per STFT window; at most twice MILKY_FEATURES_MAX_SPECTRUM.
+ * @param hop            The samples between STFT windows; at most MILKY_FEATURES_MAX_WAVEFORM.
+ * @param windowFunction The window function of the STFT.
+ * @return               0 on success, -1 on failure.
+ */
+int initAnalyzer(MilkyAnalyzer *analyzer, size_t size, size_t hop, MilkyWindowFunction windowFunction) {
+    memset(analyzer, 0, sizeof(MilkyAnalyzer));
+    if (size / 2 > MILKY_FEATURES_MAX_SPECTRUM || hop > MILKY_FEATURES_MAX_WAVEFORM) {
+        fprintf(stderr, "Unsupported analysis of %zu samples at a hop of %zu\n", size, hop);
+        return -1;
+    }
+    if (initStft(&analyzer->stft, size, hop, windowFunction) != 0) {
+        return -1;
+    }
+    initEnergyState(&analyzer->energy);
+    analyzer->spectrumLength = analyzer->stft.bins;
+    return 0;
+}
+
+/**
+ * Frees the STFT of an analyzer.
+ *
+ * @param analyzer The analyzer to free.
+ */
+void freeAnalyzer(MilkyAnalyzer *analyzer) {
+    freeStft(&analyzer->stft);
+}
+
+/**
+ * Analyzes every hop the ring holds since the last call (as its only consumer): computes
+ * the spectrum of each window and runs the energy spike detector on it, so the detector
+ * sees a steady stream of spectra at the hop rate, whatever the caller's rate. When the
+ * sample rate of the ring changed, the detector is set up for the new rate first.
+ *
+ * @param analyzer The analyzer.
+ * @param ring     The ring to read.
+ * @return         The number of spectra computed.
+ */
+size_t analyzeSamples(MilkyAnalyzer *analyzer, MilkySampleRing *ring) {
+    MilkyStft *stft = &analyzer->stft;
+    size_t spectra = 0;
+
+    // the detector derives its bins, filter and weights from the rate on its first call
+    double sampleRate = getSampleRingRate(ring);
+    if (sampleRate != analyzer->sampleRate) {
+        analyzer->energy.initialized = 0;
+        analyzer->sampleRate = sampleRate;
+    }
+
+    while (nextStftFrame(stft, ring) == 0) {
+        // doubled, like the vDSP spectrum the renderer's thresholds were tuned with
+        for (size_t k = 0; k < stft->bins; k++) {
+            float value = 2.0f * stft->magnitudes[k] * 127.5f + 128.0f;
+            analyzer->spectrum[k] = (uint8_t)(value > 255.0f ? 255.0f : value);
+        }
+
+        // the samples this window added to the previous one
+        const float *added = stft->samples + stft->size - stft->hop;
+        for (size_t i = 0; i < stft->hop; i++) {
+            analyzer->hopWaveform[i] = sampleToByte(added[i]);
+        }
+
+        detectEnergySpike(&analyzer->energy, analyzer->hopWaveform, analyzer->spectrum, stft->hop,
+                          analyzer->spectrumLength, (size_t)sampleRate, (float)(stft->hop / sampleRate));
+        analyzer->spikePending |= analyzer->energy.spikeDetected;
+        spectra++;
+    }
+    return spectra;
+}
+
+/**
+ * Fills a feature snapshot from the analyzed spectra and the newest samples of the ring,
+ * and starts collecting spikes for the next one.
+ *
+ * @param analyzer The analyzer.
+ * @param ring     The ring analyzeSamples() reads.
+ * @param features Receives the features; every field is written.
+ * @return         0 on success, -1 if the ring does not hold a full waveform yet.
+ */
+int collectAudioFeatures(MilkyAnalyzer *analyzer, MilkySampleRing *ring, MilkyAudioFeatures *features) {
+    MilkySampleWindow window;
+    double sampleRate = getSampleRingRate(ring);
+    if (readLatestSamples(ring, analyzer->latest, MILKY_FEATURES_MAX_WAVEFORM, &window) != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < MILKY_FEATURES_MAX_WAVEFORM; i++) {
+        features->waveform[i] = sampleToByte(analyzer->latest[i]);
+    }
+    memcpy(features->spectrum, analyzer->spectrum, analyzer->spectrumLength);
+    memset(features->spectrum + analyzer->spectrumLength, 0, MILKY_FEATURES_MAX_SPECTRUM - analyzer->spectrumLength);
+    features->waveformLength = MILKY_FEATURES_MAX_WAVEFORM;
+    features->spectrumLength = analyzer->spectrumLength;
+    features->timestamp = window.time + window.length / sampleRate;
+    features->energy = analyzer->energy.energy;
+    features->spikeDetected = analyzer->spikePending;
+    measureBands(&analyzer->stft, sampleRate, features->bands);
+    analyzer->spikePending = 0;
+    return 0;
+}
+
+/**
+ * Feeds a sine to an analyzer through a ring (the self-test's helper).
+ */
+static void feedTestSine(MilkyAnalyzer *analyzer, MilkySampleRing *ring, size_t count, float frequency) {
+    float chunk[MILKY_ANALYZER_HOP];
+    double sampleRate = getSampleRingRate(ring);
+    for (size_t written = 0; written < count; written += MILKY_ANALYZER_HOP) {
+        for (size_t i = 0; i < MILKY_ANALYZER_HOP; i++) {
+            chunk[i] = 0.5f * (float)sin(2.0 * M_PI * frequency * (double)(written + i) / sampleRate);
+        }
+        writeSampleRing(ring, chunk, MILKY_ANALYZER_HOP, 1);
+        analyzeSamples(analyzer, ring);
+    }
+}
+
+/**
+ * Checks that the energy detector of an analyzer follows a change of the ring's sample
+ * rate: its bin width and low-pass filter must match a detector set up for the new rate.
+ *
+ * @return The number of failed checks, 0 if the analyzer passed.
+ */
+size_t verifyAnalyzer(void) {
+    static MilkyAnalyzer analyzer;
+    MilkySampleRing ring;
+    size_t failures = 0;
+
+    if (initSampleRing(&ring, 4 * MILKY_ANALYZER_WINDOW, 44100.0) != 0) {
+        return 1;
+    }
+    if (initAnalyzer(&analyzer, MILKY_ANALYZER_WINDOW, MILKY_ANALYZER_HOP, MILKY_ANALYZER_WINDOW_FUNCTION) != 0) {
+        freeSampleRing(&ring);
+        return 1;
+    }
+
+    const double rates[] = { 44100.0, 48000.0 };
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        setSampleRingRate(&ring, rates[r]);
+        feedTestSine(&analyzer, &ring, 2 * MILKY_ANALYZER_WINDOW, 100.0f);
+
+        BiquadFilter expected;
+        initLowPassFilter(&expected, MILKY_CUTOFF_FREQUENCY_HZ, (float)(size_t)rates[r], 1.0f);
+        const MilkyEnergyState *energy = &analyzer.energy;
+        failures += energy->frequencyBinWidth != (size_t)rates[r] / (2.0f * analyzer.spectrumLength);
+        failures += energy->lpFilter.a0 != expected.a0 || energy->lpFilter.b1 != expected.b1;
+    }
+
+    freeAnalyzer(&analyzer);
+    freeSampleRing(&ring);
+    return failures;
+}
@@ -0,0 +1,50 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ring.h"
+#include "stft.h"
+#include "energy.h"
+#include "features.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the analysis of the app and the headless renderer: Hann windows of 1024 samples every
+// 256 samples (75% overlap), about 172 spectra per second at 44.1 kHz
+#define MILKY_ANALYZER_WINDOW 1024
+#define MILKY_ANALYZER_HOP 256
+#define MILKY_ANALYZER_WINDOW_FUNCTION MILKY_WINDOW_HANN
+
+// turns the samples of a ring into audio features: a windowed STFT runs over the stream at
+// a fixed hop, every spectrum goes through the energy spike detector together with the
+// samples of its hop, and a snapshot takes the newest spectrum, the newest samples as its
+// waveform, the levels of its frequency bands and whether any hop since the previous
+// snapshot detected a spike
+typedef struct {
+    MilkyStft stft;
+    MilkyEnergyState energy;
+    size_t spectrumLength;
+    uint8_t spectrum[MILKY_FEATURES_MAX_SPECTRUM];  // newest spectrum, in the 8-bit layout
+    uint8_t hopWaveform[MILKY_FEATURES_MAX_WAVEFORM]; // newest hop of samples, in the 8-bit layout
+    float latest[MILKY_FEATURES_MAX_WAVEFORM];
+    int spikePending;         // a hop detected a spike since the last snapshot
+    double sampleRate;        // rate the detector was set up for, see analyzeSamples()
+} MilkyAnalyzer;
+
+int initAnalyzer(MilkyAnalyzer *analyzer, size_t size, size_t hop, MilkyWindowFunction windowFunction);
+void freeAnalyzer(MilkyAnalyzer *analyzer);
+size_t analyzeSamples(MilkyAnalyzer *analyzer, MilkySampleRing *ring);
+int collectAudioFeatures(MilkyAnalyzer *analyzer, MilkySampleRing *ring, MilkyAudioFeatures *features);
+size_t verifyAnalyzer(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANALYZER_H
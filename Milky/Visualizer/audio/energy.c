@@ -1,16 +1,14 @@
 #include "energy.h"
 
-int milky_energyEnergySpikeDetected = 0;
-
-// State preservation across function calls
-static float milky_energyAvgEnergy = 0.0f;
-static float milky_energyAvgFlux = 0.0f;
-static int milky_energyDetectionCooldownCounter = MILKY_COOLDOWN_PERIOD; // Counter for cooldown period
-static float milky_energyPreviousSpectrum[MILKY_MAX_SPECTRUM_LENGTH] = {0};
-static float milky_energyWeights[MILKY_MAX_SPECTRUM_LENGTH] = {0};
-static size_t milky_energyMaxBin = 0;
-static float milky_energyFrequencyBinWidth = 0.0f;
-static int milky_energyEnergySpikeDetectionInitialized = 0;
+/**
+ * Resets the detector state; the filter and weights are set up on the first detection.
+ *
+ * @param state The detector state to initialize.
+ */
+void initEnergyState(MilkyEnergyState *state) {
+    memset(state, 0, sizeof(MilkyEnergyState));
+    state->detectionCooldownCounter = INT32_MAX; // the first call may detect already
+}
 
 /**
  * Initializes a low-pass biquad filter with a strong Q factor for sharp cutoff at 500 Hz.
@@ -84,47 +82,57 @@ void applyLowPassFilter(BiquadFilter *filter, float *samples, size_t length) {
 /**
  * Analyzes the given waveform and spectrum data to detect
  * significant energy spikes, which are indicative of beat /energy spikes.
+ * The cooldown, the smoothing of the averages and the span the flux is measured over are
+ * set in seconds; the interval between calls turns them into calls, so the detector
+ * behaves alike whether it runs once per frame or once per hop.
  *
+ * @param state              the detector state of the render context.
  * @param emphasizedWaveform pointer to the waveform data array (8-bit unsigned integers).
  * @param spectrum           pointer to the spectrum data array.
  * @param waveformLength     length of the waveform data array.
  * @param spectrumLength     length of the spectrum data array.
  * @param sampleRate         the sample rate of the audio data.
+ * @param interval           the seconds since the previous call: a video frame when called per
+ *                           frame, a hop of the STFT when called per spectrum.
  */
 void detectEnergySpike(
+    MilkyEnergyState *state,
     const uint8_t *emphasizedWaveform,
     const uint8_t *spectrum,
     size_t waveformLength,
     size_t spectrumLength,
-    size_t sampleRate
+    size_t sampleRate,
+    float interval
 ) {
     // constants for adaptive energy and flux
-    const float energy_alpha = 0.85f;          // smoothing factor for energy
-    const float flux_alpha = 0.85f;            // smoothing factor for flux
+    if (!(interval > 0.0f)) interval = MILKY_DETECTOR_FRAME_SECONDS;
+    const float energy_alpha = expf(-interval / MILKY_SMOOTHING_SECONDS); // smoothing factor for energy
+    const float flux_alpha = energy_alpha;     // smoothing factor for flux
+    const int cooldown_calls = (int)lrintf(MILKY_COOLDOWN_SECONDS / interval) - 1; // calls to skip after a detection
     const float energy_threshold = 1.3f;       // threshold for energy ratio
     const float flux_threshold = 1.4f;         // threshold for flux ratio
     const float min_volume_threshold = 0.15f;  // minimum volume threshold for detection
 
     // initialize detection parameters and filter if not already done
-    static BiquadFilter lpFilter;
-    if (!milky_energyEnergySpikeDetectionInitialized) {
+    BiquadFilter *lpFilter = &state->lpFilter;
+    if (!state->initialized) {
         // calculate the frequency bin width for the spectrum
-        milky_energyFrequencyBinWidth = sampleRate / (2.0f * spectrumLength);
+        state->frequencyBinWidth = sampleRate / (2.0f * spectrumLength);
         
         // initialize low-pass filter for 500 Hz cutoff
-        initLowPassFilter(&lpFilter, MILKY_CUTOFF_FREQUENCY_HZ, sampleRate, 1.0f); // Q factor of 1.0 for strong cutoff
+        initLowPassFilter(lpFilter, MILKY_CUTOFF_FREQUENCY_HZ, sampleRate, 1.0f); // Q factor of 1.0 for strong cutoff
 
         // determine the low-frequency maximum bin (under 500 Hz)
-        milky_energyMaxBin = (size_t)(MILKY_CUTOFF_FREQUENCY_HZ / milky_energyFrequencyBinWidth);
-        if (milky_energyMaxBin > spectrumLength) milky_energyMaxBin = spectrumLength;
-        if (milky_energyMaxBin > MILKY_MAX_SPECTRUM_LENGTH) milky_energyMaxBin = MILKY_MAX_SPECTRUM_LENGTH;
+        state->maxBin = (size_t)(MILKY_CUTOFF_FREQUENCY_HZ / state->frequencyBinWidth);
+        if (state->maxBin > spectrumLength) state->maxBin = spectrumLength;
+        if (state->maxBin > MILKY_MAX_SPECTRUM_LENGTH) state->maxBin = MILKY_MAX_SPECTRUM_LENGTH;
 
         // emphasize low frequencies in weights
-        for (size_t i = 0; i < milky_energyMaxBin; i++) {
-            float frequency = (i + 1) * milky_energyFrequencyBinWidth;
-            milky_energyWeights[i] = 1.0f / (frequency + 1e-6f); // avoid division by zero
+        for (size_t i = 0; i < state->maxBin; i++) {
+            float frequency = (i + 1) * state->frequencyBinWidth;
+            state->weights[i] = 1.0f / (frequency + 1e-6f); // avoid division by zero
         }
-        milky_energyEnergySpikeDetectionInitialized = 1;
+        state->initialized = 1;
     }
 
     // apply low-pass filter to the waveform
@@ -132,7 +140,7 @@ void detectEnergySpike(
     size_t length = (waveformLength < MILKY_MAX_WAVEFORM_LENGTH) ? waveformLength : MILKY_MAX_WAVEFORM_LENGTH;
     for (size_t i = 0; i < length; i++) {
         // center the waveform data and apply the filter
-        filtered_waveform[i] = processSample(&lpFilter, (float)emphasizedWaveform[i] - 128.0f);
+        filtered_waveform[i] = processSample(lpFilter, (float)emphasizedWaveform[i] - 128.0f);
     }
 
     // calculate filtered energy using the low-pass filtered waveform
@@ -142,60 +150,78 @@ void detectEnergySpike(
         filtered_energy += filtered_waveform[i] * filtered_waveform[i];
     }
 
-    // compute RMS energy from the accumulated energy
-    float current_energy = sqrtf(filtered_energy / length);
+    // energy and flux span one tuning frame: the calls of that span are kept in the histories
+    long lag = lrintf(MILKY_DETECTOR_FRAME_SECONDS / interval);
+    lag = lag < 1 ? 1 : (lag > MILKY_FLUX_HISTORY - 1 ? MILKY_FLUX_HISTORY - 1 : lag);
+    size_t slot = state->historyIndex;
+    size_t bins = (spectrumLength < MILKY_MAX_SPECTRUM_LENGTH) ? spectrumLength : MILKY_MAX_SPECTRUM_LENGTH;
+    state->squareHistory[slot] = filtered_energy;
+    state->sampleHistory[slot] = length;
+    memcpy(state->spectrumHistory[slot], spectrum, bins);
+    state->historyIndex = (slot + 1) % MILKY_FLUX_HISTORY;
+
+    // compute RMS energy from the accumulated energy of the span
+    size_t span_length = 0;
+    filtered_energy = 0.0f;
+    for (long i = 0; i < lag; i++) {
+        size_t past = (slot + MILKY_FLUX_HISTORY - i) % MILKY_FLUX_HISTORY;
+        filtered_energy += state->squareHistory[past];
+        span_length += state->sampleHistory[past];
+    }
+    float current_energy = sqrtf(filtered_energy / span_length);
+    state->energy = current_energy;
     
     // apply a noise gate: skip detection if the signal is below the noise threshold
     if (current_energy < MILKY_NOISE_GATE_THRESHOLD) {
-        milky_energyEnergySpikeDetected = 0;
+        state->spikeDetected = 0;
         return; // exit early for low-amplitude sections
     }
 
     // update average energy using exponential moving average
-    milky_energyAvgEnergy = milky_energyAvgEnergy * energy_alpha + current_energy * (1.0f - energy_alpha);
+    state->avgEnergy = state->avgEnergy * energy_alpha + current_energy * (1.0f - energy_alpha);
     // calculate energy ratio for detection
-    float energy_ratio = current_energy / (milky_energyAvgEnergy + 1e-6f);
+    float energy_ratio = current_energy / (state->avgEnergy + 1e-6f);
 
     // calculate spectral flux with adaptive frequency emphasis
     float spectral_flux = 0.0f;
     float sum_weights = 0.0f;
-    size_t bins = (spectrumLength < MILKY_MAX_SPECTRUM_LENGTH) ? spectrumLength : MILKY_MAX_SPECTRUM_LENGTH;
+
+    // compare with the spectrum one span ago
+    const uint8_t *previous = state->spectrumHistory[(slot + MILKY_FLUX_HISTORY - lag) % MILKY_FLUX_HISTORY];
 
     for (size_t i = 0; i < bins; i++) {
         // calculate the difference in spectrum values
-        float diff = (float)spectrum[i] - milky_energyPreviousSpectrum[i];
-        // update previous spectrum for the next iteration
-        milky_energyPreviousSpectrum[i] = (float)spectrum[i];
+        float diff = (float)spectrum[i] - (float)previous[i];
 
         if (diff > 0) {
             // accumulate positive flux weighted by frequency emphasis
-            spectral_flux += diff * milky_energyWeights[i];
+            spectral_flux += diff * state->weights[i];
         }
         // accumulate weights for normalization
-        sum_weights += milky_energyWeights[i];
+        sum_weights += state->weights[i];
     }
 
     // normalize spectral flux if weights are non-zero
     if (sum_weights > 0.0f) spectral_flux /= sum_weights;
     // update flux average using exponential moving average
-    milky_energyAvgFlux = milky_energyAvgFlux * flux_alpha + spectral_flux * (1.0f - flux_alpha);
+    state->avgFlux = state->avgFlux * flux_alpha + spectral_flux * (1.0f - flux_alpha);
     // calculate flux ratio for detection
-    float flux_ratio = spectral_flux / (milky_energyAvgFlux + 1e-6f);
+    float flux_ratio = spectral_flux / (state->avgFlux + 1e-6f);
 
     // check cooldown counter before allowing a beat detection
-    if (milky_energyDetectionCooldownCounter >= MILKY_COOLDOWN_PERIOD &&
+    if (state->detectionCooldownCounter >= cooldown_calls &&
         energy_ratio > energy_threshold && 
         flux_ratio > flux_threshold && 
         current_energy > min_volume_threshold) 
     {
         // signal energy spike detection
         printf("native:SIGNAL:SIG_ENERGY\n");
-        milky_energyEnergySpikeDetected = 1;
+        state->spikeDetected = 1;
         // reset cooldown counter after detection
-        milky_energyDetectionCooldownCounter = 0;
+        state->detectionCooldownCounter = 0;
     } else {
-        milky_energyEnergySpikeDetected = 0;
+        state->spikeDetected = 0;
         // increment counter when no detection occurs
-        milky_energyDetectionCooldownCounter++;
+        if (state->detectionCooldownCounter < INT32_MAX) state->detectionCooldownCounter++;
     }
 }
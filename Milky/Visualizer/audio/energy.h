@@ -5,31 +5,63 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #define MILKY_MAX_SPECTRUM_LENGTH 1024
 #define MILKY_MAX_WAVEFORM_LENGTH 1024
 #define MILKY_CUTOFF_FREQUENCY_HZ 500
 #define MILKY_ADAPTIVE_SCALE_THRESHOLD 0.75f // Adaptive threshold for selecting dominant scales
 #define MILKY_NOISE_GATE_THRESHOLD 0.5f     // Minimum energy threshold for beat detection
-#define MILKY_COOLDOWN_PERIOD 3            // Minimum number of calls between detections
+#define MILKY_DETECTOR_FRAME_SECONDS (1.0f / 60.0f) // Call interval the thresholds were tuned at, one video frame
+#define MILKY_COOLDOWN_SECONDS 0.12f        // Minimum time between detections, short of an eighth note at 240 BPM
+#define MILKY_SMOOTHING_SECONDS 0.1026f     // Time constant of the energy and flux averages (0.85 per call at 60 fps)
+#define MILKY_FLUX_HISTORY 8                // Calls kept to measure energy and flux over one tuning frame
 #define MILKY_PI 3.14159265358979323846
 
-extern int milky_energyEnergySpikeDetected;
-
 typedef struct {
     float a0, a1, a2, b1, b2; // Filter coefficients
     float z1, z2;             // Filter delay elements
 } BiquadFilter;
 
+// state of the energy spike detector, preserved across frames
+typedef struct {
+    int spikeDetected;       // set on frames with a detected energy spike
+    float energy;            // RMS energy of the last low-passed waveform
+    float avgEnergy;
+    float avgFlux;
+    int detectionCooldownCounter; // calls since the last detection
+    uint8_t spectrumHistory[MILKY_FLUX_HISTORY][MILKY_MAX_SPECTRUM_LENGTH]; // previous spectra, a ring
+    float squareHistory[MILKY_FLUX_HISTORY]; // summed squares of the filtered samples of previous calls
+    size_t sampleHistory[MILKY_FLUX_HISTORY];  // and their sample counts
+    size_t historyIndex;     // slot of the next call in the histories
+    float weights[MILKY_MAX_SPECTRUM_LENGTH];
+    size_t maxBin;
+    float frequencyBinWidth;
+    int initialized;
+    BiquadFilter lpFilter;
+} MilkyEnergyState;
+
+void initEnergyState(MilkyEnergyState *state);
+
 void initLowPassFilter(BiquadFilter *filter, float cutoffFreq, float sampleRate, float Q);
 float processSample(BiquadFilter *filter, float input);
 void applyLowPassFilter(BiquadFilter *filter, float *samples, size_t length);
 void detectEnergySpike(
+    MilkyEnergyState *state,
     const uint8_t *emphasizedWaveform,
     const uint8_t *spectrum,
     size_t waveformLength,
     size_t spectrumLength,
-    size_t sampleRate
+    size_t sampleRate,
+    float interval
 );
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // ENERGY_H
@@ -0,0 +1,54 @@
+#include "features.h"
+
+// flag of MilkyFeatureExchange.latest: the buffer holds a snapshot the reader has not taken yet
+#define MILKY_FEATURES_FRESH 4u
+
+/**
+ * Initializes an exchange with three empty snapshots (sequence 0, no samples).
+ *
+ * @param exchange The exchange to initialize.
+ */
+void initFeatureExchange(MilkyFeatureExchange *exchange) {
+    memset(exchange, 0, sizeof(MilkyFeatureExchange));
+    exchange->front = 0;
+    exchange->latest = 1;
+    exchange->back = 2;
+}
+
+/**
+ * Returns the buffer the writer fills next. It is not visible to the reader until
+ * publishFeatures(), and holds an older snapshot, so every field has to be rewritten.
+ *
+ * @param exchange The exchange.
+ * @return         The writer's buffer.
+ */
+MilkyAudioFeatures *beginFeatureWrite(MilkyFeatureExchange *exchange) {
+    return &exchange->buffers[exchange->back];
+}
+
+/**
+ * Publishes the writer's buffer as the newest snapshot and takes over the buffer of the
+ * snapshot it replaces. Numbers the snapshot.
+ *
+ * @param exchange The exchange.
+ */
+void publishFeatures(MilkyFeatureExchange *exchange) {
+    exchange->buffers[exchange->back].sequence = ++exchange->published;
+    uint32_t previous = __atomic_exchange_n(&exchange->latest, exchange->back | MILKY_FEATURES_FRESH, __ATOMIC_ACQ_REL);
+    exchange->back = previous & ~MILKY_FEATURES_FRESH;
+}
+
+/**
+ * Returns the newest snapshot to the reader. The snapshot stays valid and unchanged until
+ * the next call, so a frame can read it in place from start to end.
+ *
+ * @param exchange The exchange.
+ * @return         The newest published snapshot, or an empty one (sequence 0) before the first.
+ */
+const MilkyAudioFeatures *acquireFeatures(MilkyFeatureExchange *exchange) {
+    if (__atomic_load_n(&exchange->latest, __ATOMIC_RELAXED) & MILKY_FEATURES_FRESH) {
+        uint32_t newest = __atomic_exchange_n(&exchange->latest, exchange->front, __ATOMIC_ACQ_REL);
+        exchange->front = newest & ~MILKY_FEATURES_FRESH;
+    }
+    return &exchange->buffers[exchange->front];
+}
@@ -0,0 +1,64 @@
+#ifndef FEATURES_H
+#define FEATURES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MILKY_FEATURES_MAX_WAVEFORM 1024
+#define MILKY_FEATURES_MAX_SPECTRUM 2048
+
+// frequency bands of MilkyAudioFeatures.bands
+typedef enum {
+    MILKY_BAND_BASS,          // up to 250 Hz
+    MILKY_BAND_MIDS,          // 250 Hz to 4 kHz
+    MILKY_BAND_TREBLE,        // above 4 kHz
+    MILKY_BAND_COUNT
+} MilkyFrequencyBand;
+
+// audio features of one moment, in the 8-bit layout render() expects
+typedef struct {
+    uint64_t sequence;        // number of the snapshot, counting from 1; 0 = nothing published yet
+    double timestamp;         // time of the newest analyzed sample in seconds (sample clock)
+    size_t waveformLength;
+    size_t spectrumLength;
+    float energy;             // RMS energy of the low-passed waveform, in 8-bit sample units
+    int spikeDetected;        // whether an energy spike was detected
+    float bands[MILKY_BAND_COUNT]; // RMS amplitude of the newest spectrum per band, 1 = full-scale sine
+    uint8_t waveform[MILKY_FEATURES_MAX_WAVEFORM];
+    uint8_t spectrum[MILKY_FEATURES_MAX_SPECTRUM];
+} MilkyAudioFeatures;
+
+// hands feature snapshots from one writer (the analysis) to one reader (the renderer)
+// through three buffers: the writer fills its own, the reader keeps reading its own for
+// as long as it likes, and the newest complete snapshot waits in the third. Publishing
+// and acquiring exchange buffer indices with a single atomic operation; no snapshot is
+// copied, and neither side ever waits for the other.
+typedef struct {
+    MilkyAudioFeatures buffers[3];
+
+    // index of the newest published buffer, with MILKY_FEATURES_FRESH while the reader has not taken it
+    uint32_t latest __attribute__((aligned(MILKY_RING_LINE)));
+
+    uint32_t back __attribute__((aligned(MILKY_RING_LINE))); // the writer's buffer
+    uint64_t published;                                       // snapshots published so far
+
+    uint32_t front __attribute__((aligned(MILKY_RING_LINE))); // the reader's buffer
+} MilkyFeatureExchange;
+
+void initFeatureExchange(MilkyFeatureExchange *exchange);
+MilkyAudioFeatures *beginFeatureWrite(MilkyFeatureExchange *exchange);
+void publishFeatures(MilkyFeatureExchange *exchange);
+const MilkyAudioFeatures *acquireFeatures(MilkyFeatureExchange *exchange);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FEATURES_H
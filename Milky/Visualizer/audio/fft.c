@@ -0,0 +1,576 @@
+/*
+ Real-input FFT for the audio analysis.
+
+ A real transform of n samples is computed as a complex transform of n/2 points, whose
+ real parts are the even samples and whose imaginary parts are the odd ones, followed by
+ a split step that separates the two interleaved spectra again. The complex transform is
+ an in-place decimation-in-time FFT over bit-reversed input: pairs of radix-2 stages are
+ fused into radix-4 passes, which need three complex multiplications per four points
+ instead of four and read the data half as often, and a single radix-2 pass finishes odd
+ stage counts.
+
+ Every pass runs over contiguous twiddles, so its inner loop vectorizes directly. The
+ passes come in one implementation per instruction set, picked once like the pixel kernels
+ (see video/kernels.c); a pass narrower than the vectors falls back to the next narrower
+ implementation. Spectra of different sets agree to float rounding, not bit for bit.
+*/
+
+#include "fft.h"
+
+// a complex pass over all `count` points of the transform, of span `span` (see below)
+typedef void (*MilkyFftPass)(float *re, float *im, size_t count, size_t span, const float *twiddleRe, const float *twiddleIm);
+
+typedef struct {
+    const char *name;
+
+    // two radix-2 stages of span h and 2h, fused: blocks of 4h points
+    MilkyFftPass radix4;
+
+    // one radix-2 stage of span h: blocks of 2h points
+    MilkyFftPass radix2;
+} MilkyFftVariant;
+
+// ---------------------------------------------------------------------------------------
+// scalar reference
+
+static void radix4Scalar(float *re, float *im, size_t count, size_t span, const float *twiddleRe, const float *twiddleIm) {
+    const size_t h = span;
+    if (h == 1) {
+        // the first pass: all twiddles are 1 (and -i), so it only adds
+        for (size_t start = 0; start < count; start += 4) {
+            float *r = re + start, *i = im + start;
+            float sr = r[0] + r[1], si = i[0] + i[1];
+            float er = r[0] - r[1], ei = i[0] - i[1];
+            float cr = r[2] + r[3], ci = i[2] + i[3];
+            float fr = r[2] - r[3], fi = i[2] - i[3];
+            r[0] = sr + cr; i[0] = si + ci;
+            r[2] = sr - cr; i[2] = si - ci;
+            r[1] = er + fi; i[1] = ei - fr;
+            r[3] = er - fi; i[3] = ei + fr;
+        }
+        return;
+    }
+    const float *w1r = twiddleRe + h - 1, *w1i = twiddleIm + h - 1;
+    const float *w2r = twiddleRe + 2 * h - 1, *w2i = twiddleIm + 2 * h - 1;
+
+    for (size_t start = 0; start < count; start += 4 * h) {
+        float *r0 = re + start, *r1 = r0 + h, *r2 = r1 + h, *r3 = r2 + h;
+        float *i0 = im + start, *i1 = i0 + h, *i2 = i1 + h, *i3 = i2 + h;
+        for (size_t k = 0; k < h; k++) {
+            // first stage: (0, 1) and (2, 3) with the twiddle of span h
+            float br = r1[k] * w1r[k] - i1[k] * w1i[k];
+            float bi = r1[k] * w1i[k] + i1[k] * w1r[k];
+            float dr = r3[k] * w1r[k] - i3[k] * w1i[k];
+            float di = r3[k] * w1i[k] + i3[k] * w1r[k];
+            float ar = r0[k] + br, ai = i0[k] + bi;
+            float er = r0[k] - br, ei = i0[k] - bi;
+            float cr = r2[k] + dr, ci = i2[k] + di;
+            float fr = r2[k] - dr, fi = i2[k] - di;
+
+            // second stage: (0, 2) with the twiddle of span 2h, (1, 3) with the same times -i
+            float tr = cr * w2r[k] - ci * w2i[k];
+            float ti = cr * w2i[k] + ci * w2r[k];
+            float ur = fr * w2i[k] + fi * w2r[k];
+            float ui = fi * w2i[k] - fr * w2r[k];
+
+            r0[k] = ar + tr; i0[k] = ai + ti;
+            r2[k] = ar - tr; i2[k] = ai - ti;
+            r1[k] = er + ur; i1[k] = ei + ui;
+            r3[k] = er - ur; i3[k] = ei - ui;
+        }
+    }
+}
+
+static void radix2Scalar(float *re, float *im, size_t count, size_t span, const float *twiddleRe, const float *twiddleIm) {
+    const size_t h = span;
+    const float *wr = twiddleRe + h - 1, *wi = twiddleIm + h - 1;
+
+    for (size_t start = 0; start < count; start += 2 * h) {
+        float *r0 = re + start, *r1 = r0 + h;
+        float *i0 = im + start, *i1 = i0 + h;
+        for (size_t k = 0; k < h; k++) {
+            float tr = r1[k] * wr[k] - i1[k] * wi[k];
+            float ti = r1[k] * wi[k] + i1[k] * wr[k];
+            r1[k] = r0[k] - tr; i1[k] = i0[k] - ti;
+            r0[k] += tr; i0[k] += ti;
+        }
+    }
+}
+
+static const MilkyFftVariant milky_fftScalar = { "scalar", radix4Scalar, radix2Scalar };
+
+// ---------------------------------------------------------------------------------------
+// SSE2
+
+#if defined(__SSE2__)
+#define MILKY_FFT_SSE2 1
+
+static void radix4Sse2(float *re, float *im, size_t count, size_t span, const float *twiddleRe, const float *twiddleIm) {
+    const size_t h = span;
+    if (h < 4) {
+        radix4Scalar(re, im, count, span, twiddleRe, twiddleIm);
+        return;
+    }
+    const float *w1r = twiddleRe + h - 1, *w1i = twiddleIm + h - 1;
+    const float *w2r = twiddleRe + 2 * h - 1, *w2i = twiddleIm + 2 * h - 1;
+
+    for (size_t start = 0; start < count; start += 4 * h) {
+        float *r0 = re + start, *r1 = r0 + h, *r2 = r1 + h, *r3 = r2 + h;
+        float *i0 = im + start, *i1 = i0 + h, *i2 = i1 + h, *i3 = i2 + h;
+        for (size_t k = 0; k < h; k += 4) {
+            __m128 ar1 = _mm_loadu_ps(w1r + k), ai1 = _mm_loadu_ps(w1i + k);
+            __m128 ar2 = _mm_loadu_ps(w2r + k), ai2 = _mm_loadu_ps(w2i + k);
+            __m128 x0r = _mm_loadu_ps(r0 + k), x0i = _mm_loadu_ps(i0 + k);
+            __m128 x1r = _mm_loadu_ps(r1 + k), x1i = _mm_loadu_ps(i1 + k);
+            __m128 x2r = _mm_loadu_ps(r2 + k), x2i = _mm_loadu_ps(i2 + k);
+            __m128 x3r = _mm_loadu_ps(r3 + k), x3i = _mm_loadu_ps(i3 + k);
+
+            __m128 br = _mm_sub_ps(_mm_mul_ps(x1r, ar1), _mm_mul_ps(x1i, ai1));
+            __m128 bi = _mm_add_ps(_mm_mul_ps(x1r, ai1), _mm_mul_ps(x1i, ar1));
+            __m128 dr = _mm_sub_ps(_mm_mul_ps(x3r, ar1), _mm_mul_ps(x3i, ai1));
+            __m128 di = _mm_add_ps(_mm_mul_ps(x3r, ai1), _mm_mul_ps(x3i, ar1));
+            __m128 sr = _mm_add_ps(x0r, br), si = _mm_add_ps(x0i, bi);
+            __m128 er = _mm_sub_ps(x0r, br), ei = _mm_sub_ps(x0i, bi);
+            __m128 cr = _mm_add_ps(x2r, dr), ci = _mm_add_ps(x2i, di);
+            __m128 fr = _mm_sub_ps(x2r, dr), fi = _mm_sub_ps(x2i, di);
+
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(cr, ar2), _mm_mul_ps(ci, ai2));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(cr, ai2), _mm_mul_ps(ci, ar2));
+            __m128 ur = _mm_add_ps(_mm_mul_ps(fr, ai2), _mm_mul_ps(fi, ar2));
+            __m128 ui = _mm_sub_ps(_mm_mul_ps(fi, ai2), _mm_mul_ps(fr, ar2));
+
+            _mm_storeu_ps(r0 + k, _mm_add_ps(sr, tr)); _mm_storeu_ps(i0 + k, _mm_add_ps(si, ti));
+            _mm_storeu_ps(r2 + k, _mm_sub_ps(sr, tr)); _mm_storeu_ps(i2 + k, _mm_sub_ps(si, ti));
+            _mm_storeu_ps(r1 + k, _mm_add_ps(er, ur)); _mm_storeu_ps(i1 + k, _mm_add_ps(ei, ui));
+            _mm_storeu_ps(r3 + k, _mm_sub_ps(er, ur)); _mm_storeu_ps(i3 + k, _mm_sub_ps(ei, ui));
+        }
+    }
+}
+
+static void radix2Sse2(float *re, float *im, size_t count, size_t span, const float *twiddleRe, const float *twiddleIm) {
+    const size_t h = span;
+    if (h < 4) {
+        radix2Scalar(re, im, count, span, twiddleRe, twiddleIm);
+        return;
+    }
+    const float *wr = twiddleRe + h - 1, *wi = twiddleIm + h - 1;
+
+    for (size_t start = 0; start < count; start += 2 * h) {
+        float *r0 = re + start, *r1 = r0 + h;
+        float *i0 = im + start, *i1 = i0 + h;
+        for (size_t k = 0; k < h; k += 4) {
+            __m128 ar = _mm_loadu_ps(wr + k), ai = _mm_loadu_ps(wi + k);
+            __m128 x0r = _mm_loadu_ps(r0 + k), x0i = _mm_loadu_ps(i0 + k);
+            __m128 x1r = _mm_loadu_ps(r1 + k), x1i = _mm_loadu_ps(i1 + k);
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(x1r, ar), _mm_mul_ps(x1i, ai));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(x1r, ai), _mm_mul_ps(x1i, ar));
+            _mm_storeu_ps(r1 + k, _mm_sub_ps(x0r, tr)); _mm_storeu_ps(i1 + k, _mm_sub_ps(x0i, ti));
+            _mm_storeu_ps(r0 + k, _mm_add_ps(x0r, tr)); _mm_storeu_ps(i0 + k, _mm_add_ps(x0i, ti));
+        }
+    }
+}
+
+static const MilkyFftVariant milky_fftSse2 = { "sse2", radix4Sse2, radix2Sse2 };
+#endif
+
+// ---------------------------------------------------------------------------------------
+// AVX2, compiled for the function only and picked at runtime
+
+#if defined(__x86_64__) && defined(MILKY_FFT_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define MILKY_FFT_AVX2 1
+#define MILKY_FFT_TARGET_AVX2 __attribute__((target("avx2")))
+
+static MILKY_FFT_TARGET_AVX2 void radix4Avx2(float *re, float *im, size_t count, size_t span, const float *twiddleRe, const float *twiddleIm) {
+    const size_t h = span;
+    if (h < 8) {
+        radix4Sse2(re, im, count, span, twiddleRe, twiddleIm);
+        return;
+    }
+    const float *w1r = twiddleRe + h - 1, *w1i = twiddleIm + h - 1;
+    const float *w2r = twiddleRe + 2 * h - 1, *w2i = twiddleIm + 2 * h - 1;
+
+    for (size_t start = 0; start < count; start += 4 * h) {
+        float *r0 = re + start, *r1 = r0 + h, *r2 = r1 + h, *r3 = r2 + h;
+        float *i0 = im + start, *i1 = i0 + h, *i2 = i1 + h, *i3 = i2 + h;
+        for (size_t k = 0; k < h; k += 8) {
+            __m256 ar1 = _mm256_loadu_ps(w1r + k), ai1 = _mm256_loadu_ps(w1i + k);
+            __m256 ar2 = _mm256_loadu_ps(w2r + k), ai2 = _mm256_loadu_ps(w2i + k);
+            __m256 x0r = _mm256_loadu_ps(r0 + k), x0i = _mm256_loadu_ps(i0 + k);
+            __m256 x1r = _mm256_loadu_ps(r1 + k), x1i = _mm256_loadu_ps(i1 + k);
+            __m256 x2r = _mm256_loadu_ps(r2 + k), x2i = _mm256_loadu_ps(i2 + k);
+            __m256 x3r = _mm256_loadu_ps(r3 + k), x3i = _mm256_loadu_ps(i3 + k);
+
+            __m256 br = _mm256_sub_ps(_mm256_mul_ps(x1r, ar1), _mm256_mul_ps(x1i, ai1));
+            __m256 bi = _mm256_add_ps(_mm256_mul_ps(x1r, ai1), _mm256_mul_ps(x1i, ar1));
+            __m256 dr = _mm256_sub_ps(_mm256_mul_ps(x3r, ar1), _mm256_mul_ps(x3i, ai1));
+            __m256 di = _mm256_add_ps(_mm256_mul_ps(x3r, ai1), _mm256_mul_ps(x3i, ar1));
+            __m256 sr = _mm256_add_ps(x0r, br), si = _mm256_add_ps(x0i, bi);
+            __m256 er = _mm256_sub_ps(x0r, br), ei = _mm256_sub_ps(x0i, bi);
+            __m256 cr = _mm256_add_ps(x2r, dr), ci = _mm256_add_ps(x2i, di);
+            __m256 fr = _mm256_sub_ps(x2r, dr), fi = _mm256_sub_ps(x2i, di);
+
+            __m256 tr = _mm256_sub_ps(_mm256_mul_ps(cr, ar2), _mm256_mul_ps(ci, ai2));
+            __m256 ti = _mm256_add_ps(_mm256_mul_ps(cr, ai2), _mm256_mul_ps(ci, ar2));
+            __m256 ur = _mm256_add_ps(_mm256_mul_ps(fr, ai2), _mm256_mul_ps(fi, ar2));
+            __m256 ui = _mm256_sub_ps(_mm256_mul_ps(fi, ai2), _mm256_mul_ps(fr, ar2));
+
+            _mm256_storeu_ps(r0 + k, _mm256_add_ps(sr, tr)); _mm256_storeu_ps(i0 + k, _mm256_add_ps(si, ti));
+            _mm256_storeu_ps(r2 + k, _mm256_sub_ps(sr, tr)); _mm256_storeu_ps(i2 + k, _mm256_sub_ps(si, ti));
+            _mm256_storeu_ps(r1 + k, _mm256_add_ps(er, ur)); _mm256_storeu_ps(i1 + k, _mm256_add_ps(ei, ui));
+            _mm256_storeu_ps(r3 + k, _mm256_sub_ps(er, ur)); _mm256_storeu_ps(i3 + k, _mm256_sub_ps(ei, ui));
+        }
+    }
+}
+
+static MILKY_FFT_TARGET_AVX2 void radix2Avx2(float *re, float *im, size_t count, size_t span, const float *twiddleRe, const float *twiddleIm) {
+    const size_t h = span;
+    if (h < 8) {
+        radix2Sse2(re, im, count, span, twiddleRe, twiddleIm);
+        return;
+    }
+    const float *wr = twiddleRe + h - 1, *wi = twiddleIm + h - 1;
+
+    for (size_t start = 0; start < count; start += 2 * h) {
+        float *r0 = re + start, *r1 = r0 + h;
+        float *i0 = im + start, *i1 = i0 + h;
+        for (size_t k = 0; k < h; k += 8) {
+            __m256 ar = _mm256_loadu_ps(wr + k), ai = _mm256_loadu_ps(wi + k);
+            __m256 x0r = _mm256_loadu_ps(r0 + k), x0i = _mm256_loadu_ps(i0 + k);
+            __m256 x1r = _mm256_loadu_ps(r1 + k), x1i = _mm256_loadu_ps(i1 + k);
+            __m256 tr = _mm256_sub_ps(_mm256_mul_ps(x1r, ar), _mm256_mul_ps(x1i, ai));
+            __m256 ti = _mm256_add_ps(_mm256_mul_ps(x1r, ai), _mm256_mul_ps(x1i, ar));
+            _mm256_storeu_ps(r1 + k, _mm256_sub_ps(x0r, tr)); _mm256_storeu_ps(i1 + k, _mm256_sub_ps(x0i, ti));
+            _mm256_storeu_ps(r0 + k, _mm256_add_ps(x0r, tr)); _mm256_storeu_ps(i0 + k, _mm256_add_ps(x0i, ti));
+        }
+    }
+}
+
+static const MilkyFftVariant milky_fftAvx2 = { "avx2", radix4Avx2, radix2Avx2 };
+#endif
+
+// ---------------------------------------------------------------------------------------
+// NEON (AArch64, where it is part of the baseline)
+
+#if defined(__ARM_NEON__) && defined(__aarch64__)
+#define MILKY_FFT_NEON 1
+
+static void radix4Neon(float *re, float *im, size_t count, size_t span, const float *twiddleRe, const float *twiddleIm) {
+    const size_t h = span;
+    if (h < 4) {
+        radix4Scalar(re, im, count, span, twiddleRe, twiddleIm);
+        return;
+    }
+    const float *w1r = twiddleRe + h - 1, *w1i = twiddleIm + h - 1;
+    const float *w2r = twiddleRe + 2 * h - 1, *w2i = twiddleIm + 2 * h - 1;
+
+    for (size_t start = 0; start < count; start += 4 * h) {
+        float *r0 = re + start, *r1 = r0 + h, *r2 = r1 + h, *r3 = r2 + h;
+        float *i0 = im + start, *i1 = i0 + h, *i2 = i1 + h, *i3 = i2 + h;
+        for (size_t k = 0; k < h; k += 4) {
+            float32x4_t ar1 = vld1q_f32(w1r + k), ai1 = vld1q_f32(w1i + k);
+            float32x4_t ar2 = vld1q_f32(w2r + k), ai2 = vld1q_f32(w2i + k);
+            float32x4_t x0r = vld1q_f32(r0 + k), x0i = vld1q_f32(i0 + k);
+            float32x4_t x1r = vld1q_f32(r1 + k), x1i = vld1q_f32(i1 + k);
+            float32x4_t x2r = vld1q_f32(r2 + k), x2i = vld1q_f32(i2 + k);
+            float32x4_t x3r = vld1q_f32(r3 + k), x3i = vld1q_f32(i3 + k);
+
+            float32x4_t br = vsubq_f32(vmulq_f32(x1r, ar1), vmulq_f32(x1i, ai1));
+            float32x4_t bi = vaddq_f32(vmulq_f32(x1r, ai1), vmulq_f32(x1i, ar1));
+            float32x4_t dr = vsubq_f32(vmulq_f32(x3r, ar1), vmulq_f32(x3i, ai1));
+            float32x4_t di = vaddq_f32(vmulq_f32(x3r, ai1), vmulq_f32(x3i, ar1));
+            float32x4_t sr = vaddq_f32(x0r, br), si = vaddq_f32(x0i, bi);
+            float32x4_t er = vsubq_f32(x0r, br), ei = vsubq_f32(x0i, bi);
+            float32x4_t cr = vaddq_f32(x2r, dr), ci = vaddq_f32(x2i, di);
+            float32x4_t fr = vsubq_f32(x2r, dr), fi = vsubq_f32(x2i, di);
+
+            float32x4_t tr = vsubq_f32(vmulq_f32(cr, ar2), vmulq_f32(ci, ai2));
+            float32x4_t ti = vaddq_f32(vmulq_f32(cr, ai2), vmulq_f32(ci, ar2));
+            float32x4_t ur = vaddq_f32(vmulq_f32(fr, ai2), vmulq_f32(fi, ar2));
+            float32x4_t ui = vsubq_f32(vmulq_f32(fi, ai2), vmulq_f32(fr, ar2));
+
+            vst1q_f32(r0 + k, vaddq_f32(sr, tr)); vst1q_f32(i0 + k, vaddq_f32(si, ti));
+            vst1q_f32(r2 + k, vsubq_f32(sr, tr)); vst1q_f32(i2 + k, vsubq_f32(si, ti));
+            vst1q_f32(r1 + k, vaddq_f32(er, ur)); vst1q_f32(i1 + k, vaddq_f32(ei, ui));
+            vst1q_f32(r3 + k, vsubq_f32(er, ur)); vst1q_f32(i3 + k, vsubq_f32(ei, ui));
+        }
+    }
+}
+
+static void radix2Neon(float *re, float *im, size_t count, size_t span, const float *twiddleRe, const float *twiddleIm) {
+    const size_t h = span;
+    if (h < 4) {
+        radix2Scalar(re, im, count, span, twiddleRe, twiddleIm);
+        return;
+    }
+    const float *wr = twiddleRe + h - 1, *wi = twiddleIm + h - 1;
+
+    for (size_t start = 0; start < count; start += 2 * h) {
+        float *r0 = re + start, *r1 = r0 + h;
+        float *i0 = im + start, *i1 = i0 + h;
+        for (size_t k = 0; k < h; k += 4) {
+            float32x4_t ar = vld1q_f32(wr + k), ai = vld1q_f32(wi + k);
+            float32x4_t x0r = vld1q_f32(r0 + k), x0i = vld1q_f32(i0 + k);
+            float32x4_t x1r = vld1q_f32(r1 + k), x1i = vld1q_f32(i1 + k);
+            float32x4_t tr = vsubq_f32(vmulq_f32(x1r, ar), vmulq_f32(x1i, ai));
+            float32x4_t ti = vaddq_f32(vmulq_f32(x1r, ai), vmulq_f32(x1i, ar));
+            vst1q_f32(r1 + k, vsubq_f32(x0r, tr)); vst1q_f32(i1 + k, vsubq_f32(x0i, ti));
+            vst1q_f32(r0 + k, vaddq_f32(x0r, tr)); vst1q_f32(i0 + k, vaddq_f32(x0i, ti));
+        }
+    }
+}
+
+static const MilkyFftVariant milky_fftNeon = { "neon", radix4Neon, radix2Neon };
+#endif
+
+// ---------------------------------------------------------------------------------------
+// selection
+
+static const MilkyFftVariant *milky_fftActive = &milky_fftScalar;
+static pthread_once_t milky_fftOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Picks the widest implementation the CPU supports.
+ */
+static void selectFftVariant(void) {
+#ifdef MILKY_FFT_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        milky_fftActive = &milky_fftAvx2;
+        return;
+    }
+#endif
+#ifdef MILKY_FFT_SSE2
+    milky_fftActive = &milky_fftSse2;
+#endif
+#ifdef MILKY_FFT_NEON
+    milky_fftActive = &milky_fftNeon;
+#endif
+}
+
+/**
+ * Returns the name of the implementation the transforms run with.
+ *
+ * @return "avx2", "sse2", "neon" or "scalar".
+ */
+const char *getFftVariant(void) {
+    pthread_once(&milky_fftOnce, selectFftVariant);
+    return milky_fftActive->name;
+}
+
+/**
+ * Forces an implementation by name, e.g. to compare them. Must not be called while a
+ * transform is running.
+ *
+ * @param name The name of the implementation ("avx2", "sse2", "neon" or "scalar").
+ * @return     1 if the implementation is supported, 0 otherwise.
+ */
+int setFftVariant(const char *name) {
+    const MilkyFftVariant *supported[4];
+    size_t count = 0;
+
+#ifdef MILKY_FFT_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        supported[count++] = &milky_fftAvx2;
+    }
+#endif
+#ifdef MILKY_FFT_SSE2
+    supported[count++] = &milky_fftSse2;
+#endif
+#ifdef MILKY_FFT_NEON
+    supported[count++] = &milky_fftNeon;
+#endif
+    supported[count++] = &milky_fftScalar;
+
+    pthread_once(&milky_fftOnce, selectFftVariant);
+    for (size_t v = 0; v < count; v++) {
+        if (strcmp(supported[v]->name, name) == 0) {
+            milky_fftActive = supported[v];
+            return 1;
+        }
+    }
+
+    fprintf(stderr, "FFT implementation %s is not supported on this CPU\n", name);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------------
+// plans
+
+/**
+ * Creates a plan for real transforms of one size.
+ *
+ * @param size The number of real samples per transform, a power of two from
+ *             2^MILKY_FFT_MIN_LOG2 to 2^MILKY_FFT_MAX_LOG2.
+ * @return     The plan, or NULL if the size is not supported or memory ran out.
+ */
+MilkyFftPlan *createFftPlan(size_t size) {
+    size_t log2Size = 0;
+    while (((size_t)1 << log2Size) < size) log2Size++;
+    if (((size_t)1 << log2Size) != size || log2Size < MILKY_FFT_MIN_LOG2 || log2Size > MILKY_FFT_MAX_LOG2) {
+        fprintf(stderr, "Unsupported FFT size %zu\n", size);
+        return NULL;
+    }
+
+    MilkyFftPlan *plan = (MilkyFftPlan *)calloc(1, sizeof(MilkyFftPlan));
+    if (!plan) {
+        fprintf(stderr, "Failed to allocate an FFT plan\n");
+        return NULL;
+    }
+    const size_t half = size / 2;
+    plan->size = size;
+    plan->log2Size = log2Size;
+    plan->half = half;
+    plan->bitReverse = (uint32_t *)malloc(half * sizeof(uint32_t));
+    plan->twiddleRe = (float *)malloc(half * sizeof(float));
+    plan->twiddleIm = (float *)malloc(half * sizeof(float));
+    plan->splitCos = (float *)malloc((half / 2 + 1) * sizeof(float));
+    plan->splitSin = (float *)malloc((half / 2 + 1) * sizeof(float));
+    if (!plan->bitReverse || !plan->twiddleRe || !plan->twiddleIm || !plan->splitCos || !plan->splitSin) {
+        fprintf(stderr, "Failed to allocate an FFT plan of size %zu\n", size);
+        destroyFftPlan(plan);
+        return NULL;
+    }
+
+    const size_t bits = log2Size - 1;
+    for (size_t i = 0; i < half; i++) {
+        uint32_t reversed = 0;
+        for (size_t b = 0; b < bits; b++) {
+            reversed |= (uint32_t)((i >> b) & 1) << (bits - 1 - b);
+        }
+        plan->bitReverse[i] = reversed;
+    }
+
+    // the pass of span h combines transforms of h points with W = exp(-i pi k / h), k < h
+    for (size_t h = 1; h < half; h <<= 1) {
+        for (size_t k = 0; k < h; k++) {
+            double angle = M_PI * (double)k / (double)h;
+            plan->twiddleRe[h - 1 + k] = (float)cos(angle);
+            plan->twiddleIm[h - 1 + k] = (float)-sin(angle);
+        }
+    }
+
+    for (size_t k = 0; k <= half / 2; k++) {
+        double angle = 2.0 * M_PI * (double)k / (double)size;
+        plan->splitCos[k] = (float)cos(angle);
+        plan->splitSin[k] = (float)sin(angle);
+    }
+    return plan;
+}
+
+/**
+ * Frees a plan made by createFftPlan(). Cached plans of getFftPlan() must not be freed.
+ *
+ * @param plan The plan to free, may be NULL.
+ */
+void destroyFftPlan(MilkyFftPlan *plan) {
+    if (!plan) return;
+    free(plan->bitReverse);
+    free(plan->twiddleRe);
+    free(plan->twiddleIm);
+    free(plan->splitCos);
+    free(plan->splitSin);
+    free(plan);
+}
+
+static MilkyFftPlan *milky_fftPlans[MILKY_FFT_MAX_LOG2 + 1];
+static pthread_mutex_t milky_fftPlansLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the shared plan of a size, creating it on first use. Shared plans live as long
+ * as the process; any thread may ask for and use them.
+ *
+ * @param size The number of real samples per transform (see createFftPlan()).
+ * @return     The plan, or NULL if the size is not supported or memory ran out.
+ */
+const MilkyFftPlan *getFftPlan(size_t size) {
+    size_t log2Size = 0;
+    while (((size_t)1 << log2Size) < size && log2Size <= MILKY_FFT_MAX_LOG2) log2Size++;
+    if (log2Size <= MILKY_FFT_MAX_LOG2) {
+        MilkyFftPlan *plan = __atomic_load_n(&milky_fftPlans[log2Size], __ATOMIC_ACQUIRE);
+        if (plan && plan->size == size) return plan;
+    }
+
+    MilkyFftPlan *plan = createFftPlan(size);
+    if (!plan) return NULL;
+
+    pthread_mutex_lock(&milky_fftPlansLock);
+    MilkyFftPlan *cached = milky_fftPlans[log2Size];
+    if (cached) {
+        destroyFftPlan(plan); // another thread was first
+        plan = cached;
+    } else {
+        __atomic_store_n(&milky_fftPlans[log2Size], plan, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&milky_fftPlansLock);
+    return plan;
+}
+
+// ---------------------------------------------------------------------------------------
+// transforms
+
+/**
+ * Computes the spectrum of real samples, in the packed layout of vDSP's real FFT:
+ * bins 0 to n/2 - 1 in `re` and `im`, except that im[0] holds the real Nyquist bin n/2
+ * (the imaginary parts of the DC and Nyquist bins are always zero). The spectrum is not
+ * scaled: bin k is sum(x[j] * exp(-2 pi i j k / n)), half of what vDSP returns.
+ *
+ * @param plan  The plan of the transform size n.
+ * @param input n samples; must not overlap `re` or `im`.
+ * @param re    Receives n/2 real parts.
+ * @param im    Receives n/2 imaginary parts.
+ */
+void fftForwardReal(const MilkyFftPlan *plan, const float *input, float *re, float *im) {
+    pthread_once(&milky_fftOnce, selectFftVariant);
+    const MilkyFftVariant *variant = milky_fftActive;
+    const size_t half = plan->half;
+
+    // the even samples become the real parts, the odd ones the imaginary parts
+    for (size_t j = 0; j < half; j++) {
+        uint32_t to = plan->bitReverse[j];
+        re[to] = input[2 * j];
+        im[to] = input[2 * j + 1];
+    }
+
+    size_t span = 1;
+    for (; span * 4 <= half; span *= 4) {
+        variant->radix4(re, im, half, span, plan->twiddleRe, plan->twiddleIm);
+    }
+    if (span < half) {
+        variant->radix2(re, im, half, span, plan->twiddleRe, plan->twiddleIm);
+    }
+
+    // split Z = FFT(even + i odd) into X[k] = E[k] + W^k O[k], with E and O the spectra of the
+    // even and odd samples: E[k] = (Z[k] + conj Z[half - k]) / 2, O[k] = (Z[k] - conj Z[half - k]) / 2i
+    float z0r = re[0], z0i = im[0];
+    re[0] = z0r + z0i;
+    im[0] = z0r - z0i;
+    for (size_t k = 1; k <= half / 2; k++) {
+        size_t m = half - k;
+        float ar = re[k], ai = im[k];
+        float br = re[m], bi = im[m];
+
+        float er = 0.5f * (ar + br), ei = 0.5f * (ai - bi);
+        float or_ = 0.5f * (ai + bi), oi = 0.5f * (br - ar);
+        float c = plan->splitCos[k], s = plan->splitSin[k];
+        float tr = c * or_ + s * oi;
+        float ti = c * oi - s * or_;
+
+        re[k] = er + tr; im[k] = ei + ti;
+        re[m] = er - tr; im[m] = ti - ei;
+    }
+}
+
+/**
+ * Computes the magnitudes of a spectrum, sqrt(re^2 + im^2) per bin.
+ *
+ * @param re         The real parts.
+ * @param im         The imaginary parts.
+ * @param magnitudes Receives `count` magnitudes.
+ * @param count      The number of bins.
+ */
+void fftMagnitudes(const float *re, const float *im, float *magnitudes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        magnitudes[i] = sqrtf(re[i] * re[i] + im[i] * im[i]);
+    }
+}
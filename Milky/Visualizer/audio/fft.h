@@ -0,0 +1,57 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// sizes a plan can be made for: powers of two from 2^MILKY_FFT_MIN_LOG2 to 2^MILKY_FFT_MAX_LOG2 samples
+#define MILKY_FFT_MIN_LOG2 2
+#define MILKY_FFT_MAX_LOG2 16
+
+// everything a real FFT of one size needs, computed once: the order its input is loaded in
+// and the twiddle factors of every pass. A plan is read-only after creation, so one plan
+// serves any number of threads; the transforms work in the caller's buffers.
+typedef struct {
+    size_t size;              // real samples per transform
+    size_t log2Size;
+    size_t half;              // points of the complex transform the real one is computed with
+
+    uint32_t *bitReverse;     // half entries: where each complex point is loaded to
+    float *twiddleRe;         // half - 1 entries: the twiddles of the pass of span h start at h - 1
+    float *twiddleIm;
+    float *splitCos;          // half / 2 + 1 entries: the twiddles that split the complex result
+    float *splitSin;
+} MilkyFftPlan;
+
+MilkyFftPlan *createFftPlan(size_t size);
+void destroyFftPlan(MilkyFftPlan *plan);
+const MilkyFftPlan *getFftPlan(size_t size);
+
+void fftForwardReal(const MilkyFftPlan *plan, const float *input, float *re, float *im);
+void fftMagnitudes(const float *re, const float *im, float *magnitudes, size_t count);
+
+const char *getFftVariant(void);
+int setFftVariant(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FFT_H
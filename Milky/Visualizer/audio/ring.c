@@ -0,0 +1,240 @@
+/*
+ Lock-free single-producer/single-consumer sample ring.
+
+ The producer (the real-time audio thread) appends samples without ever waiting for the
+ consumer: it announces the range it is about to overwrite in `reserved`, copies the samples
+ and then publishes them in `written`, like the writer of a seqlock. The consumer copies a
+ window out of the ring and checks `reserved` afterwards; if the producer has started to
+ overwrite any sample of the window in the meantime, the copy is discarded and repeated
+ from the oldest samples still held. Lost samples are counted as overruns, so the consumer
+ always knows whether the windows it read were gapless.
+*/
+
+#include "ring.h"
+
+/**
+ * Initializes an empty ring.
+ *
+ * @param ring       The ring to initialize.
+ * @param capacity   The minimum number of samples the ring holds; rounded up to a power of two.
+ * @param sampleRate The sample rate of the samples, for the timestamps of the windows.
+ * @return           0 on success, -1 on failure.
+ */
+int initSampleRing(MilkySampleRing *ring, size_t capacity, double sampleRate) {
+    memset(ring, 0, sizeof(MilkySampleRing));
+
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    ring->samples = (float *)calloc(size, sizeof(float));
+    if (!ring->samples) {
+        fprintf(stderr, "Failed to allocate a sample ring of %zu samples\n", size);
+        return -1;
+    }
+    ring->capacity = size;
+    ring->mask = size - 1;
+    ring->sampleRate = sampleRate > 0 ? sampleRate : 1.0;
+    return 0;
+}
+
+/**
+ * Frees the samples of a ring. Neither side may use the ring anymore.
+ *
+ * @param ring The ring to free.
+ */
+void freeSampleRing(MilkySampleRing *ring) {
+    free(ring->samples);
+    memset(ring, 0, sizeof(MilkySampleRing));
+}
+
+/**
+ * Appends interleaved frames to the ring, averaged to mono (producer side). Never blocks,
+ * locks or allocates, so it is safe on the real-time audio thread. Of more frames than the
+ * ring holds, only the newest are kept.
+ *
+ * @param ring       The ring.
+ * @param samples    The interleaved samples.
+ * @param frameCount The number of frames.
+ * @param channels   The number of channels per frame.
+ */
+void writeSampleRing(MilkySampleRing *ring, const float *samples, size_t frameCount, size_t channels) {
+    if (frameCount == 0 || channels == 0) {
+        return;
+    }
+
+    uint64_t end = ring->written + frameCount;
+    size_t kept = frameCount < ring->capacity ? frameCount : ring->capacity;
+    samples += (frameCount - kept) * channels;
+
+    // announce the overwrite before touching the samples (the fence keeps the stores in order)
+    __atomic_store_n(&ring->reserved, end, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    uint64_t position = end - kept;
+    if (channels == 1) {
+        size_t offset = (size_t)position & ring->mask;
+        size_t first = kept < ring->capacity - offset ? kept : ring->capacity - offset;
+        memcpy(ring->samples + offset, samples, first * sizeof(float));
+        memcpy(ring->samples, samples + first, (kept - first) * sizeof(float));
+    } else {
+        const float scale = 1.0f / (float)channels;
+        for (size_t i = 0; i < kept; i++) {
+            float sum = 0.0f;
+            for (size_t c = 0; c < channels; c++) {
+                sum += samples[i * channels + c];
+            }
+            ring->samples[(size_t)(position + i) & ring->mask] = sum * scale;
+        }
+    }
+
+    __atomic_store_n(&ring->written, end, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copies samples out of the ring, without checking whether they are still valid.
+ */
+static void copyFromRing(const MilkySampleRing *ring, uint64_t position, size_t length, float *out) {
+    size_t offset = (size_t)position & ring->mask;
+    size_t first = length < ring->capacity - offset ? length : ring->capacity - offset;
+    memcpy(out, ring->samples + offset, first * sizeof(float));
+    memcpy(out + first, ring->samples, (length - first) * sizeof(float));
+}
+
+/**
+ * Checks, after a copy, that the producer has not started to overwrite the copied samples.
+ */
+static int isWindowIntact(const MilkySampleRing *ring, uint64_t position) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&ring->reserved, __ATOMIC_RELAXED) <= position + ring->capacity;
+}
+
+/**
+ * Returns the number of samples the consumer has not read yet, at most the capacity.
+ */
+size_t availableSamples(const MilkySampleRing *ring) {
+    uint64_t written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+    uint64_t position = __atomic_load_n(&ring->readPosition, __ATOMIC_RELAXED);
+    if (position >= written) return 0;
+    return written - position < ring->capacity ? (size_t)(written - position) : ring->capacity;
+}
+
+/**
+ * Reads the next window of samples (consumer side) and advances the read position by
+ * `hop` samples: a hop equal to the length reads the stream gaplessly, a smaller hop reads
+ * overlapping windows. If the producer has overwritten unread samples, the read skips to
+ * the oldest samples still held and counts the skipped samples as overruns.
+ *
+ * @param ring   The ring.
+ * @param out    Receives `length` samples.
+ * @param length The number of samples to read, at most the capacity of the ring.
+ * @param hop    The number of samples to advance the read position by.
+ * @param window Receives the position and time of the window, may be NULL.
+ * @return       0 if a window was read, -1 if fewer than `length` samples are available.
+ */
+int readSampleWindow(MilkySampleRing *ring, float *out, size_t length, size_t hop, MilkySampleWindow *window) {
+    if (length == 0 || length > ring->capacity) {
+        return -1;
+    }
+
+    uint64_t position = ring->readPosition;
+    for (;;) {
+        uint64_t written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+        uint64_t reserved = __atomic_load_n(&ring->reserved, __ATOMIC_RELAXED);
+
+        // skip what the producer has overwritten, or is overwriting, before it was read
+        uint64_t oldest = reserved > ring->capacity ? reserved - ring->capacity : 0;
+        if (position < oldest) {
+            __atomic_store_n(&ring->overruns, ring->overruns + (oldest - position), __ATOMIC_RELAXED);
+            position = oldest;
+        }
+
+        if (position + length > written) {
+            __atomic_store_n(&ring->readPosition, position, __ATOMIC_RELAXED);
+            __atomic_store_n(&ring->underruns, ring->underruns + 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+
+        copyFromRing(ring, position, length, out);
+        if (isWindowIntact(ring, position)) break;
+    }
+
+    if (window) {
+        window->position = position;
+        window->time = (double)position / getSampleRingRate(ring);
+        window->length = length;
+    }
+    __atomic_store_n(&ring->readPosition, position + hop, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * Copies the newest samples of the ring (consumer side) without advancing the read
+ * position, e.g. for a waveform display next to a gapless analysis.
+ *
+ * @param ring   The ring.
+ * @param out    Receives `length` samples.
+ * @param length The number of samples to read, at most the capacity of the ring.
+ * @param window Receives the position and time of the window, may be NULL.
+ * @return       0 if the samples were read, -1 if fewer than `length` samples were ever written.
+ */
+int readLatestSamples(MilkySampleRing *ring, float *out, size_t length, MilkySampleWindow *window) {
+    if (length == 0 || length > ring->capacity) {
+        return -1;
+    }
+
+    uint64_t position;
+    do {
+        uint64_t written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+        if (written < length) {
+            return -1;
+        }
+        position = written - length;
+        copyFromRing(ring, position, length, out);
+    } while (!isWindowIntact(ring, position));
+
+    if (window) {
+        window->position = position;
+        window->time = (double)position / getSampleRingRate(ring);
+        window->length = length;
+    }
+    return 0;
+}
+
+/**
+ * Reads the counters of a ring; any thread may call it at any time.
+ *
+ * @param ring  The ring.
+ * @param stats Receives the counters.
+ */
+void getSampleRingStats(const MilkySampleRing *ring, MilkySampleRingStats *stats) {
+    stats->written = __atomic_load_n(&ring->written, __ATOMIC_RELAXED);
+    stats->read = __atomic_load_n(&ring->readPosition, __ATOMIC_RELAXED);
+    stats->overruns = __atomic_load_n(&ring->overruns, __ATOMIC_RELAXED);
+    stats->underruns = __atomic_load_n(&ring->underruns, __ATOMIC_RELAXED);
+}
+
+/**
+ * Changes the sample rate of a ring, e.g. when a capture restarts on a device running at
+ * another rate; any thread may call it at any time. Positions are not rescaled, so the
+ * timestamps of windows read after the change jump once.
+ *
+ * @param ring       The ring.
+ * @param sampleRate The new sample rate, ignored unless positive.
+ */
+void setSampleRingRate(MilkySampleRing *ring, double sampleRate) {
+    if (sampleRate > 0) {
+        __atomic_store(&ring->sampleRate, &sampleRate, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Reads the sample rate of a ring; any thread may call it at any time.
+ *
+ * @param ring The ring.
+ * @return     The sample rate of the samples.
+ */
+double getSampleRingRate(const MilkySampleRing *ring) {
+    double sampleRate;
+    __atomic_load(&ring->sampleRate, &sampleRate, __ATOMIC_RELAXED);
+    return sampleRate;
+}
@@ -0,0 +1,66 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the producer and the consumer fields of a ring sit on separate cache lines of this size
+#define MILKY_RING_LINE 64
+
+// a single-producer/single-consumer ring of mono float samples, e.g. from the audio IO
+// callback to the analysis. The producer never waits, locks or allocates: when it laps the
+// consumer, it overwrites the oldest samples and the consumer detects and counts the loss.
+// Positions count samples since the ring was initialized and serve as timestamps.
+typedef struct {
+    float *samples;
+    size_t capacity;          // power of two
+    size_t mask;
+    double sampleRate;        // rate of the positions, for converting them to seconds; see setSampleRingRate()
+
+    // written by the producer only
+    uint64_t reserved __attribute__((aligned(MILKY_RING_LINE))); // end of the samples being written
+    uint64_t written;         // end of the samples completely written
+
+    // written by the consumer only
+    uint64_t readPosition __attribute__((aligned(MILKY_RING_LINE)));
+    uint64_t overruns;        // samples lost because the producer overwrote them before they were read
+    uint64_t underruns;       // reads that found fewer samples than they asked for
+} MilkySampleRing;
+
+// a window of samples read from a ring
+typedef struct {
+    uint64_t position;        // position of the first sample
+    double time;              // position of the first sample in seconds
+    size_t length;            // number of samples
+} MilkySampleWindow;
+
+// counters of a ring, readable from any thread
+typedef struct {
+    uint64_t written;         // samples appended by the producer
+    uint64_t read;            // position the consumer has advanced to
+    uint64_t overruns;
+    uint64_t underruns;
+} MilkySampleRingStats;
+
+int initSampleRing(MilkySampleRing *ring, size_t capacity, double sampleRate);
+void freeSampleRing(MilkySampleRing *ring);
+void writeSampleRing(MilkySampleRing *ring, const float *samples, size_t frameCount, size_t channels);
+size_t availableSamples(const MilkySampleRing *ring);
+int readSampleWindow(MilkySampleRing *ring, float *out, size_t length, size_t hop, MilkySampleWindow *window);
+int readLatestSamples(MilkySampleRing *ring, float *out, size_t length, MilkySampleWindow *window);
+void getSampleRingStats(const MilkySampleRing *ring, MilkySampleRingStats *stats);
+void setSampleRingRate(MilkySampleRing *ring, double sampleRate);
+double getSampleRingRate(const MilkySampleRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RING_H
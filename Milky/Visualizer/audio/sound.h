@@ -9,22 +9,32 @@
 #include <stdbool.h>
 
 #include "../video/draw.h"
+#include "../video/blend.h"
+#include "../video/stroke.h"
 
 #ifdef __ARM_NEON__
 #include <arm_neon.h>
 #endif
 
-// Global variable to store the average offset introduced by smoothing
-extern float milky_soundAverageOffset;
+// width of the waveform stroke in pixels, kept clear of the canvas edges
+#define MILKY_WAVEFORM_THICKNESS 2
 
-// Cache for the last rendered waveform
-extern float milky_soundCachedWaveform[2048];
+// longest waveform renderWaveform() draws, in samples; the polyline of a waveform holds
+// fewer than two vertices per sample
+#define MILKY_WAVEFORM_MAX_SAMPLES 2048
 
-// Static variable to keep track of frame count
-extern int milky_soundFrameCounter;
+// Waveform rendering state, preserved across frames
+typedef struct {
+    // average offset introduced by smoothing
+    float averageOffset;
+
+    // vertices of the waveform's polyline, rebuilt every frame
+    MilkyStrokePoint points[2 * MILKY_WAVEFORM_MAX_SAMPLES];
+} MilkySoundState;
 
 // Function to smooth the bass-emphasized waveform
 void smoothBassEmphasizedWaveform(
+    MilkySoundState *state,
     const uint8_t *waveform, 
     size_t waveformLength, 
     float *formattedWaveform, 
@@ -32,17 +42,16 @@ void smoothBassEmphasizedWaveform(
     float volumeScale
 );
 
-// Function to render a simple waveform with specified parameters
-void renderWaveformSimple(
-    float timeFrame,
+// Function to render the waveform as a polyline, one sweep for all stroke layers
+void renderWaveform(
+    MilkySoundState *state,
     uint8_t *frame,
     size_t canvasWidthPx,
     size_t canvasHeightPx,
     const float *emphasizedWaveform,
     size_t waveformLength,
-    float globalAlphaFactor,
-    int32_t yOffset,
-    int32_t xOffset 
+    const MilkyStrokeStyle *layers,
+    size_t layerCount
 );
 
 #endif // SOUND_H
@@ -0,0 +1,111 @@
+#include "stft.h"
+
+/**
+ * Computes the coefficients of a window function (the periodic form, which sums to a
+ * constant at hops of a quarter window, so overlapping windows weigh every sample alike).
+ */
+static void fillWindow(float *window, size_t size, MilkyWindowFunction windowFunction) {
+    for (size_t i = 0; i < size; i++) {
+        double phase = 2.0 * M_PI * (double)i / (double)size;
+        switch (windowFunction) {
+            case MILKY_WINDOW_HANN:
+                window[i] = (float)(0.5 - 0.5 * cos(phase));
+                break;
+            case MILKY_WINDOW_BLACKMAN:
+                window[i] = (float)(0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase));
+                break;
+            default:
+                window[i] = 1.0f;
+                break;
+        }
+    }
+}
+
+/**
+ * Initializes an STFT and allocates all of its buffers.
+ *
+ * @param stft           The STFT to initialize.
+ * @param size           The samples per window, a power of two the FFT supports.
+ * @param hop            The samples between consecutive windows, from 1 to `size`.
+ * @param windowFunction The window function.
+ * @return               0 on success, -1 on failure.
+ */
+int initStft(MilkyStft *stft, size_t size, size_t hop, MilkyWindowFunction windowFunction) {
+    memset(stft, 0, sizeof(MilkyStft));
+    if (hop == 0 || hop > size) {
+        fprintf(stderr, "Invalid STFT hop %zu for windows of %zu samples\n", hop, size);
+        return -1;
+    }
+    stft->plan = getFftPlan(size);
+    if (!stft->plan) {
+        return -1;
+    }
+
+    stft->size = size;
+    stft->hop = hop;
+    stft->bins = size / 2;
+    stft->windowFunction = windowFunction;
+    stft->window = (float *)malloc(size * sizeof(float));
+    stft->samples = (float *)malloc(size * sizeof(float));
+    stft->windowed = (float *)malloc(size * sizeof(float));
+    stft->re = (float *)malloc(stft->bins * sizeof(float));
+    stft->im = (float *)malloc(stft->bins * sizeof(float));
+    stft->magnitudes = (float *)calloc(stft->bins, sizeof(float));
+    if (!stft->window || !stft->samples || !stft->windowed || !stft->re || !stft->im || !stft->magnitudes) {
+        fprintf(stderr, "Failed to allocate an STFT of %zu samples\n", size);
+        freeStft(stft);
+        return -1;
+    }
+
+    fillWindow(stft->window, size, windowFunction);
+    double sum = 0.0;
+    for (size_t i = 0; i < size; i++) {
+        sum += stft->window[i];
+    }
+    stft->amplitudeScale = (float)(2.0 / sum);
+    return 0;
+}
+
+/**
+ * Frees the buffers of an STFT; its plan is shared and stays cached.
+ *
+ * @param stft The STFT to free.
+ */
+void freeStft(MilkyStft *stft) {
+    free(stft->window);
+    free(stft->samples);
+    free(stft->windowed);
+    free(stft->re);
+    free(stft->im);
+    free(stft->magnitudes);
+    memset(stft, 0, sizeof(MilkyStft));
+}
+
+/**
+ * Computes the spectrum of the next window of a ring (as its consumer) and advances the
+ * ring by one hop. The amplitude spectrum in `magnitudes` is independent of the window
+ * function and size: a full-scale sine shows up with an amplitude of about 1 in its bin.
+ *
+ * @param stft The STFT.
+ * @param ring The ring to read; the STFT must be its only consumer.
+ * @return     0 if a spectrum was computed, -1 if the ring holds no complete window yet.
+ */
+int nextStftFrame(MilkyStft *stft, MilkySampleRing *ring) {
+    if (readSampleWindow(ring, stft->samples, stft->size, stft->hop, &stft->position) != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < stft->size; i++) {
+        stft->windowed[i] = stft->samples[i] * stft->window[i];
+    }
+    fftForwardReal(stft->plan, stft->windowed, stft->re, stft->im);
+    fftMagnitudes(stft->re, stft->im, stft->magnitudes, stft->bins);
+
+    // the packed layout keeps the Nyquist bin in im[0]; the DC bin has no imaginary part
+    stft->magnitudes[0] = fabsf(stft->re[0]);
+    for (size_t k = 0; k < stft->bins; k++) {
+        stft->magnitudes[k] *= stft->amplitudeScale;
+    }
+    stft->frames++;
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef STFT_H
+#define STFT_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft.h"
+#include "ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// window functions of the STFT
+typedef enum {
+    MILKY_WINDOW_RECTANGULAR,
+    MILKY_WINDOW_HANN,
+    MILKY_WINDOW_BLACKMAN
+} MilkyWindowFunction;
+
+// a short-time Fourier transform over a sample ring: spectra of windows of `size` samples
+// that start `hop` samples apart, so consecutive windows overlap by size - hop samples.
+// All buffers are allocated once; computing a spectrum allocates nothing.
+typedef struct {
+    const MilkyFftPlan *plan;
+    size_t size;              // samples per window, a power of two
+    size_t hop;               // samples between the starts of consecutive windows
+    size_t bins;              // size / 2: DC up to, not including, the Nyquist bin
+    MilkyWindowFunction windowFunction;
+
+    float *window;            // the window function, computed once
+    float amplitudeScale;     // turns |X| into the amplitude of a sine: 2 / sum(window)
+    float *samples;           // the samples of the current window, as read from the ring
+    float *windowed;
+    float *re;
+    float *im;
+    float *magnitudes;        // amplitude spectrum of the current window
+
+    MilkySampleWindow position; // where the current window starts in the stream
+    uint64_t frames;          // spectra computed so far
+} MilkyStft;
+
+int initStft(MilkyStft *stft, size_t size, size_t hop, MilkyWindowFunction windowFunction);
+void freeStft(MilkyStft *stft);
+int nextStftFrame(MilkyStft *stft, MilkySampleRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STFT_H
@@ -0,0 +1,113 @@
+#include "governor.h"
+
+/*
+ Dynamic resolution governor.
+
+ The render loop reports the cost of every frame (render plus upscale). The cost is smoothed
+ with an exponential moving average, and the internal feedback resolution moves in steps of
+ 1/8 of the output size per axis:
+
+   - above 90% of the frame budget for MILKY_GOVERNOR_DOWN_FRAMES frames: one step down
+   - below 70% of the budget once scaled to the next larger step, for
+     MILKY_GOVERNOR_UP_FRAMES frames: one step up
+
+ Lowering reacts quickly, raising only after a long quiet period and only when the larger
+ size is predicted to fit, so the resolution does not oscillate around the budget.
+*/
+
+// share of the budget above which the resolution is lowered
+#define MILKY_GOVERNOR_HIGH_WATER 0.9
+
+// share of the budget the next larger step has to fit into before the resolution is raised
+#define MILKY_GOVERNOR_LOW_WATER 0.7
+
+// weight of a new sample in the moving average
+#define MILKY_GOVERNOR_SMOOTHING 0.125
+
+/**
+ * Returns the number of pixels of a step relative to the output size.
+ */
+static double pixelShare(size_t step) {
+    double axis = (8.0 - (double)step) / 8.0;
+    return axis * axis;
+}
+
+/**
+ * Resets a governor to full resolution.
+ *
+ * @param governor   The governor to initialize.
+ * @param desiredFps The frame rate the render loop aims for.
+ */
+void initResolutionGovernor(MilkyResolutionGovernor *governor, size_t desiredFps) {
+    governor->budget = desiredFps > 0 ? 1000000000ull / desiredFps : 0;
+    governor->averageCost = 0.0;
+    governor->step = 0;
+    governor->overBudget = 0;
+    governor->underBudget = 0;
+}
+
+/**
+ * Feeds the cost of one frame into the governor.
+ *
+ * @param governor  The governor of the render loop.
+ * @param frameCost The time the frame took in nanoseconds.
+ * @return          1 if the resolution step changed, 0 otherwise.
+ */
+int updateResolutionGovernor(MilkyResolutionGovernor *governor, uint64_t frameCost) {
+    if (governor->budget == 0) return 0;
+
+    if (governor->averageCost == 0.0) {
+        governor->averageCost = (double)frameCost;
+    } else {
+        governor->averageCost += ((double)frameCost - governor->averageCost) * MILKY_GOVERNOR_SMOOTHING;
+    }
+
+    double budget = (double)governor->budget;
+    double current = pixelShare(governor->step);
+
+    if (governor->averageCost > budget * MILKY_GOVERNOR_HIGH_WATER) {
+        governor->underBudget = 0;
+        if (++governor->overBudget >= MILKY_GOVERNOR_DOWN_FRAMES && governor->step + 1 < MILKY_GOVERNOR_STEPS) {
+            governor->step++;
+            // the cost scales roughly with the pixel count, keep the average meaningful
+            governor->averageCost *= pixelShare(governor->step) / current;
+            governor->overBudget = 0;
+            return 1;
+        }
+        return 0;
+    }
+    governor->overBudget = 0;
+
+    if (governor->step > 0) {
+        double predicted = governor->averageCost * pixelShare(governor->step - 1) / current;
+        if (predicted < budget * MILKY_GOVERNOR_LOW_WATER) {
+            if (++governor->underBudget >= MILKY_GOVERNOR_UP_FRAMES) {
+                governor->step--;
+                governor->averageCost = predicted;
+                governor->underBudget = 0;
+                return 1;
+            }
+            return 0;
+        }
+    }
+    governor->underBudget = 0;
+    return 0;
+}
+
+/**
+ * Returns the internal render size for the current step (even, at least 16 pixels per axis).
+ *
+ * @param governor       The governor of the render loop.
+ * @param width          The output width.
+ * @param height         The output height.
+ * @param governedWidth  Receives the internal width.
+ * @param governedHeight Receives the internal height.
+ */
+void getGovernedSize(const MilkyResolutionGovernor *governor, size_t width, size_t height, size_t *governedWidth, size_t *governedHeight) {
+    size_t eighths = 8 - governor->step;
+    size_t scaledWidth = (width * eighths / 8) & ~(size_t)1;
+    size_t scaledHeight = (height * eighths / 8) & ~(size_t)1;
+
+    *governedWidth = governor->step == 0 || scaledWidth < 16 ? width : scaledWidth;
+    *governedHeight = governor->step == 0 || scaledHeight < 16 ? height : scaledHeight;
+}
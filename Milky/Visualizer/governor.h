@@ -0,0 +1,37 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// resolution steps, in eighths of the output size per axis (8/8 down to 4/8)
+#define MILKY_GOVERNOR_STEPS 5
+
+// consecutive frames over budget before the resolution is lowered
+#define MILKY_GOVERNOR_DOWN_FRAMES 10
+
+// consecutive frames with enough headroom before the resolution is raised
+#define MILKY_GOVERNOR_UP_FRAMES 90
+
+// picks the internal render resolution from the measured frame cost; zero-initialized before first use
+typedef struct {
+    uint64_t budget;      // time available per frame in nanoseconds
+    double averageCost;   // smoothed frame cost in nanoseconds, 0 = no sample yet
+    size_t step;          // 0 = full output resolution
+    size_t overBudget;    // consecutive frames above the lowering threshold
+    size_t underBudget;   // consecutive frames below the raising threshold
+} MilkyResolutionGovernor;
+
+void initResolutionGovernor(MilkyResolutionGovernor *governor, size_t desiredFps);
+int updateResolutionGovernor(MilkyResolutionGovernor *governor, uint64_t frameCost);
+void getGovernedSize(const MilkyResolutionGovernor *governor, size_t width, size_t height, size_t *governedWidth, size_t *governedHeight);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GOVERNOR_H
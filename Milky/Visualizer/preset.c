@@ -1,7 +1,9 @@
 #include "preset.h"
 
-// Ordered list of well-known property names
-const char *milky_presetWellKnownPropertyNames[MILKY_MAX_PROPERTY_COUNT_PER_PRESET] = {
+#include "./video/effects/chaser.h"
+
+// Ordered list of well-known property names, indexed by MilkyPresetProperty
+static const char *milky_presetWellKnownPropertyNames[MILKY_PRESET_PROPERTY_COUNT] = {
     "damping", "effect_bar", "effect_chasers", "effect_dots", "effect_grid",
     "effect_nuclide", "effect_shadebobs", "effect_solar", "effect_spectral",
     "f1", "f2", "f3", "f4", "gamma", "magic", "mode", "pal_bFX",
@@ -10,26 +12,46 @@ const char *milky_presetWellKnownPropertyNames[MILKY_MAX_PROPERTY_COUNT_PER_PRES
     "t1", "t2", "volpos", "wave", "x_center", "y_center"
 };
 
-// Struct for a preset, including properties and their names
+// parameters of render() when no preset is selected
+static const MilkyPresetParams milky_defaultPresetParams = {
+    .zoom = 1.35f,
+    .decay = 0.9f,
+    .warpBlend = 0.7f,
+    .waveformVolume = 0.7f,
+    .chaserSpeed = 20.0f,
+    .chaserCount = MILKY_CHASER_COUNT,
+    .chaserThickness = MILKY_CHASER_THICKNESS
+};
+
+// Struct for a preset: its raw properties, indexed by MilkyPresetProperty, and their compiled form
 typedef struct {
+    MilkyPresetParams params;
     int presetNumber;
     float properties[MILKY_MAX_PROPERTY_COUNT_PER_PRESET];
-    const char *propertyNames[MILKY_MAX_PROPERTY_COUNT_PER_PRESET]; // Ordered property names
 } Preset;
 
-// Populate property names in each Preset
-void initializePresetPropertyNames(Preset *preset) {
-    for (size_t i = 0; i < MILKY_MAX_PROPERTY_COUNT_PER_PRESET; i++) {
-        preset->propertyNames[i] = milky_presetWellKnownPropertyNames[i];
-    }
-}
+static Preset presets[MILKY_MAX_PRESETS];
+static size_t presetCount = 0;
 
-Preset presets[MILKY_MAX_PRESETS];
-size_t presetCount = 0;
+/**
+ * Compiles the flattened properties of one preset into the parameters render() reads.
+ * Parameters no property controls keep their defaults.
+ *
+ * @param properties The MILKY_MAX_PROPERTY_COUNT_PER_PRESET properties of the preset.
+ * @param params     Receives the compiled parameters.
+ */
+void compilePreset(const float *properties, MilkyPresetParams *params) {
+    *params = milky_defaultPresetParams;
+    params->centerX = properties[MILKY_PRESET_X_CENTER];
+    params->centerY = properties[MILKY_PRESET_Y_CENTER];
+    params->magic = properties[MILKY_PRESET_MAGIC];
+    params->shift = properties[MILKY_PRESET_SHIFT];
+    params->damping = properties[MILKY_PRESET_DAMPING];
+}
 
 /**
- * Parses a flattened buffer into a global list of Presets with ordered property names.
- * 
+ * Parses a flattened buffer into a global list of Presets and compiles each of them.
+ *
  * @param buffer       Pointer to the buffer containing preset data.
  * @param bufferLength The length of the buffer.
  */
@@ -44,22 +66,76 @@ void parseFlattenedPresetBuffer(const float *buffer, size_t bufferLength) {
         presetCount = MILKY_MAX_PRESETS;
     }
 
-    // iterate over each preset to initialize and populate properties
+    // iterate over each preset to populate and compile its properties
     for (size_t i = 0; i < presetCount; i++) {
         // assign a unique preset number starting from 1
         presets[i].presetNumber = (int) i + 1;
 
-        // initialize property names for the current preset
-        initializePresetPropertyNames(&presets[i]);
-
         // copy properties from the buffer into the current preset
         memcpy(presets[i].properties, buffer + (i * sectionSize), sectionSize * sizeof(float));
+        compilePreset(presets[i].properties, &presets[i].params);
+    }
+}
+
+/**
+ * Returns the number of presets parsed by `parseFlattenedPresetBuffer()`.
+ *
+ * @return The number of loaded presets.
+ */
+size_t getPresetCount(void) {
+    return presetCount;
+}
+
+/**
+ * Returns the compiled parameters of a preset, to be passed to render().
+ *
+ * @param presetIndex The index of the preset.
+ * @return            The parameters, or NULL if the index is out of range.
+ */
+const MilkyPresetParams *getPresetParams(size_t presetIndex) {
+    return presetIndex < presetCount ? &presets[presetIndex].params : NULL;
+}
+
+/**
+ * Returns the parameters render() uses when it is passed no preset.
+ */
+const MilkyPresetParams *getDefaultPresetParams(void) {
+    return &milky_defaultPresetParams;
+}
+
+/**
+ * Looks up the ID of a well-known property by name; meant for loading and tooling, the
+ * render path addresses properties by ID.
+ *
+ * @param propertyName The name of the property.
+ * @return             The MilkyPresetProperty, or -1 if the name is unknown.
+ */
+int findPresetProperty(const char *propertyName) {
+    for (int i = 0; i < MILKY_PRESET_PROPERTY_COUNT; i++) {
+        if (strcmp(milky_presetWellKnownPropertyNames[i], propertyName) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Retrieves a raw property value of a specific preset.
+ *
+ * @param presetIndex The index of the preset.
+ * @param property    The property to retrieve.
+ * @return            The value of the property, or 0.0f if the index is out of range.
+ */
+float getPresetProperty(size_t presetIndex, MilkyPresetProperty property) {
+    if (presetIndex >= presetCount || (unsigned int)property >= MILKY_PRESET_PROPERTY_COUNT) {
+        return 0.0f;
     }
+    return presets[presetIndex].properties[property];
 }
 
 /**
  * Retrieves a property value by name for a specific preset.
- * 
+ *
  * @param presetIndex  The index of the preset.
  * @param propertyName The name of the property to retrieve.
  * @return             The value of the property, or 0.0f if not found.
@@ -71,16 +147,11 @@ float getPresetPropertyByName(size_t presetIndex, const char *propertyName) {
         return 0.0f; // return default value if index is invalid
     }
 
-    // search for the property name within the preset's properties
-    for (size_t i = 0; i < MILKY_MAX_PROPERTY_COUNT_PER_PRESET; i++) {
-        // compare the current property name with the target name
-        if (strcmp(presets[presetIndex].propertyNames[i], propertyName) == 0) {
-            // return the property value if a match is found
-            return presets[presetIndex].properties[i];
-        }
+    int property = findPresetProperty(propertyName);
+    if (property < 0) {
+        // notify if the property name is not found and return default value
+        printf("Property name '%s' not found in preset %zu.\n", propertyName, presetIndex + 1);
+        return 0.0f;
     }
-
-    // notify if the property name is not found and return default value
-    printf("Property name '%s' not found in preset %zu.\n", propertyName, presetIndex + 1);
-    return 0.0f;
+    return presets[presetIndex].properties[property];
 }
@@ -6,10 +6,87 @@
 #include <string.h>
 #include <stdio.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define MILKY_MAX_PRESETS 100
 #define MILKY_MAX_PROPERTY_COUNT_PER_PRESET 64
 
+// size of a cache line; compiled presets are aligned to it so a frame's parameters share lines with nothing else
+#define MILKY_CACHE_LINE 64
+
+// position of every well-known property in a flattened preset, ordered by name
+typedef enum {
+    MILKY_PRESET_DAMPING = 0,
+    MILKY_PRESET_EFFECT_BAR,
+    MILKY_PRESET_EFFECT_CHASERS,
+    MILKY_PRESET_EFFECT_DOTS,
+    MILKY_PRESET_EFFECT_GRID,
+    MILKY_PRESET_EFFECT_NUCLIDE,
+    MILKY_PRESET_EFFECT_SHADEBOBS,
+    MILKY_PRESET_EFFECT_SOLAR,
+    MILKY_PRESET_EFFECT_SPECTRAL,
+    MILKY_PRESET_F1,
+    MILKY_PRESET_F2,
+    MILKY_PRESET_F3,
+    MILKY_PRESET_F4,
+    MILKY_PRESET_GAMMA,
+    MILKY_PRESET_MAGIC,
+    MILKY_PRESET_MODE,
+    MILKY_PRESET_PAL_BFX,
+    MILKY_PRESET_PAL_CURVE_ID_1,
+    MILKY_PRESET_PAL_CURVE_ID_2,
+    MILKY_PRESET_PAL_CURVE_ID_3,
+    MILKY_PRESET_PAL_FXPALNUM,
+    MILKY_PRESET_PAL_HI_OBAND,
+    MILKY_PRESET_PAL_LO_BAND,
+    MILKY_PRESET_S1,
+    MILKY_PRESET_S2,
+    MILKY_PRESET_SHIFT,
+    MILKY_PRESET_SPECTRUM,
+    MILKY_PRESET_T1,
+    MILKY_PRESET_T2,
+    MILKY_PRESET_VOLPOS,
+    MILKY_PRESET_WAVE,
+    MILKY_PRESET_X_CENTER,
+    MILKY_PRESET_Y_CENTER,
+    MILKY_PRESET_PROPERTY_COUNT // number of well-known properties
+} MilkyPresetProperty;
+
+// parameters of render(), compiled once from a preset by compilePreset()
+// render() reads the fields directly, so switching presets is a pointer swap
+typedef struct MilkyPresetParams {
+    // feedback motion, see MilkyMotionParams
+    float zoom;
+    float centerX;
+    float centerY;
+    float magic;
+    float shift;
+    float damping;
+
+    // feedback loop
+    float decay;          // factor the feedback blur fades the previous frame by
+    float warpBlend;      // weight of the motion tap of the feedback warp
+
+    // overlays
+    float waveformVolume; // scale of the smoothed waveform
+    float chaserSpeed;    // speed of the chasers, relative to the speed passed to render()
+    unsigned int chaserCount;
+    int chaserThickness;
+} __attribute__((aligned(MILKY_CACHE_LINE))) MilkyPresetParams;
+
 void parseFlattenedPresetBuffer(const float *buffer, size_t bufferLength);
+size_t getPresetCount(void);
+const MilkyPresetParams *getPresetParams(size_t presetIndex);
+const MilkyPresetParams *getDefaultPresetParams(void);
+void compilePreset(const float *properties, MilkyPresetParams *params);
+int findPresetProperty(const char *propertyName);
+float getPresetProperty(size_t presetIndex, MilkyPresetProperty property);
 float getPresetPropertyByName(size_t presetIndex, const char *propertyName);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // PRESET_H
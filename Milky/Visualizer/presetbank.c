@@ -0,0 +1,248 @@
+/*
+ Binary preset banks.
+
+ A bank holds a whole preset library in one file: a header, an index table with one entry
+ per preset, and fixed-stride records of MilkyPresetProperty floats. It is memory-mapped as
+ is, so opening even a bank of thousands of presets costs one mmap and a few header checks,
+ and no record is read before its preset is first used. Compiled presets go to an anonymous
+ mapping whose pages the kernel only commits when they are written, so resident memory grows
+ with the presets actually used, not with the size of the library.
+
+ Layout (little-endian):
+
+   0                 MilkyPresetBankHeader
+   indexOffset       MilkyPresetBankEntry[presetCount]
+   recordsOffset     recordCount records of recordStride bytes, each propertyCount floats
+
+ Both tables start on a MILKY_PRESET_BANK_ALIGNMENT boundary. writePresetBank() converts
+ the flattened float layout of parseFlattenedPresetBuffer() into a bank.
+*/
+
+#include "presetbank.h"
+
+/**
+ * Rounds an offset up to the alignment of the bank's tables.
+ */
+static uint64_t alignBankOffset(uint64_t offset) {
+    return (offset + MILKY_PRESET_BANK_ALIGNMENT - 1) & ~(uint64_t)(MILKY_PRESET_BANK_ALIGNMENT - 1);
+}
+
+/**
+ * Checks that the header of a mapped bank describes tables within the file.
+ *
+ * @return 0 if the header is valid, -1 (with a message) otherwise.
+ */
+static int validateBankHeader(const MilkyPresetBankHeader *header, size_t size, const char *path) {
+    if (header->magic != MILKY_PRESET_BANK_MAGIC) {
+        fprintf(stderr, "%s is not a preset bank\n", path);
+        return -1;
+    }
+    if (header->version != MILKY_PRESET_BANK_VERSION) {
+        fprintf(stderr, "Unsupported preset bank version %u in %s\n", header->version, path);
+        return -1;
+    }
+    if (header->propertyCount == 0 || header->recordStride % sizeof(float) != 0 ||
+        header->recordStride < (uint64_t)header->propertyCount * sizeof(float)) {
+        fprintf(stderr, "Invalid record layout in preset bank %s\n", path);
+        return -1;
+    }
+
+    // 32-bit counts and strides cannot overflow 64-bit offsets
+    if (header->indexOffset % sizeof(MilkyPresetBankEntry) != 0 || header->indexOffset > size ||
+        (uint64_t)header->presetCount * sizeof(MilkyPresetBankEntry) > size - header->indexOffset ||
+        header->recordsOffset % sizeof(float) != 0 || header->recordsOffset > size ||
+        (uint64_t)header->recordCount * header->recordStride > size - header->recordsOffset) {
+        fprintf(stderr, "Preset bank %s is truncated\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Memory-maps a preset bank. Only the header is checked; the index entries and records of
+ * the presets are checked when they are first used.
+ *
+ * @param bank Receives the mapped bank.
+ * @param path The bank file.
+ * @return     0 on success, -1 on failure.
+ */
+int openPresetBank(MilkyPresetBank *bank, const char *path) {
+    memset(bank, 0, sizeof(MilkyPresetBank));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(MilkyPresetBankHeader)) {
+        fprintf(stderr, "Failed to read the size of %s or it is too small\n", path);
+        close(fd);
+        return -1;
+    }
+
+    bank->mappingSize = (size_t)info.st_size;
+    bank->mapping = mmap(NULL, bank->mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (bank->mapping == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s\n", path);
+        bank->mapping = NULL;
+        return -1;
+    }
+
+    // presets are picked in any order
+    madvise(bank->mapping, bank->mappingSize, MADV_RANDOM);
+
+    const uint8_t *file = (const uint8_t *)bank->mapping;
+    bank->header = (const MilkyPresetBankHeader *)file;
+    if (validateBankHeader(bank->header, bank->mappingSize, path) != 0) {
+        closePresetBank(bank);
+        return -1;
+    }
+    bank->index = (const MilkyPresetBankEntry *)(file + bank->header->indexOffset);
+
+    // compiled presets followed by their decode states, all zero until touched
+    size_t count = bank->header->presetCount;
+    if (count > 0) {
+        bank->paramsSize = count * sizeof(MilkyPresetParams) + count;
+        void *params = mmap(NULL, bank->paramsSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        if (params == MAP_FAILED) {
+            fprintf(stderr, "Failed to reserve memory for %zu presets\n", count);
+            bank->paramsSize = 0;
+            closePresetBank(bank);
+            return -1;
+        }
+        bank->params = (MilkyPresetParams *)params;
+        bank->state = (uint8_t *)(bank->params + count);
+    }
+    return 0;
+}
+
+/**
+ * Unmaps a preset bank and the presets compiled from it.
+ *
+ * @param bank The bank to close.
+ */
+void closePresetBank(MilkyPresetBank *bank) {
+    if (bank->params) {
+        munmap(bank->params, bank->paramsSize);
+    }
+    if (bank->mapping) {
+        munmap(bank->mapping, bank->mappingSize);
+    }
+    memset(bank, 0, sizeof(MilkyPresetBank));
+}
+
+/**
+ * Returns the number of presets in a bank.
+ */
+size_t getPresetBankCount(const MilkyPresetBank *bank) {
+    return bank->header ? bank->header->presetCount : 0;
+}
+
+/**
+ * Returns the number a preset has in its library.
+ *
+ * @param bank        The bank.
+ * @param presetIndex The index of the preset in the bank.
+ * @return            The preset number, or 0 if the index is out of range.
+ */
+uint32_t getPresetBankNumber(const MilkyPresetBank *bank, size_t presetIndex) {
+    return presetIndex < getPresetBankCount(bank) ? bank->index[presetIndex].presetNumber : 0;
+}
+
+/**
+ * Returns the compiled parameters of a preset, to be passed to render(). The preset is
+ * compiled from its record on the first call and served from memory afterwards. Not safe
+ * to call for the same bank from several threads at once.
+ *
+ * @param bank        The bank.
+ * @param presetIndex The index of the preset in the bank.
+ * @return            The parameters, or NULL if the index is out of range or the preset's
+ *                    entry points outside the bank.
+ */
+const MilkyPresetParams *getPresetBankParams(MilkyPresetBank *bank, size_t presetIndex) {
+    if (presetIndex >= getPresetBankCount(bank)) {
+        return NULL;
+    }
+    if (bank->state[presetIndex] == 1) {
+        return &bank->params[presetIndex];
+    }
+    if (bank->state[presetIndex] == 2) {
+        return NULL;
+    }
+
+    const MilkyPresetBankHeader *header = bank->header;
+    uint32_t record = bank->index[presetIndex].record;
+    if (record >= header->recordCount) {
+        fprintf(stderr, "Preset %zu of the bank points to missing record %u\n", presetIndex, record);
+        bank->state[presetIndex] = 2;
+        return NULL;
+    }
+
+    // properties the bank does not store read as 0, properties unknown to this build are ignored
+    float properties[MILKY_MAX_PROPERTY_COUNT_PER_PRESET] = { 0 };
+    size_t propertyCount = header->propertyCount < MILKY_MAX_PROPERTY_COUNT_PER_PRESET ? header->propertyCount : MILKY_MAX_PROPERTY_COUNT_PER_PRESET;
+    const uint8_t *data = (const uint8_t *)bank->mapping + header->recordsOffset + (uint64_t)record * header->recordStride;
+    memcpy(properties, data, propertyCount * sizeof(float));
+
+    compilePreset(properties, &bank->params[presetIndex]);
+    bank->state[presetIndex] = 1;
+    return &bank->params[presetIndex];
+}
+
+/**
+ * Converts presets in the flattened float layout of parseFlattenedPresetBuffer()
+ * (MILKY_MAX_PROPERTY_COUNT_PER_PRESET floats per preset) into a preset bank file.
+ * Presets are numbered from 1, in buffer order.
+ *
+ * @param path         The bank file to write.
+ * @param buffer       The flattened presets.
+ * @param bufferLength The number of floats in the buffer; a trailing partial preset is dropped.
+ * @return             0 on success, -1 on failure.
+ */
+int writePresetBank(const char *path, const float *buffer, size_t bufferLength) {
+    size_t count = bufferLength / MILKY_MAX_PROPERTY_COUNT_PER_PRESET;
+    if (count > UINT32_MAX) {
+        fprintf(stderr, "Too many presets for one bank: %zu\n", count);
+        return -1;
+    }
+
+    MilkyPresetBankHeader header = {
+        .magic = MILKY_PRESET_BANK_MAGIC,
+        .version = MILKY_PRESET_BANK_VERSION,
+        .presetCount = (uint32_t)count,
+        .recordCount = (uint32_t)count,
+        .propertyCount = MILKY_MAX_PROPERTY_COUNT_PER_PRESET,
+        .recordStride = MILKY_MAX_PROPERTY_COUNT_PER_PRESET * sizeof(float),
+        .indexOffset = alignBankOffset(sizeof(MilkyPresetBankHeader))
+    };
+    header.recordsOffset = alignBankOffset(header.indexOffset + count * sizeof(MilkyPresetBankEntry));
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return -1;
+    }
+
+    static const uint8_t padding[MILKY_PRESET_BANK_ALIGNMENT] = { 0 };
+    int written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(padding, 1, header.indexOffset - sizeof(header), file) == header.indexOffset - sizeof(header);
+    for (size_t i = 0; written && i < count; i++) {
+        MilkyPresetBankEntry entry = { (uint32_t)(i + 1), (uint32_t)i };
+        written = fwrite(&entry, sizeof(entry), 1, file) == 1;
+    }
+    size_t gap = header.recordsOffset - header.indexOffset - count * sizeof(MilkyPresetBankEntry);
+    written = written && fwrite(padding, 1, gap, file) == gap;
+
+    // the records are the flattened presets as they are
+    size_t recordFloats = count * MILKY_MAX_PROPERTY_COUNT_PER_PRESET;
+    written = written && fwrite(buffer, sizeof(float), recordFloats, file) == recordFloats;
+
+    if (fclose(file) != 0 || !written) {
+        fprintf(stderr, "Failed to write preset bank %s\n", path);
+        return -1;
+    }
+    return 0;
+}
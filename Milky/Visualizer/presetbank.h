@@ -0,0 +1,67 @@
+#ifndef PRESETBANK_H
+#define PRESETBANK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "preset.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// "MKPB" as stored at the start of a preset bank, read as a little-endian word
+#define MILKY_PRESET_BANK_MAGIC 0x42504B4Du
+#define MILKY_PRESET_BANK_VERSION 1
+
+// alignment of the index table and the records within the file
+#define MILKY_PRESET_BANK_ALIGNMENT 64
+
+// header at offset 0 of a preset bank; all fields little-endian
+typedef struct {
+    uint32_t magic;         // MILKY_PRESET_BANK_MAGIC
+    uint32_t version;       // MILKY_PRESET_BANK_VERSION
+    uint32_t presetCount;   // number of entries in the index table
+    uint32_t recordCount;   // number of records
+    uint32_t propertyCount; // floats per record, indexed by MilkyPresetProperty
+    uint32_t recordStride;  // bytes from one record to the next, a multiple of 4
+    uint64_t indexOffset;   // file offset of the index table
+    uint64_t recordsOffset; // file offset of the first record
+} MilkyPresetBankHeader;
+
+// one entry of the index table, in preset order
+typedef struct {
+    uint32_t presetNumber;  // number of the preset in its library
+    uint32_t record;        // record holding its properties; presets may share one
+} MilkyPresetBankEntry;
+
+// a memory-mapped preset bank; presets are validated and compiled on first use
+typedef struct {
+    void *mapping;                       // the whole mapped file
+    size_t mappingSize;
+    const MilkyPresetBankHeader *header;
+    const MilkyPresetBankEntry *index;
+    MilkyPresetParams *params;           // compiled presets, an anonymous mapping only touched on use
+    size_t paramsSize;
+    uint8_t *state;                      // per preset: 0 = not decoded yet, 1 = compiled, 2 = invalid
+} MilkyPresetBank;
+
+int openPresetBank(MilkyPresetBank *bank, const char *path);
+void closePresetBank(MilkyPresetBank *bank);
+size_t getPresetBankCount(const MilkyPresetBank *bank);
+uint32_t getPresetBankNumber(const MilkyPresetBank *bank, size_t presetIndex);
+const MilkyPresetParams *getPresetBankParams(MilkyPresetBank *bank, size_t presetIndex);
+int writePresetBank(const char *path, const float *buffer, size_t bufferLength);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PRESETBANK_H
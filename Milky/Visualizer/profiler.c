@@ -0,0 +1,145 @@
+#include "profiler.h"
+
+static const char *milky_profilerStageNames[MILKY_STAGE_COUNT] = {
+    "fade", "waveform", "energy", "chasers", "bitDepth", "motion", "warp", "copyBack", "frame"
+};
+
+/**
+ * Maps a duration to its log-linear bucket. Durations below 2^SUB_BUCKET_BITS ns get a
+ * bucket each, above that every power of two is split into 2^SUB_BUCKET_BITS buckets,
+ * so the relative error of a percentile stays below 12.5%.
+ */
+static size_t bucketOf(uint64_t nanoseconds) {
+    const uint64_t subBuckets = 1u << MILKY_PROFILER_SUB_BUCKET_BITS;
+    if (nanoseconds < subBuckets) {
+        return (size_t)nanoseconds;
+    }
+
+    size_t exponent = 63 - (size_t)__builtin_clzll(nanoseconds);
+    size_t shift = exponent - MILKY_PROFILER_SUB_BUCKET_BITS;
+    size_t bucket = ((shift + 1) << MILKY_PROFILER_SUB_BUCKET_BITS) + (size_t)((nanoseconds >> shift) - subBuckets);
+    return bucket < MILKY_PROFILER_BUCKETS ? bucket : MILKY_PROFILER_BUCKETS - 1;
+}
+
+/**
+ * Returns the largest duration that falls into a bucket.
+ */
+static uint64_t bucketUpperBound(size_t bucket) {
+    const uint64_t subBuckets = 1u << MILKY_PROFILER_SUB_BUCKET_BITS;
+    if (bucket < subBuckets) {
+        return bucket;
+    }
+
+    size_t shift = (bucket >> MILKY_PROFILER_SUB_BUCKET_BITS) - 1;
+    uint64_t mantissa = subBuckets + (bucket & (subBuckets - 1));
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/**
+ * Returns the 1-based rank of a quantile among `total` samples (nearest-rank method).
+ */
+static uint64_t rankOf(double quantile, uint64_t total) {
+    uint64_t rank = (uint64_t)ceil(quantile * (double)total);
+    return rank > 0 ? rank : 1;
+}
+
+/**
+ * Adds one duration to the current epoch of a stage. Called by the rendering thread only,
+ * so plain atomic loads and stores suffice; no read-modify-write or lock is needed.
+ *
+ * @param profiler    The profiler of the render context.
+ * @param stage       The stage that ran.
+ * @param nanoseconds The time the stage took.
+ */
+void recordStageTime(MilkyProfiler *profiler, MilkyRenderStage stage, uint64_t nanoseconds) {
+    MilkyStageHistogram *histogram = &profiler->epochs[profiler->epoch][stage];
+    uint32_t *bucket = &histogram->buckets[bucketOf(nanoseconds)];
+
+    __atomic_store_n(bucket, __atomic_load_n(bucket, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    if (nanoseconds > __atomic_load_n(&histogram->max, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&histogram->max, nanoseconds, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Closes a frame; every MILKY_PROFILER_EPOCH_FRAMES frames the oldest epoch is cleared and
+ * becomes the current one, so the window slides over the last EPOCHS * EPOCH_FRAMES frames.
+ *
+ * @param profiler The profiler of the render context.
+ */
+void finishProfilerFrame(MilkyProfiler *profiler) {
+    if (++profiler->framesInEpoch < MILKY_PROFILER_EPOCH_FRAMES) {
+        return;
+    }
+
+    uint32_t next = (profiler->epoch + 1) % MILKY_PROFILER_EPOCHS;
+    for (size_t s = 0; s < MILKY_STAGE_COUNT; s++) {
+        MilkyStageHistogram *histogram = &profiler->epochs[next][s];
+        for (size_t b = 0; b < MILKY_PROFILER_BUCKETS; b++) {
+            __atomic_store_n(&histogram->buckets[b], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&histogram->max, 0, __ATOMIC_RELAXED);
+    }
+
+    profiler->framesInEpoch = 0;
+    __atomic_store_n(&profiler->epoch, next, __ATOMIC_RELEASE);
+}
+
+/**
+ * Computes the percentiles of every stage over the sliding window. Safe to call from any
+ * thread while the context renders; percentiles are bucket upper bounds, max is exact.
+ *
+ * @param profiler  The profiler to read.
+ * @param timings   Receives one entry per stage, indexed by MilkyRenderStage.
+ * @param maxStages The capacity of `timings`.
+ * @return          The number of entries written.
+ */
+size_t readStageTimings(const MilkyProfiler *profiler, MilkyStageTiming *timings, size_t maxStages) {
+    size_t stageCount = maxStages < MILKY_STAGE_COUNT ? maxStages : MILKY_STAGE_COUNT;
+    static const double quantiles[3] = { 0.50, 0.95, 0.99 };
+
+    for (size_t s = 0; s < stageCount; s++) {
+        uint32_t counts[MILKY_PROFILER_BUCKETS];
+        uint64_t total = 0;
+        uint64_t max = 0;
+        memset(counts, 0, sizeof(counts));
+
+        for (size_t e = 0; e < MILKY_PROFILER_EPOCHS; e++) {
+            const MilkyStageHistogram *histogram = &profiler->epochs[e][s];
+            for (size_t b = 0; b < MILKY_PROFILER_BUCKETS; b++) {
+                uint32_t count = __atomic_load_n(&histogram->buckets[b], __ATOMIC_RELAXED);
+                counts[b] += count;
+                total += count;
+            }
+            uint64_t epochMax = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+            if (epochMax > max) max = epochMax;
+        }
+
+        uint64_t results[3] = { 0, 0, 0 };
+        uint64_t seen = 0;
+        size_t q = 0;
+        for (size_t b = 0; b < MILKY_PROFILER_BUCKETS && q < 3 && total > 0; b++) {
+            seen += counts[b];
+            while (q < 3 && seen >= rankOf(quantiles[q], total)) {
+                results[q++] = bucketUpperBound(b);
+            }
+        }
+
+        timings[s].count = total;
+        timings[s].p50 = results[0] < max ? results[0] : max;
+        timings[s].p95 = results[1] < max ? results[1] : max;
+        timings[s].p99 = results[2] < max ? results[2] : max;
+        timings[s].max = max;
+    }
+    return stageCount;
+}
+
+/**
+ * Returns the display name of a render stage.
+ *
+ * @param stage The stage.
+ * @return      A static name, "unknown" for out-of-range values.
+ */
+const char *getRenderStageName(MilkyRenderStage stage) {
+    return (unsigned)stage < MILKY_STAGE_COUNT ? milky_profilerStageNames[stage] : "unknown";
+}
@@ -0,0 +1,84 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// stages of render() that are timed individually
+typedef enum {
+    MILKY_STAGE_FADE = 0,    // fade of the previous frame and palette lookup
+    MILKY_STAGE_WAVEFORM,    // waveform smoothing and drawing
+    MILKY_STAGE_ENERGY,      // energy spike detection
+    MILKY_STAGE_CHASERS,     // chaser drawing
+    MILKY_STAGE_BIT_DEPTH,   // bit depth reduction
+    MILKY_STAGE_MOTION,      // motion mesh evaluation (rotation and zoom)
+    MILKY_STAGE_WARP,        // fused rotate, scale and blend into the previous frame
+    MILKY_STAGE_COPY_BACK,   // copy (or intensity expansion) of the warped frame into the canvas
+    MILKY_STAGE_FRAME,       // the whole render() call
+    MILKY_STAGE_COUNT
+} MilkyRenderStage;
+
+// frame time percentiles of one stage over the sliding window, in nanoseconds
+typedef struct {
+    uint64_t count; // number of samples in the window
+    uint64_t p50;
+    uint64_t p95;
+    uint64_t p99;
+    uint64_t max;
+} MilkyStageTiming;
+
+// number of frames per histogram epoch
+#define MILKY_PROFILER_EPOCH_FRAMES 64
+
+// number of epochs the sliding window spans; the oldest is recycled once the newest is full
+#define MILKY_PROFILER_EPOCHS 8
+
+// log-linear buckets: 8 sub-buckets per power of two, up to 2^36 ns (about 68 seconds)
+#define MILKY_PROFILER_SUB_BUCKET_BITS 3
+#define MILKY_PROFILER_BUCKETS ((36 - MILKY_PROFILER_SUB_BUCKET_BITS + 1) << MILKY_PROFILER_SUB_BUCKET_BITS)
+
+// counts of one stage during one epoch
+typedef struct {
+    uint32_t buckets[MILKY_PROFILER_BUCKETS];
+    uint64_t max;
+} MilkyStageHistogram;
+
+// per-stage frame time histograms of one render context.
+// Only the rendering thread writes; any thread may read at any time without locking.
+// A reader racing with the recycling of an epoch sees that epoch partially cleared,
+// which only shortens the window for that one query.
+typedef struct {
+    MilkyStageHistogram epochs[MILKY_PROFILER_EPOCHS][MILKY_STAGE_COUNT];
+    uint32_t epoch;            // epoch currently written
+    uint32_t framesInEpoch;
+    int disabled;
+} MilkyProfiler;
+
+/**
+ * Reads the monotonic clock.
+ *
+ * @return The current time in nanoseconds.
+ */
+static inline uint64_t profilerNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+void recordStageTime(MilkyProfiler *profiler, MilkyRenderStage stage, uint64_t nanoseconds);
+void finishProfilerFrame(MilkyProfiler *profiler);
+size_t readStageTimings(const MilkyProfiler *profiler, MilkyStageTiming *timings, size_t maxStages);
+const char *getRenderStageName(MilkyRenderStage stage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,49 @@
+#include "random.h"
+
+/**
+ * Seeds a random stream. Equal seeds and streams always produce the same sequence, on
+ * every platform, unlike rand() whose generator and global state are shared process-wide.
+ *
+ * @param random The stream to seed.
+ * @param seed   The seed of the render context.
+ * @param stream The subsystem the stream belongs to.
+ */
+void seedRandom(MilkyRandom *random, uint64_t seed, MilkyRandomStream stream) {
+    random->state = 0;
+    random->increment = ((uint64_t)stream << 1) | 1u;
+    nextRandom(random);
+    random->state += seed;
+    nextRandom(random);
+}
+
+/**
+ * Draws the next 32-bit value of a random stream (PCG32, XSH-RR output).
+ *
+ * @param random The stream to draw from.
+ * @return       A uniformly distributed 32-bit value.
+ */
+uint32_t nextRandom(MilkyRandom *random) {
+    uint64_t previous = random->state;
+    // a zero-initialized stream still advances, it just shares the sequence of stream 0
+    random->state = previous * 6364136223846793005ULL + (random->increment | 1u);
+    uint32_t xorShifted = (uint32_t)(((previous >> 18) ^ previous) >> 27);
+    uint32_t rotation = (uint32_t)(previous >> 59);
+    return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+}
+
+/**
+ * Draws a value in [0, bound) without modulo bias.
+ *
+ * @param random The stream to draw from.
+ * @param bound  The exclusive upper bound, must be positive.
+ * @return       A uniformly distributed value below `bound`.
+ */
+uint32_t nextRandomBelow(MilkyRandom *random, uint32_t bound) {
+    uint32_t threshold = (0u - bound) % bound;
+    for (;;) {
+        uint32_t value = nextRandom(random);
+        if (value >= threshold) {
+            return value % bound;
+        }
+    }
+}
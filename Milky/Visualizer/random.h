@@ -0,0 +1,25 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// random streams of a render context; every subsystem draws from its own stream, so
+// adding or removing draws in one of them never shifts the sequence of another
+typedef enum {
+    MILKY_RANDOM_PALETTE = 1,
+    MILKY_RANDOM_ROTATION = 2,
+    MILKY_RANDOM_CHASERS = 3
+} MilkyRandomStream;
+
+// state of one PCG32 random stream
+typedef struct {
+    uint64_t state;
+    uint64_t increment; // odd, selects the stream
+} MilkyRandom;
+
+void seedRandom(MilkyRandom *random, uint64_t seed, MilkyRandomStream stream);
+uint32_t nextRandom(MilkyRandom *random);
+uint32_t nextRandomBelow(MilkyRandom *random, uint32_t bound);
+
+#endif // RANDOM_H
@@ -4,42 +4,427 @@
 #include "./audio/energy.h"
 #include "./video/bitdepth.h"
 #include "./video/transform.h"
+#include "./video/mesh.h"
 #include "./video/draw.h"
 #include "./video/palette.h"
 #include "./video/effects/chaser.h"
 #include "./video/blur.h"
+#include "./video/kernels.h"
+#include "./video/resample.h"
+#include "./preset.h"
+#include "./workers.h"
+#include "./random.h"
+#include "./profiler.h"
 
-// flag to check if lastFrame is initialized
-static int milky_videoIsLastFrameInitialized = 0;
+// all state of one visualizer instance; see createRenderContext()
+struct MilkyRenderContext {
+    // flag to check if lastFrame is initialized
+    int isLastFrameInitialized;
 
-// global variable to store the previous time
-static size_t milky_videoPrevTime = 0;
-static size_t milky_videoPrevFrameSize = 0;
-static float milky_videoSpeedScalar = 0.01f;
+    // previous time and animation speed
+    size_t prevTime;
+    size_t startTime;   // time of the first frame, the motion's time counts from here
+    int clockStarted;
+    size_t prevFrameSize;
+    float speedScalar;
 
-// static buffer to be reused across render calls
-static uint8_t *milky_videoTempBuffer = NULL;
-static uint8_t *milky_videoPrevFrame = NULL;
-static size_t milky_videoTempBufferSize = 0;
-static size_t milky_videoLastCanvasWidthPx = 0;
-static size_t milky_videoLastCanvasHeightPx = 0;
+    // feedback buffers, reused across render calls
+    uint8_t *tempBuffer;
+    uint8_t *prevFrame;
+    size_t tempBufferSize;
+    size_t lastCanvasWidthPx;
+    size_t lastCanvasHeightPx;
+
+    // layout of the feedback buffers; the buffers are reallocated when it changes
+    MilkyFeedbackMode feedbackMode;
+    MilkyFeedbackMode allocatedFeedbackMode;
+
+    // coarse motion mesh of the feedback warp, re-evaluated every frame
+    MilkyWarpMesh warpMesh;
+    MilkyRotationState rotation;
+
+    MilkyPalette palette;
+    MilkyEnergyState energy;
+    MilkySoundState sound;
+    MilkyChaserState chasers;
+
+    // worker threads the band-parallel stages of this context run on
+    MilkyWorkerPool workers;
+
+    // frame time histograms of the render stages
+    MilkyProfiler profiler;
+
+    // bilinear scaler of upscaleFrame(), and whether its failure was already reported
+    MilkyScaler scaler;
+    int scalerFailed;
+
+    // bit depth reduction: how it dithers and the tables of the current bit depth
+    MilkyDitherMode ditherMode;
+    MilkyDither dither;
+};
+
+// per-frame state shared by the band-parallel stages of render()
+typedef struct {
+    MilkyRenderContext *context;
+    uint8_t *frame;
+    size_t width;
+    size_t height;
+    int fade;         // whether the previous frame is faded into the canvas
+    uint8_t bitDepth;
+    float blend;      // weight of the motion tap of the feedback warp
+    const MilkyPresetParams *preset; // parameters of the frame
+    uint8_t feedbackLut[256];  // intensity mode: fade and palette lookup of the feedback loop
+    uint32_t displayLut[256];  // intensity mode: RGBA color per intensity
+} MilkyVideoStage;
+
+// the waveform strokes: an opaque white line with a faint rim one pixel wide, and a faint
+// glow around it reaching one pixel further down (premultiplied white, opaque and at 25%)
+static const MilkyStrokeStyle milky_waveformLayers[] = {
+    { .width = MILKY_WAVEFORM_THICKNESS, .glow = 1.0f, .glowAlpha = 0.25f, .color = 0xFFFFFFFFu, .mode = MILKY_BLEND_OVER },
+    { .width = MILKY_WAVEFORM_THICKNESS + 2, .color = 0x40404040u, .mode = MILKY_BLEND_OVER, .offsetY = 1.0f }
+};
 
 /**
- * Renders one visual frame based on audio waveform and spectrum data.
+ * Sets the layout of the feedback buffers.
+ * MILKY_FEEDBACK_INTENSITY keeps a single 8-bit plane per buffer, holding the red channel the
+ * palette is indexed by, and expands it to RGBA only once per frame, into the canvas.
+ * MILKY_FEEDBACK_RGBA runs the whole feedback loop on RGBA frames.
  *
- * @param frame           Canvas frame buffer (RGBA format).
- * @param canvasWidthPx   Canvas width in pixels.
- * @param canvasHeightPx  Canvas height in pixels.
- * @param waveform        Waveform data array, 8-bit unsigned integers, 576 samples.
- * @param spectrum        Spectrum data array.
- * @param waveformLength  Length of the waveform data array.
- * @param spectrumLength  Length of the spectrum data array.
- * @param bitDepth        Bit depth of the rendering.
- * @param presetsBuffer   Preset data.
- * @param speed           Speed factor for the rendering.
- * @param currentTime     Current time in milliseconds.
- * @param sampleRate      Waveform sample rate (samples per second)
- */void render(
+ * @param context The render context to configure.
+ * @param mode    The feedback buffer layout.
+ */
+void setFeedbackMode(MilkyRenderContext *context, MilkyFeedbackMode mode) {
+    context->feedbackMode = mode;
+}
+
+/**
+ * Sets how the bit depth reduction dithers (only used below 32 bits).
+ * MILKY_DITHER_ORDERED adds a tiled Bayer pattern before quantizing, at the cost of a table
+ * lookup per channel. MILKY_DITHER_NONE rounds to the nearest level. MILKY_DITHER_DIFFUSION
+ * runs Floyd-Steinberg error diffusion, serially on the rendering thread, for offline renders.
+ *
+ * @param context The render context to configure.
+ * @param mode    The dither mode.
+ */
+void setDitherMode(MilkyRenderContext *context, MilkyDitherMode mode) {
+    context->ditherMode = mode;
+}
+
+/**
+ * Sets the number of threads the render pipeline of a context is split across
+ * (including the thread calling `render()`). 0 selects one thread per online core.
+ * Must not be called while the context is rendering.
+ *
+ * @param context     The render context to configure.
+ * @param threadCount The number of render threads.
+ */
+void setRenderThreadCount(MilkyRenderContext *context, size_t threadCount) {
+    setWorkerPoolThreadCount(&context->workers, threadCount);
+}
+
+/**
+ * Returns the number of threads the render pipeline of a context is split across.
+ *
+ * @param context The render context to inspect.
+ * @return        The number of render threads, including the rendering thread.
+ */
+size_t getRenderThreadCount(const MilkyRenderContext *context) {
+    return getWorkerPoolThreadCount(&context->workers);
+}
+
+/**
+ * Seeds the random streams of a context (palette and rotation). Contexts with equal seeds
+ * render identical frames from identical input, which makes output reproducible for
+ * offline rendering and regression tests. Call it before the first render() of the context;
+ * without it, every context is seeded from the clock.
+ *
+ * @param context The render context to seed.
+ * @param seed    The seed.
+ */
+void setRenderSeed(MilkyRenderContext *context, uint64_t seed) {
+    seedRandom(&context->palette.random, seed, MILKY_RANDOM_PALETTE);
+    seedRandom(&context->rotation.random, seed, MILKY_RANDOM_ROTATION);
+}
+
+/**
+ * Enables or disables the per-stage timing of a context. Timing costs two clock reads
+ * per stage and frame, so it is on by default. Must not be called while the context is rendering.
+ *
+ * @param context The render context to configure.
+ * @param enabled Non-zero to time the render stages.
+ */
+void setRenderProfiling(MilkyRenderContext *context, int enabled) {
+    context->profiler.disabled = !enabled;
+}
+
+/**
+ * Returns the p50/p95/p99/max time of every render stage over the last
+ * MILKY_PROFILER_EPOCHS * MILKY_PROFILER_EPOCH_FRAMES frames. May be called from any
+ * thread, also while the context is rendering.
+ *
+ * @param context   The render context to inspect.
+ * @param timings   Receives one entry per stage, indexed by MilkyRenderStage.
+ * @param maxStages The capacity of `timings`.
+ * @return          The number of entries written.
+ */
+size_t getRenderStageTimings(const MilkyRenderContext *context, MilkyStageTiming *timings, size_t maxStages) {
+    return readStageTimings(&context->profiler, timings, maxStages);
+}
+
+/**
+ * Records the time since `since` for a stage, if profiling is enabled.
+ *
+ * @return The current time, the start of the next stage.
+ */
+static uint64_t finishStage(MilkyRenderContext *context, MilkyRenderStage stage, uint64_t since) {
+    if (context->profiler.disabled) return 0;
+
+    uint64_t now = profilerNow();
+    recordStageTime(&context->profiler, stage, now - since);
+    return now;
+}
+
+/**
+ * Creates an independent visualizer instance. Contexts share no mutable state, so
+ * several of them can render concurrently on separate threads.
+ *
+ * @return The new render context, or NULL if memory ran out.
+ */
+MilkyRenderContext *createRenderContext(void) {
+    MilkyRenderContext *context = (MilkyRenderContext *)calloc(1, sizeof(MilkyRenderContext));
+    if (!context) {
+        fprintf(stderr, "Failed to allocate render context\n");
+        return NULL;
+    }
+
+    context->speedScalar = 0.01f;
+    context->feedbackMode = MILKY_FEEDBACK_INTENSITY;
+    context->allocatedFeedbackMode = MILKY_FEEDBACK_INTENSITY;
+    initWarpMesh(&context->warpMesh);
+    initEnergyState(&context->energy);
+    initWorkerPool(&context->workers);
+
+    // a different look per instance, unless the caller picks a seed
+    setRenderSeed(context, (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)context);
+    return context;
+}
+
+/**
+ * Stops the workers of a render context and releases all of its memory.
+ *
+ * @param context The render context to destroy, may be NULL.
+ */
+void destroyRenderContext(MilkyRenderContext *context) {
+    if (!context) return;
+
+    destroyWorkerPool(&context->workers);
+    freeScaler(&context->scaler);
+    free(context->prevFrame);
+    free(context->tempBuffer);
+    free(context);
+}
+
+/**
+ * Band stage: fades the previous frame, copies it into the canvas and applies the palette.
+ * All of it stays within the band's rows, so no barrier is needed in between.
+ */
+static void fadeAndPaletteRows(void *arg, size_t firstRow, size_t lastRow) {
+    const MilkyVideoStage *stage = (const MilkyVideoStage *)arg;
+    MilkyRenderContext *context = stage->context;
+    size_t first = firstRow * stage->width * 4;
+    size_t last = lastRow * stage->width * 4;
+    size_t frameSize = stage->height * stage->width * 4;
+
+    if (stage->fade) {
+        blurFrameRange(context->prevFrame, frameSize, first, last, 2, stage->preset->decay);
+        preserveMassFade(context->prevFrame + first, context->tempBuffer + first, last - first);
+
+        #ifdef __ARM_NEON__
+        size_t i = first;
+        for (; i + 16 <= last; i += 16) {
+            uint8x16_t prevFrameData = vld1q_u8(&context->prevFrame[i]);
+            vst1q_u8(&context->tempBuffer[i], prevFrameData);
+            vst1q_u8(&stage->frame[i], prevFrameData);
+        }
+        for (; i < last; i++) {
+            context->tempBuffer[i] = context->prevFrame[i];
+            stage->frame[i] = context->tempBuffer[i];
+        }
+        #else
+        memcpy(context->tempBuffer + first, context->prevFrame + first, last - first);
+        memcpy(stage->frame + first, context->tempBuffer + first, last - first);
+        #endif
+    }
+
+    applyPaletteToRows(&context->palette, stage->frame, stage->width, firstRow, lastRow);
+}
+
+/**
+ * Band stage: reduces the bit depth of the canvas rows.
+ */
+static void bitDepthRows(void *arg, size_t firstRow, size_t lastRow) {
+    const MilkyVideoStage *stage = (const MilkyVideoStage *)arg;
+    ditherRows(&stage->context->dither, stage->frame, stage->width, firstRow, lastRow);
+}
+
+/**
+ * Band stage: warps the canvas into the rows of the previous frame buffer.
+ * Gathers from the whole canvas, so it runs behind a barrier.
+ */
+static void warpRows(void *arg, size_t firstRow, size_t lastRow) {
+    const MilkyVideoStage *stage = (const MilkyVideoStage *)arg;
+    MilkyRenderContext *context = stage->context;
+
+    meshWarpRows(&context->warpMesh, stage->frame, context->prevFrame, stage->blend, MILKY_WARP_SAMPLE_NEAREST, firstRow, lastRow);
+}
+
+/**
+ * Band stage (intensity mode): fades the previous plane through the palette into the working plane.
+ */
+static void feedbackPlaneRows(void *arg, size_t firstRow, size_t lastRow) {
+    const MilkyVideoStage *stage = (const MilkyVideoStage *)arg;
+    MilkyRenderContext *context = stage->context;
+
+    size_t first = firstRow * stage->width;
+    size_t last = lastRow * stage->width;
+
+    getKernels()->mapBytes(context->prevFrame + first, context->tempBuffer + first, last - first, stage->feedbackLut);
+}
+
+/**
+ * Band stage: draws the chaser trails into the canvas rows.
+ */
+static void chaserRows(void *arg, size_t firstRow, size_t lastRow) {
+    const MilkyVideoStage *stage = (const MilkyVideoStage *)arg;
+    MilkyRenderContext *context = stage->context;
+    const int intensity = context->allocatedFeedbackMode == MILKY_FEEDBACK_INTENSITY;
+
+    // the draw pixel format is kept per thread, so every worker selects it for itself
+    setDrawPixelFormat(intensity ? MILKY_PIXEL_FORMAT_INTENSITY : MILKY_PIXEL_FORMAT_RGBA);
+    drawChaserRows(&context->chasers, intensity ? context->tempBuffer : stage->frame, stage->width, stage->height,
+                   stage->preset->chaserThickness, firstRow, lastRow);
+}
+
+/**
+ * Band stage (intensity mode): reduces the bit depth of the working plane rows.
+ */
+static void bitDepthPlaneRows(void *arg, size_t firstRow, size_t lastRow) {
+    const MilkyVideoStage *stage = (const MilkyVideoStage *)arg;
+    MilkyRenderContext *context = stage->context;
+
+    ditherPlaneRows(&context->dither, context->tempBuffer, stage->width, firstRow, lastRow);
+}
+
+/**
+ * Band stage (intensity mode): warps the working plane into the rows of the previous plane.
+ * Gathers from the whole plane, so it runs behind a barrier.
+ */
+static void warpPlaneRows(void *arg, size_t firstRow, size_t lastRow) {
+    const MilkyVideoStage *stage = (const MilkyVideoStage *)arg;
+    MilkyRenderContext *context = stage->context;
+
+    meshWarpPlaneRows(&context->warpMesh, context->tempBuffer, context->prevFrame, stage->blend, MILKY_WARP_SAMPLE_NEAREST, firstRow, lastRow);
+}
+
+/**
+ * Band stage (intensity mode): expands the warped plane rows into the canvas for display.
+ */
+static void expandPlaneRows(void *arg, size_t firstRow, size_t lastRow) {
+    const MilkyVideoStage *stage = (const MilkyVideoStage *)arg;
+    MilkyRenderContext *context = stage->context;
+
+    expandIntensityRows(context->prevFrame, stage->frame, stage->width, firstRow, lastRow, stage->displayLut);
+}
+
+/**
+ * Band stage: copies the warped rows back into the canvas for display.
+ */
+static void copyBackRows(void *arg, size_t firstRow, size_t lastRow) {
+    const MilkyVideoStage *stage = (const MilkyVideoStage *)arg;
+    MilkyRenderContext *context = stage->context;
+    size_t first = firstRow * stage->width * 4;
+    size_t last = lastRow * stage->width * 4;
+
+    #ifdef __ARM_NEON__
+    size_t j = first;
+    for (; j + 16 <= last; j += 16) {
+        vst1q_u8(&stage->frame[j], vld1q_u8(&context->prevFrame[j]));
+    }
+    for (; j < last; j++) {
+        stage->frame[j] = context->prevFrame[j];
+    }
+    #else
+    memcpy(stage->frame + first, context->prevFrame + first, last - first);
+    #endif
+}
+
+// source and destination of a band-parallel upscale
+typedef struct {
+    const MilkyScaler *scaler;
+    const uint8_t *src;
+    uint8_t *dst;
+} MilkyScaleStage;
+
+/**
+ * Band stage: scales the destination rows of upscaleFrame().
+ */
+static void scaleRows(void *arg, size_t firstRow, size_t lastRow) {
+    const MilkyScaleStage *stage = (const MilkyScaleStage *)arg;
+    scaleRowsBilinear(stage->scaler, stage->src, stage->dst, firstRow, lastRow);
+}
+
+/**
+ * Scales a rendered RGBA frame to the output size with bilinear filtering, band-parallel on
+ * the workers of the context. Lets a render loop render below the output resolution when
+ * frames run over budget (see governor.c) while still delivering frames of a fixed size.
+ * If the scaler cannot be prepared, the frame is scaled with nearest-neighbour sampling
+ * instead and the failure is reported once per context.
+ *
+ * @param context   The render context whose workers do the scaling.
+ * @param src       The rendered frame.
+ * @param srcWidth  The width of the rendered frame.
+ * @param srcHeight The height of the rendered frame.
+ * @param dst       Receives the scaled frame, must not overlap `src`.
+ * @param dstWidth  The output width.
+ * @param dstHeight The output height.
+ */
+void upscaleFrame(MilkyRenderContext *context, const uint8_t *src, size_t srcWidth, size_t srcHeight, uint8_t *dst, size_t dstWidth, size_t dstHeight) {
+    if (srcWidth == dstWidth && srcHeight == dstHeight) {
+        memcpy(dst, src, dstWidth * dstHeight * 4);
+        return;
+    }
+    if (dstWidth == 0 || dstHeight == 0) {
+        return;
+    }
+    if (srcWidth == 0 || srcHeight == 0) {
+        memset(dst, 0, dstWidth * dstHeight * 4);
+        return;
+    }
+
+    // without scaler taps, nearest-neighbour sampling still delivers a frame of the output size
+    if (prepareScaler(&context->scaler, srcWidth, srcHeight, dstWidth, dstHeight) != 0) {
+        if (!context->scalerFailed) {
+            fprintf(stderr, "Failed to prepare the scaler for %zux%zu to %zux%zu, upscaling without filtering\n",
+                    srcWidth, srcHeight, dstWidth, dstHeight);
+            context->scalerFailed = 1;
+        }
+        resampleNearest(src, srcWidth, srcHeight, dst, dstWidth, dstHeight, 4);
+        return;
+    }
+
+    MilkyScaleStage stage = { &context->scaler, src, dst };
+    runRowBands(&context->workers, scaleRows, &stage, dstHeight);
+}
+
+/**
+ * Renders one visual frame; the body of `render()` and `renderAudioFeatures()`.
+ *
+ * @param features  Features the waveform and spectrum were taken from, whose energy spike
+ *                  flag is used; NULL to detect energy spikes from the waveform and spectrum.
+ * (all other parameters as in `render()`)
+ */
+static void renderFrame(
+               MilkyRenderContext *context,
                uint8_t *frame,
                size_t canvasWidthPx,
                size_t canvasHeightPx,
@@ -47,8 +432,9 @@ static size_t milky_videoLastCanvasHeightPx = 0;
                const uint8_t *spectrum,
                size_t waveformLength,
                size_t spectrumLength,
+               const MilkyAudioFeatures *features,
                uint8_t bitDepth,
-               float *presetsBuffer,
+               const MilkyPresetParams *preset,
                float speed,
                size_t currentTime,
                size_t sampleRate
@@ -57,154 +443,239 @@ static size_t milky_videoLastCanvasHeightPx = 0;
                    fprintf(stderr, "No waveform or spectrum data provided\n");
                    return;
                }
+               if (!preset) {
+                   preset = getDefaultPresetParams();
+               }
+
+               // Time every stage; the whole call is recorded as the frame stage
+               const uint64_t frameStart = context->profiler.disabled ? 0 : profilerNow();
 
                // Pre-calculate frame size and check memory requirements once
                const size_t frameSize = canvasWidthPx * canvasHeightPx * 4;
 
-               if (milky_videoPrevFrameSize == 0) {
-                   milky_videoPrevFrameSize = frameSize;
+               // Only update memory if canvas size or feedback mode changes
+               reserveAndUpdateMemory(context, canvasWidthPx, canvasHeightPx, frame, frameSize);
+               if (!context->prevFrame || !context->tempBuffer) {
+                   return;
                }
 
-               // Only update memory if canvas size changes
-               reserveAndUpdateMemory(canvasWidthPx, canvasHeightPx, frame, frameSize);
-             
-             // Process emphasized waveform
-             float emphasizedWaveform[waveformLength];
-             smoothBassEmphasizedWaveform(waveform, waveformLength, emphasizedWaveform, canvasWidthPx, 0.7f);
-     
-                // Pre-calculate time frame and constants outside of per-pixel rendering for efficiency
-                const float timeFrame = (milky_videoPrevTime == 0) ? 0.01f : (currentTime - milky_videoPrevTime) / 1000.0f;
+               // In intensity mode the effects work on the 8-bit plane, the canvas is only written at the end
+               const int intensity = context->allocatedFeedbackMode == MILKY_FEEDBACK_INTENSITY;
+               uint8_t *canvas = intensity ? context->tempBuffer : frame;
+
+               MilkyVideoStage stage = {
+                   .context = context,
+                   .frame = frame,
+                   .width = canvasWidthPx,
+                   .height = canvasHeightPx,
+                   .fade = context->isLastFrameInitialized,
+                   .bitDepth = bitDepth,
+                   .blend = preset->warpBlend,
+                   .preset = preset
+               };
 
-               // Optimize buffer copies for NEON by vectorizing the copying operation
-               // Copy the previous frame to a temporary buffer, minimizing redundant operations
-               if (!milky_videoIsLastFrameInitialized) {
+               if (!context->isLastFrameInitialized) {
                    clearFrame(frame, frameSize);
-                   clearFrame(milky_videoPrevFrame, milky_videoPrevFrameSize);
-                   milky_videoIsLastFrameInitialized = 1;
+                   clearFrame(context->prevFrame, context->prevFrameSize);
+                   context->isLastFrameInitialized = 1;
                } else {
-                   milky_videoSpeedScalar += speed;
-
-                   blurFrame(milky_videoPrevFrame, frameSize, 2, 0.9f);
-                   preserveMassFade(milky_videoPrevFrame, milky_videoTempBuffer, frameSize);
-                   
-                   #ifdef __ARM_NEON__
-                   size_t i = 0;
-                   for (; i + 16 <= frameSize; i += 16) {
-                       uint8x16_t prevFrameData = vld1q_u8(&milky_videoPrevFrame[i]);
-                       vst1q_u8(&milky_videoTempBuffer[i], prevFrameData);
-                       vst1q_u8(&frame[i], prevFrameData);
-                   }
-                   for (; i < frameSize; i++) {
-                       milky_videoTempBuffer[i] = milky_videoPrevFrame[i];
-                       frame[i] = milky_videoTempBuffer[i];
-                   }
-                   #else
-                   memcpy(milky_videoTempBuffer, milky_videoPrevFrame, frameSize);
-                   memcpy(frame, milky_videoTempBuffer, frameSize);
-                   #endif
+                   context->speedScalar += speed;
                }
 
+               // seconds since the previous frame, for the energy detector's cooldown and smoothing
+               const float frameInterval = context->clockStarted && currentTime > context->prevTime
+                                         ? (currentTime - context->prevTime) / 1000.0f : MILKY_DETECTOR_FRAME_SECONDS;
+               context->prevTime = currentTime;
+               if (!context->clockStarted || currentTime < context->startTime) {
+                   context->startTime = currentTime;
+                   context->clockStarted = 1;
+               }
+               uint64_t stageStart = frameStart;
 
-               milky_videoPrevTime = currentTime;
+               // Fade the previous frame into the canvas and apply the color palette, band-parallel
+               updatePalette(&context->palette, currentTime, context->energy.spikeDetected);
+               if (intensity) {
+                   // the red channel is faded twice per frame by the RGBA blur
+                   uint8_t fadeLut[256];
+                   buildFadeLut(fadeLut, 2, preset->decay);
+                   buildFeedbackLut(&context->palette, fadeLut, stage.feedbackLut);
+                   runRowBands(&context->workers, feedbackPlaneRows, &stage, canvasHeightPx);
+                   setDrawPixelFormat(MILKY_PIXEL_FORMAT_INTENSITY);
+               } else {
+                   runRowBands(&context->workers, fadeAndPaletteRows, &stage, canvasHeightPx);
+               }
+               stageStart = finishStage(context, MILKY_STAGE_FADE, stageStart);
 
-               // Apply color palette for visual effects
-               applyPaletteToCanvas(currentTime, frame, canvasWidthPx, canvasHeightPx);
+               // Process emphasized waveform
+               float emphasizedWaveform[waveformLength];
+               smoothBassEmphasizedWaveform(&context->sound, waveform, waveformLength, emphasizedWaveform, canvasWidthPx, preset->waveformVolume);
 
                // Render waveform with multiple emphasis levels
-               //renderWaveformSimple(timeFrame, frame, canvasWidthPx, canvasHeightPx, emphasizedWaveform, waveformLength, 0.85f, 1, 1);
-               renderWaveformSimple(timeFrame, frame, canvasWidthPx, canvasHeightPx, emphasizedWaveform, waveformLength, 5.0f, 0, 0);
-               renderWaveformSimple(timeFrame, frame, canvasWidthPx, canvasHeightPx, emphasizedWaveform, waveformLength, 0.0f, 1, 0);
+               renderWaveform(&context->sound, canvas, canvasWidthPx, canvasHeightPx, emphasizedWaveform, waveformLength,
+                              milky_waveformLayers, sizeof(milky_waveformLayers) / sizeof(milky_waveformLayers[0]));
+               stageStart = finishStage(context, MILKY_STAGE_WAVEFORM, stageStart);
      
-              //preserveMassFade(frame, milky_videoPrevFrame, frameSize);
+              //preserveMassFade(frame, context->prevFrame, frameSize);
      
-               detectEnergySpike(waveform, spectrum, waveformLength, spectrumLength, sampleRate);
+               if (features) {
+                   // the analysis has already run the detector on every window
+                   context->energy.spikeDetected = features->spikeDetected;
+                   context->energy.energy = features->energy;
+               } else {
+                   detectEnergySpike(&context->energy, waveform, spectrum, waveformLength, spectrumLength, sampleRate, frameInterval);
+               }
+               stageStart = finishStage(context, MILKY_STAGE_ENERGY, stageStart);
 
-               renderChasers(milky_videoSpeedScalar, frame, speed * 20, 2, canvasWidthPx, canvasHeightPx, 42, 2);
+               updateChasers(&context->chasers, context->speedScalar, speed * preset->chaserSpeed, preset->chaserCount, canvasWidthPx, canvasHeightPx, 42);
+               runRowBands(&context->workers, chaserRows, &stage, canvasHeightPx);
+               setDrawPixelFormat(MILKY_PIXEL_FORMAT_RGBA);
+               stageStart = finishStage(context, MILKY_STAGE_CHASERS, stageStart);
 
-               if (bitDepth < 32) {
-                   reduceBitDepth(frame, frameSize, bitDepth);
+               if (bitDepth < 32 && context->ditherMode == MILKY_DITHER_DIFFUSION) {
+                   diffuseBitDepth(canvas, canvasWidthPx, canvasHeightPx, intensity ? 1 : 4, bitDepth);
+               } else if (bitDepth < 32) {
+                   prepareDither(&context->dither, bitDepth, context->ditherMode == MILKY_DITHER_ORDERED);
+                   runRowBands(&context->workers, intensity ? bitDepthPlaneRows : bitDepthRows, &stage, canvasHeightPx);
                }
+               stageStart = finishStage(context, MILKY_STAGE_BIT_DEPTH, stageStart);
      
-               // Rotate and scale effects with NEON-optimized copy
-               // TODO: this could be done in a Metal shader
-               rotate(timeFrame, milky_videoTempBuffer, frame, 0.02 * currentTime, 0.85, canvasWidthPx, canvasHeightPx);
-               scale(frame, milky_videoTempBuffer, 1.35f, canvasWidthPx, canvasHeightPx);
-     
-               // Copy the final frame to the previous frame buffer
-               #ifdef __ARM_NEON__
-               size_t j = 0;
-               for (; j + 16 <= frameSize; j += 16) {
-                   vst1q_u8(&milky_videoPrevFrame[j], vld1q_u8(&frame[j]));
-               }
-               for (; j < frameSize; j++) {
-                   milky_videoPrevFrame[j] = frame[j];
+               // Evaluate the feedback motion on the coarse mesh; the preset moves its center and shapes it
+               MilkyMotionParams motion = {
+                   .zoom = preset->zoom,
+                   .theta = nextRotationTheta(&context->rotation),
+                   .centerX = preset->centerX,
+                   .centerY = preset->centerY,
+                   .magic = preset->magic,
+                   .shift = preset->shift,
+                   .damping = preset->damping,
+                   .time = motionTime(currentTime - context->startTime)
+               };
+               meshEvaluate(&context->warpMesh, &motion, canvasWidthPx, canvasHeightPx);
+               stageStart = finishStage(context, MILKY_STAGE_MOTION, stageStart);
+
+               // Warp, zoom and blend in one pass, straight into the previous frame buffer.
+               // The warp gathers from the whole canvas, so the overlays above must be complete.
+               runRowBands(&context->workers, intensity ? warpPlaneRows : warpRows, &stage, canvasHeightPx);
+               stageStart = finishStage(context, MILKY_STAGE_WARP, stageStart);
+
+               // Copy the warped frame back into the canvas for display; intensity planes
+               // are expanded to RGBA here, the only place the canvas is written in that mode
+               if (intensity) {
+                   buildDisplayLut(&context->palette, stage.displayLut, bitDepth);
+                   runRowBands(&context->workers, expandPlaneRows, &stage, canvasHeightPx);
+               } else {
+                   runRowBands(&context->workers, copyBackRows, &stage, canvasHeightPx);
                }
-               #else
-               memcpy(milky_videoPrevFrame, frame, frameSize);
-               #endif
+               finishStage(context, MILKY_STAGE_COPY_BACK, stageStart);
 
-               // Update frame size to match current frame
-               milky_videoPrevFrameSize = frameSize;
+               if (!context->profiler.disabled) {
+                   finishStage(context, MILKY_STAGE_FRAME, frameStart);
+                   finishProfilerFrame(&context->profiler);
+               }
            }
 
 
 /**
- * Reserves and updates memory dynamically for rendering based on canvas size.
+ * Renders one visual frame based on audio waveform and spectrum data.
+ *
+ * @param context         Render context created by `createRenderContext()`.
+ * @param frame           Canvas frame buffer (RGBA format).
+ * @param canvasWidthPx   Canvas width in pixels.
+ * @param canvasHeightPx  Canvas height in pixels.
+ * @param waveform        Waveform data array, 8-bit unsigned integers, 576 samples.
+ * @param spectrum        Spectrum data array.
+ * @param waveformLength  Length of the waveform data array.
+ * @param spectrumLength  Length of the spectrum data array.
+ * @param bitDepth        Bit depth of the rendering.
+ * @param preset          Compiled preset (see getPresetParams()), NULL for the defaults.
+ * @param speed           Speed factor for the rendering.
+ * @param currentTime     Current time in milliseconds.
+ * @param sampleRate      Waveform sample rate (samples per second)
+ */
+void render(MilkyRenderContext *context, uint8_t *frame, size_t canvasWidthPx, size_t canvasHeightPx,
+            const uint8_t *waveform, const uint8_t *spectrum, size_t waveformLength, size_t spectrumLength,
+            uint8_t bitDepth, const MilkyPresetParams *preset, float speed, size_t currentTime, size_t sampleRate) {
+    renderFrame(context, frame, canvasWidthPx, canvasHeightPx, waveform, spectrum, waveformLength, spectrumLength,
+                NULL, bitDepth, preset, speed, currentTime, sampleRate);
+}
+
+/**
+ * Renders one visual frame from a snapshot of audio features (see features.h), e.g. the one
+ * `acquireFeatures()` returns at the start of the frame. The snapshot is read in place and
+ * must not change during the call; its energy spike flag replaces the detection in `render()`.
  *
+ * @param context         Render context created by `createRenderContext()`.
+ * @param frame           Canvas frame buffer (RGBA format).
+ * @param canvasWidthPx   Canvas width in pixels.
+ * @param canvasHeightPx  Canvas height in pixels.
+ * @param features        The audio features of the frame.
+ * @param bitDepth        Bit depth of the rendering.
+ * @param preset          Compiled preset (see getPresetParams()), NULL for the defaults.
+ * @param speed           Speed factor for the rendering.
+ * @param currentTime     Current time in milliseconds.
+ * @param sampleRate      Waveform sample rate (samples per second)
+ */
+void renderAudioFeatures(MilkyRenderContext *context, uint8_t *frame, size_t canvasWidthPx, size_t canvasHeightPx,
+                         const MilkyAudioFeatures *features, uint8_t bitDepth, const MilkyPresetParams *preset,
+                         float speed, size_t currentTime, size_t sampleRate) {
+    renderFrame(context, frame, canvasWidthPx, canvasHeightPx, features->waveform, features->spectrum,
+                features->waveformLength, features->spectrumLength, features, bitDepth, preset, speed, currentTime, sampleRate);
+}
+
+/**
+ * Reserves and updates memory dynamically for rendering based on canvas size and feedback mode.
+ * The feedback buffers hold one byte per pixel in intensity mode and four in RGBA mode.
+ *
+ * @param context        Render context owning the buffers.
  * @param canvasWidthPx  Canvas width in pixels.
  * @param canvasHeightPx Canvas height in pixels.
  * @param frame          Frame buffer to be updated.
  * @param frameSize      Size of the frame buffer.
  */
-void reserveAndUpdateMemory(size_t canvasWidthPx, size_t canvasHeightPx, uint8_t *frame, size_t frameSize) {
-    // check if the canvas size has changed and reinitialize buffers if necessary
-    if (canvasWidthPx != milky_videoLastCanvasWidthPx || canvasHeightPx != milky_videoLastCanvasHeightPx) {
+void reserveAndUpdateMemory(MilkyRenderContext *context, size_t canvasWidthPx, size_t canvasHeightPx, uint8_t *frame, size_t frameSize) {
+    size_t bytesPerPixel = context->feedbackMode == MILKY_FEEDBACK_INTENSITY ? 1 : 4;
+    size_t bufferSize = canvasWidthPx * canvasHeightPx * bytesPerPixel;
+
+    // check if the canvas size or layout has changed and reinitialize buffers if necessary
+    if (canvasWidthPx != context->lastCanvasWidthPx || canvasHeightPx != context->lastCanvasHeightPx ||
+        context->feedbackMode != context->allocatedFeedbackMode || !context->prevFrame || !context->tempBuffer) {
         clearFrame(frame, frameSize);
-        if (milky_videoPrevFrame) {
-            free(milky_videoPrevFrame);
-        }
-        milky_videoPrevFrame = (uint8_t *)malloc(frameSize);
-        if (!milky_videoPrevFrame) {
-            fprintf(stderr, "Failed to allocate prevFrame buffer\n");
-            return;
-        }
-        milky_videoLastCanvasWidthPx = canvasWidthPx;
-        milky_videoLastCanvasHeightPx = canvasHeightPx;
 
-        // free and reallocate the temporary buffer if canvas size changes
-        if (milky_videoTempBuffer) {
-            free(milky_videoTempBuffer);
-        }
-        milky_videoTempBuffer = (uint8_t *)malloc(frameSize);
-        if (!milky_videoTempBuffer) {
-            fprintf(stderr, "Failed to allocate temporary buffer\n");
-            return;
-        }
-        milky_videoTempBufferSize = frameSize;
-    }
+        // a pure size change (e.g. by the resolution governor) keeps the feedback image, resampled
+        int carryOver = context->isLastFrameInitialized && context->prevFrame && context->tempBuffer &&
+                        context->feedbackMode == context->allocatedFeedbackMode;
+        uint8_t *oldFrame = context->prevFrame;
 
-    // allocate or reuse the prevFrame buffer
-    if (!milky_videoPrevFrame || milky_videoTempBufferSize < frameSize) {
-        if (milky_videoPrevFrame) {
-            free(milky_videoPrevFrame);
-        }
-        milky_videoPrevFrame = (uint8_t *)malloc(frameSize);
-        if (!milky_videoPrevFrame) {
-            fprintf(stderr, "Failed to allocate prevFrame buffer\n");
+        // free and reallocate the feedback buffers
+        if (!carryOver) free(context->prevFrame);
+        free(context->tempBuffer);
+        context->prevFrame = (uint8_t *)malloc(bufferSize);
+        context->tempBuffer = (uint8_t *)malloc(bufferSize);
+        if (!context->prevFrame || !context->tempBuffer) {
+            fprintf(stderr, "Failed to allocate feedback buffers\n");
+            if (carryOver) free(oldFrame);
+            free(context->prevFrame);
+            free(context->tempBuffer);
+            context->prevFrame = NULL;
+            context->tempBuffer = NULL;
+            context->isLastFrameInitialized = 0;
             return;
         }
-    }
 
-    // allocate or reuse the temporary buffer
-    if (!milky_videoTempBuffer || milky_videoTempBufferSize < frameSize) {
-        if (milky_videoTempBuffer) {
-            free(milky_videoTempBuffer);
-        }
-        milky_videoTempBuffer = (uint8_t *)malloc(frameSize);
-        if (!milky_videoTempBuffer) {
-            fprintf(stderr, "Failed to allocate temporary buffer\n");
-            return;
+        if (carryOver) {
+            resampleNearest(oldFrame, context->lastCanvasWidthPx, context->lastCanvasHeightPx,
+                            context->prevFrame, canvasWidthPx, canvasHeightPx, bytesPerPixel);
+            memset(context->tempBuffer, 0, bufferSize);
+            free(oldFrame);
         }
-        milky_videoTempBufferSize = frameSize;
+
+        context->lastCanvasWidthPx = canvasWidthPx;
+        context->lastCanvasHeightPx = canvasHeightPx;
+        context->allocatedFeedbackMode = context->feedbackMode;
+        context->tempBufferSize = bufferSize;
+        context->prevFrameSize = bufferSize;
+
+        // the new buffers start out cleared, unless the old image was carried over
+        context->isLastFrameInitialized = carryOver;
     }
 }
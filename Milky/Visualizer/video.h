@@ -14,13 +14,37 @@
 #include <arm_neon.h>
 #endif
 
+#include "profiler.h"
+#include "governor.h"
+#include "preset.h"
+#include "audio/features.h"
+
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// layout of the feedback buffers of the render pipeline
+typedef enum {
+    MILKY_FEEDBACK_RGBA = 0,      // four bytes per pixel throughout the pipeline
+    MILKY_FEEDBACK_INTENSITY = 1  // one 8-bit intensity plane, expanded to RGBA once per frame
+} MilkyFeedbackMode;
+
+// dithering of the bit depth reduction
+typedef enum {
+    MILKY_DITHER_ORDERED = 0,   // tiled 8x8 Bayer pattern, band-parallel
+    MILKY_DITHER_NONE = 1,      // round to the nearest level
+    MILKY_DITHER_DIFFUSION = 2  // Floyd-Steinberg error diffusion, serial (offline rendering)
+} MilkyDitherMode;
+
+// one independent visualizer instance, holding all of its state
+typedef struct MilkyRenderContext MilkyRenderContext;
+
+MilkyRenderContext *createRenderContext(void);
+void destroyRenderContext(MilkyRenderContext *context);
 
 void render(
+    MilkyRenderContext *context,    // Render context created by createRenderContext()
     uint8_t *frame,                 // Canvas frame buffer (RGBA format)
     size_t canvasWidthPx,           // Canvas width in pixels
     size_t canvasHeightPx,          // Canvas height in pixels
@@ -29,17 +53,47 @@ void render(
     size_t waveformLength,          // Length of the waveform data array
     size_t spectrumLength,          // Length of the spectrum data array
     uint8_t bitDepth,               // Bit depth of the rendering
-    float *presetsBuffer,           // Preset data
+    const MilkyPresetParams *preset, // Compiled preset (see getPresetParams()), NULL for the defaults
     float speed,                    // Speed factor for the rendering
     size_t currentTime,             // Current time in milliseconds,
     size_t sampleRate               // Waveform sample rate (samples per second)
 );
 
+// renders from a feature snapshot, read in place (see features.h)
+void renderAudioFeatures(
+    MilkyRenderContext *context,        // Render context created by createRenderContext()
+    uint8_t *frame,                     // Canvas frame buffer (RGBA format)
+    size_t canvasWidthPx,               // Canvas width in pixels
+    size_t canvasHeightPx,              // Canvas height in pixels
+    const MilkyAudioFeatures *features, // Waveform, spectrum and energy spike flag of the frame
+    uint8_t bitDepth,                   // Bit depth of the rendering
+    const MilkyPresetParams *preset,    // Compiled preset (see getPresetParams()), NULL for the defaults
+    float speed,                        // Speed factor for the rendering
+    size_t currentTime,                 // Current time in milliseconds
+    size_t sampleRate                   // Waveform sample rate (samples per second)
+);
+
+// number of threads the render pipeline is split across (0 = one per online core)
+void setRenderThreadCount(MilkyRenderContext *context, size_t threadCount);
+size_t getRenderThreadCount(const MilkyRenderContext *context);
+
+void setFeedbackMode(MilkyRenderContext *context, MilkyFeedbackMode mode);
+void setDitherMode(MilkyRenderContext *context, MilkyDitherMode mode);
+
+// seeds the random streams of a context; equal seeds render equal frames from equal input
+void setRenderSeed(MilkyRenderContext *context, uint64_t seed);
+
+// scales a rendered RGBA frame to the output size (bilinear, band-parallel)
+void upscaleFrame(MilkyRenderContext *context, const uint8_t *src, size_t srcWidth, size_t srcHeight, uint8_t *dst, size_t dstWidth, size_t dstHeight);
+
+// per-stage frame time percentiles over the last frames (on by default)
+void setRenderProfiling(MilkyRenderContext *context, int enabled);
+size_t getRenderStageTimings(const MilkyRenderContext *context, MilkyStageTiming *timings, size_t maxStages);
+
 #ifdef __cplusplus
 }
 #endif
 
-void reserveAndUpdateMemory(size_t canvasWidthPx, size_t canvasHeightPx,  uint8_t *frame, size_t frameSize);
-void updateAudioData(const uint8_t *waveform, const uint8_t *spectrum, size_t waveformLength, size_t spectrumLength);
+void reserveAndUpdateMemory(MilkyRenderContext *context, size_t canvasWidthPx, size_t canvasHeightPx,  uint8_t *frame, size_t frameSize);
 
 #endif // VIDEO_H
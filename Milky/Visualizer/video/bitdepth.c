@@ -1,86 +1,205 @@
 #include "bitdepth.h"
 
+/*
+ Bit depth reduction.
+
+ Every channel is reduced to the levels of the target depth (32 for 16-bit, 8 for 8-bit
+ rendering). Plain rounding bands smooth gradients, so the default path adds a tiled 8x8
+ Bayer threshold to each value before it is truncated to a level (ordered dithering):
+
+   out = lut[min(value + bias[y % 8][x % 8], 255)]
+
+ The bias is below one quantization step and averages to half a step, so flat areas keep
+ their mean brightness while the pattern breaks up the bands. Both the table and the
+ per-row bias patterns are built once per bit depth; applying them is a saturating add and
+ a table lookup, which the kernel sets vectorize.
+
+ For offline renders, where a serial pass per frame is affordable, diffuseBitDepth()
+ implements true Floyd-Steinberg error diffusion instead.
+*/
+
+// 8x8 Bayer threshold matrix, values 0..63
+static const uint8_t milky_bayer[MILKY_DITHER_SIZE][MILKY_DITHER_SIZE] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+/**
+ * Returns the highest level per channel of a bit depth: 16-bit color keeps 5 bits per
+ * channel, 8-bit color 3 bits; 24 and 32 bits (and unsupported depths) are not reduced.
+ */
+static int levelsOf(uint8_t bitDepth) {
+    switch (bitDepth) {
+        case 16: return 31;
+        case 8: return 7;
+        default: return 255;
+    }
+}
+
 /**
- * Quantizes a color value using the PNUQ (Perceptually Non-Uniform Quantization) method.
- * Therefore, reduces the color depth of a given color value based on the specified bit depth.
- * It supports common bit depths such as 24, 16, and 8 bits, and defaults to no quantization for unsupported bit depths.
+ * Maps a level back to the full 0..255 range.
+ */
+static uint8_t levelValue(int level, int levels) {
+    return (uint8_t)((level * 255 + levels / 2) / levels);
+}
+
+/**
+ * Quantizes a channel value to the nearest level of a bit depth, without dithering.
  *
- * @param color    The original color value to be quantized (0-255).
- * @param bitDepth The target bit depth for quantization (e.g., 24, 16, 8).
- * @return         The quantized color value adjusted to the specified bit depth.
+ * @param value    The channel value (0-255).
+ * @param bitDepth The target bit depth (e.g., 24, 16, 8).
+ * @return         The quantized channel value.
  */
-uint8_t quantize_pnuq(uint8_t color, uint8_t bitDepth) {
-  // determine the number of quantization levels based on the bit depth
-  uint8_t levels;
-  switch (bitDepth) {
-      case 24:
-          levels = 255;  // 24-bit color uses full 8-bit per channel, no reduction
-          break;
-      case 16:
-          levels = 31;   // 16-bit color typically uses 5 bits for red/blue, 6 for green
-          break;
-      case 8:
-          levels = 7;    // 8-bit color uses 3 bits per channel
-          break;
-      default:
-          levels = 255;  // unsupported bit depths default to no quantization
-  }
-
-  // perform quantization by scaling the color to the reduced level and back to 0-255
-  uint8_t quantized = (color * levels / 255) * (255 / levels);
-  return quantized;
+uint8_t quantizeChannel(uint8_t value, uint8_t bitDepth) {
+    int levels = levelsOf(bitDepth);
+    return levelValue((value * levels + 127) / 255, levels);
 }
 
 /**
- * Reduces the bit depth of an RGBA frame.
- * Iterates over each pixel in the frame and quantizes the red, green, and blue channels
- * using the Perceptually Non-Uniform Quantization (PNUQ) method. It then applies dithering to the quantized
- * colors to reduce banding effects.
+ * Builds the quantization table and the ordered dither patterns of a bit depth.
+ * Does nothing if the tables are already built for it.
  *
- * @param frame     The frame buffer containing the RGBA pixel data.
- * @param frameSize The size of the frame buffer in bytes.
- * @param bitDepth  The target bit depth for quantization (e.g., 24, 16, 8).
+ * @param dither   The tables to build.
+ * @param bitDepth The target bit depth (e.g., 24, 16, 8).
+ * @param ordered  Non-zero for ordered dithering, 0 to round to the nearest level.
  */
-void reduceBitDepth(uint8_t *frame, size_t frameSize, uint8_t bitDepth) {
-  // iterate over each pixel in the frame
-  for (size_t i = 0; i < frameSize; i += 4) {
-      // quantize the red, green, and blue channels using PNUQ
-      uint8_t r = quantize_pnuq(frame[i], bitDepth);
-      uint8_t g = quantize_pnuq(frame[i + 1], bitDepth);
-      uint8_t b = quantize_pnuq(frame[i + 2], bitDepth);
-
-      // apply dithering to the quantized colors to reduce banding
-      r = dither(r, frame[i]);
-      g = dither(g, frame[i + 1]);
-      b = dither(b, frame[i + 2]);
-
-      // store the quantized and dithered values back into the frame
-      frame[i] = r;
-      frame[i + 1] = g;
-      frame[i + 2] = b;
-  }
+void prepareDither(MilkyDither *dither, uint8_t bitDepth, int ordered) {
+    if (dither->bitDepth == bitDepth && dither->ordered == ordered) return;
+    int levels = levelsOf(bitDepth);
+
+    // truncate to the level below, the bias decides whether a value rounds up
+    for (int value = 0; value < 256; value++) {
+        dither->lut[value] = levelValue(value * levels / 255, levels);
+    }
+
+    // thresholds spread evenly over one step, (t + 0.5) / 64 * 255 / levels, or all at half a step
+    for (int y = 0; y < MILKY_DITHER_SIZE; y++) {
+        for (int i = 0; i < 32; i++) {
+            int rgbThreshold = ordered ? milky_bayer[y][(i / 4) % MILKY_DITHER_SIZE] : 32;
+            int planeThreshold = ordered ? milky_bayer[y][i % MILKY_DITHER_SIZE] : 32;
+            dither->rgbBias[y][i] = (i & 3) == 3 ? 0 : (uint8_t)(((2 * rgbThreshold + 1) * 255) / (128 * levels));
+            dither->planeBias[y][i] = (uint8_t)(((2 * planeThreshold + 1) * 255) / (128 * levels));
+        }
+    }
+    dither->bitDepth = bitDepth;
+    dither->ordered = ordered;
 }
 
 /**
- * Applies dithering using the Floyd-Steinberg method.
- * Calculates the error between the original and quantized color, then adjusts the quantized
- * color by diffusing the error. The adjusted color is clamped to ensure it remains within the valid range.
+ * Reduces the bit depth of the rows [firstRow, lastRow) of an RGBA frame with ordered
+ * dithering. The alpha channel is kept.
  *
- * @param quantized_color The quantized color value.
- * @param original_color  The original color value before quantization.
- * @return                The dithered color value.
+ * @param dither   Tables built by prepareDither().
+ * @param frame    The frame buffer containing the RGBA pixel data.
+ * @param width    The width of the frame in pixels.
+ * @param firstRow The first row to reduce.
+ * @param lastRow  One past the last row to reduce.
  */
-uint8_t dither(uint8_t quantized_color, uint8_t original_color) {
-  // calculate the error between the original and quantized color
-  int16_t error = (int16_t)original_color - (int16_t)quantized_color;
+void ditherRows(const MilkyDither *dither, uint8_t *frame, size_t width, size_t firstRow, size_t lastRow) {
+    const MilkyKernels *kernels = getKernels();
+    for (size_t y = firstRow; y < lastRow; y++) {
+        uint8_t *row = frame + y * width * 4;
+        kernels->ditherRgb(row, row, width * 4, dither->rgbBias[y % MILKY_DITHER_SIZE], dither->lut);
+    }
+}
+
+/**
+ * Reduces the bit depth of the rows [firstRow, lastRow) of an 8-bit intensity plane, with
+ * the same quantization and dithering `ditherRows()` applies to each color channel.
+ *
+ * @param dither   Tables built by prepareDither().
+ * @param plane    The plane buffer, one byte per pixel.
+ * @param width    The width of the plane in pixels.
+ * @param firstRow The first row to reduce.
+ * @param lastRow  One past the last row to reduce.
+ */
+void ditherPlaneRows(const MilkyDither *dither, uint8_t *plane, size_t width, size_t firstRow, size_t lastRow) {
+    const MilkyKernels *kernels = getKernels();
+    for (size_t y = firstRow; y < lastRow; y++) {
+        uint8_t *row = plane + y * width;
+        kernels->ditherBytes(row, row, width, dither->planeBias[y % MILKY_DITHER_SIZE], dither->lut);
+    }
+}
+
+/**
+ * Reduces the bit depth of a whole RGBA frame with ordered dithering.
+ *
+ * @param frame    The frame buffer containing the RGBA pixel data.
+ * @param width    The width of the frame in pixels.
+ * @param height   The height of the frame in pixels.
+ * @param bitDepth The target bit depth (e.g., 24, 16, 8).
+ */
+void reduceBitDepth(uint8_t *frame, size_t width, size_t height, uint8_t bitDepth) {
+    MilkyDither dither = { 0 };
+    prepareDither(&dither, bitDepth, 1);
+    ditherRows(&dither, frame, width, 0, height);
+}
+
+/**
+ * Adds a share of a quantization error (in 1/16 units) to the value it diffuses into.
+ */
+static int applyError(int value, int error) {
+    int share = error >= 0 ? (error + 8) / 16 : -((-error + 8) / 16);
+    value += share;
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+/**
+ * Reduces the bit depth of a frame or intensity plane with Floyd-Steinberg error diffusion,
+ * in serpentine order. Every pixel depends on the ones before it, so this runs serially;
+ * it is meant for offline rendering. The alpha channel of RGBA frames is kept.
+ *
+ * @param pixels        The RGBA frame or the intensity plane.
+ * @param width         The width in pixels.
+ * @param height        The height in pixels.
+ * @param bytesPerPixel 4 for RGBA frames, 1 for intensity planes.
+ * @param bitDepth      The target bit depth (e.g., 24, 16, 8).
+ */
+void diffuseBitDepth(uint8_t *pixels, size_t width, size_t height, size_t bytesPerPixel, uint8_t bitDepth) {
+    if (levelsOf(bitDepth) >= 255) return;
+
+    // one error row per channel for the current and the next image row, padded by a pixel on each side
+    const size_t channels = bytesPerPixel == 4 ? 3 : 1;
+    const size_t rowValues = (width + 2) * channels;
+    int16_t *errors = (int16_t *)calloc(2 * rowValues, sizeof(int16_t));
+    if (!errors) {
+        fprintf(stderr, "Failed to allocate error diffusion rows\n");
+        return;
+    }
+
+    for (size_t y = 0; y < height; y++) {
+        int16_t *current = errors + (y & 1) * rowValues;
+        int16_t *next = errors + ((y + 1) & 1) * rowValues;
+        memset(next, 0, rowValues * sizeof(int16_t));
+
+        int leftToRight = (y & 1) == 0;
+        ptrdiff_t step = leftToRight ? (ptrdiff_t)channels : -(ptrdiff_t)channels;
+        uint8_t *row = pixels + y * width * bytesPerPixel;
+
+        for (size_t i = 0; i < width; i++) {
+            size_t x = leftToRight ? i : width - 1 - i;
+            for (size_t c = 0; c < channels; c++) {
+                size_t e = (x + 1) * channels + c;
+                uint8_t *p = row + x * bytesPerPixel + c;
 
-  // adjust the quantized color by diffusing the error
-  int16_t adjusted_color = quantized_color + (error * 7 / 16);
+                int value = applyError(*p, current[e]);
+                uint8_t quantized = quantizeChannel((uint8_t)value, bitDepth);
+                int error = value - quantized;
+                *p = quantized;
 
-  // clamp the adjusted color to ensure it remains within the valid range
-  if (adjusted_color > 255) adjusted_color = 255;
-  if (adjusted_color < 0) adjusted_color = 0;
+                current[e + step] += (int16_t)(error * 7);
+                next[e - step] += (int16_t)(error * 3);
+                next[e] += (int16_t)(error * 5);
+                next[e + step] += (int16_t)error;
+            }
+        }
+    }
 
-  // return the adjusted color as a uint8_t
-  return (uint8_t)adjusted_color;
+    free(errors);
 }
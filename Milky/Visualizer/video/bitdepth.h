@@ -4,10 +4,28 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
-uint8_t quantize_pnuq(uint8_t color, uint8_t bitDepth);
-void reduceBitDepth(uint8_t *frame, size_t frameSize, uint8_t bitDepth);
-uint8_t dither(uint8_t quantized_color, uint8_t original_color);
+#include "kernels.h"
+
+// side of the tiled ordered dither (Bayer) threshold matrix
+#define MILKY_DITHER_SIZE 8
+
+// quantization and ordered dither tables of one bit depth, see prepareDither()
+typedef struct {
+    uint8_t bitDepth;  // depth the tables are built for, 0 = not built yet
+    int ordered;       // whether the bias is the Bayer pattern or a constant half step (plain rounding)
+    uint8_t lut[256];  // biased channel value -> quantized value
+    uint8_t rgbBias[MILKY_DITHER_SIZE][32];   // per matrix row: thresholds of 8 RGBA pixels, alpha 0
+    uint8_t planeBias[MILKY_DITHER_SIZE][32]; // per matrix row: thresholds of 32 intensity pixels
+} MilkyDither;
+
+uint8_t quantizeChannel(uint8_t value, uint8_t bitDepth);
+void prepareDither(MilkyDither *dither, uint8_t bitDepth, int ordered);
+void ditherRows(const MilkyDither *dither, uint8_t *frame, size_t width, size_t firstRow, size_t lastRow);
+void ditherPlaneRows(const MilkyDither *dither, uint8_t *plane, size_t width, size_t firstRow, size_t lastRow);
+void reduceBitDepth(uint8_t *frame, size_t width, size_t height, uint8_t bitDepth);
+void diffuseBitDepth(uint8_t *pixels, size_t width, size_t height, size_t bytesPerPixel, uint8_t bitDepth);
 
 #endif // BITDEPTH_H
@@ -0,0 +1,214 @@
+#include "blend.h"
+
+/*
+ Span blending.
+
+ Overlays are drawn as runs of pixels rather than one call per pixel: a run is clipped to
+ the frame once, and the blend mode is picked once, so the inner loops only do integer math
+ on the pixels they touch. Colors are premultiplied RGBA (see premultiplyColor()), which
+ turns "over" into a single multiply-add per channel:
+
+   out = src + dst * (255 - srcAlpha) / 255
+
+ RGBA buffers are treated as premultiplied as well. Intensity buffers hold the red channel
+ of opaque pixels, so the same equations apply to that one channel.
+*/
+
+/**
+ * Blends a premultiplied color "over" a horizontal run of RGBA pixels, scaled by the
+ * coverage per pixel, four pixels at a time, and returns how many pixels it blended (a
+ * multiple of four). Every pixel is blended without a branch: an uncovered one by a zero
+ * color, which leaves it as it is, and a fully covered one by the whole color. The
+ * products are rounded like scalePixel(), and the color is added with the same carries
+ * as the scalar loop, so both give the same pixels.
+ */
+static size_t blendOverMask(uint32_t *p, const uint8_t *coverage, size_t count, uint32_t color) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(0x80);
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i channels = _mm_unpacklo_epi8(_mm_set1_epi32((int32_t)color), zero);
+    for (; i + 4 <= count; i += 4) {
+        int32_t covered;
+        memcpy(&covered, coverage + i, sizeof(covered));
+        __m128i factors = _mm_unpacklo_epi8(_mm_cvtsi32_si128(covered), zero);
+        factors = _mm_unpacklo_epi16(factors, factors);
+
+        // the color scaled by the coverage of pixels 0, 1 and 2, 3
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(channels, _mm_unpacklo_epi32(factors, factors)), round);
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(channels, _mm_unpackhi_epi32(factors, factors)), round);
+        low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+        // the pixels scaled by the inverse alpha of their color
+        __m128i inverseLow = _mm_sub_epi16(full, _mm_shufflehi_epi16(_mm_shufflelo_epi16(low, 0xFF), 0xFF));
+        __m128i inverseHigh = _mm_sub_epi16(full, _mm_shufflehi_epi16(_mm_shufflelo_epi16(high, 0xFF), 0xFF));
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i pixelsLow = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), inverseLow), round);
+        __m128i pixelsHigh = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), inverseHigh), round);
+        pixelsLow = _mm_srli_epi16(_mm_add_epi16(pixelsLow, _mm_srli_epi16(pixelsLow, 8)), 8);
+        pixelsHigh = _mm_srli_epi16(_mm_add_epi16(pixelsHigh, _mm_srli_epi16(pixelsHigh, 8)), 8);
+
+        __m128i blended = _mm_add_epi32(_mm_packus_epi16(low, high), _mm_packus_epi16(pixelsLow, pixelsHigh));
+        _mm_storeu_si128((__m128i *)(p + i), blended);
+    }
+#elif defined(__ARM_NEON__) && defined(__aarch64__)
+    const uint8x16_t channels = vreinterpretq_u8_u32(vdupq_n_u32(color));
+    const uint8x16_t alphaLanes = { 3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15 };
+    const uint8x16_t pixelLanes = { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3 };
+    for (; i + 4 <= count; i += 4) {
+        uint32_t covered;
+        memcpy(&covered, coverage + i, sizeof(covered));
+        uint8x16_t factors = vqtbl1q_u8(vreinterpretq_u8_u32(vdupq_n_u32(covered)), pixelLanes);
+
+        // (x + 128 + ((x + 128) >> 8)) >> 8, the rounding of scalePixel()
+        uint16x8_t low = vmull_u8(vget_low_u8(channels), vget_low_u8(factors));
+        uint16x8_t high = vmull_u8(vget_high_u8(channels), vget_high_u8(factors));
+        uint8x16_t scaled = vcombine_u8(vraddhn_u16(low, vrshrq_n_u16(low, 8)), vraddhn_u16(high, vrshrq_n_u16(high, 8)));
+
+        uint8x16_t inverse = vmvnq_u8(vqtbl1q_u8(scaled, alphaLanes));
+        uint8x16_t pixels = vreinterpretq_u8_u32(vld1q_u32(p + i));
+        low = vmull_u8(vget_low_u8(pixels), vget_low_u8(inverse));
+        high = vmull_u8(vget_high_u8(pixels), vget_high_u8(inverse));
+        pixels = vcombine_u8(vraddhn_u16(low, vrshrq_n_u16(low, 8)), vraddhn_u16(high, vrshrq_n_u16(high, 8)));
+
+        vst1q_u32(p + i, vaddq_u32(vreinterpretq_u32_u8(scaled), vreinterpretq_u32_u8(pixels)));
+    }
+#else
+    (void)p;
+    (void)coverage;
+    (void)count;
+    (void)color;
+#endif
+    return i;
+}
+
+/**
+ * Blends a run of pixels, going right (vertical = 0) or down (vertical = 1) from (x, y).
+ * The run is clipped to the frame; `coverage` (optional) scales the color per pixel.
+ */
+static void blendRun(uint8_t *frame, size_t width, size_t height, int x, int y, int vertical,
+                     const uint8_t *coverage, int length, uint32_t color, MilkyBlendMode mode) {
+    int along = vertical ? y : x;
+    int across = vertical ? x : y;
+    int limit = (int)(vertical ? height : width);
+    int acrossLimit = (int)(vertical ? width : height);
+    if (across < 0 || across >= acrossLimit) return;
+
+    int first = along < 0 ? -along : 0;
+    int last = along + length > limit ? limit - along : length;
+    if (first >= last) return;
+
+    size_t stride = vertical ? width : 1;
+    size_t index = vertical ? (size_t)(along + first) * width + (size_t)x : (size_t)y * width + (size_t)(along + first);
+    size_t count = (size_t)(last - first);
+    if (coverage) coverage += first;
+
+    // masks of strokes are mostly empty or full: uncovered pixels are skipped, and fully
+    // covered ones take the color as is
+    if (getDrawPixelFormat() == MILKY_PIXEL_FORMAT_INTENSITY) {
+        uint8_t *p = frame + index;
+        for (size_t i = 0; i < count; i++, p += stride) {
+            if (coverage && coverage[i] == 0) continue;
+            *p = blendIntensity(*p, coverage && coverage[i] != 255 ? scalePixel(color, coverage[i]) : color, mode);
+        }
+        return;
+    }
+
+    uint32_t *p = (uint32_t *)frame + index;
+    if (coverage) {
+        size_t i = mode == MILKY_BLEND_OVER && !vertical ? blendOverMask(p, coverage, count, color) : 0;
+        for (p += i * stride; i < count; i++, p += stride) {
+            if (coverage[i] == 0) continue;
+            *p = blendPixel(*p, coverage[i] == 255 ? color : scalePixel(color, coverage[i]), mode);
+        }
+        return;
+    }
+
+    // constant color: an opaque "over" is a plain fill, otherwise pick the loop once
+    switch (mode) {
+        case MILKY_BLEND_ADD:
+            for (size_t i = 0; i < count; i++, p += stride) *p = addPixel(*p, color);
+            break;
+        case MILKY_BLEND_MAX:
+            for (size_t i = 0; i < count; i++, p += stride) *p = maxPixel(*p, color);
+            break;
+        default:
+            if ((color >> 24) == 255) {
+                for (size_t i = 0; i < count; i++, p += stride) *p = color;
+            } else {
+                uint32_t inverse = 255 - (color >> 24);
+                for (size_t i = 0; i < count; i++, p += stride) *p = color + scalePixel(*p, inverse);
+            }
+            break;
+    }
+}
+
+/**
+ * Blends a constant color over a horizontal run of pixels, clipped to the frame.
+ *
+ * @param frame  The frame buffer, in the current draw pixel format.
+ * @param width  The width of the frame in pixels.
+ * @param height The height of the frame in pixels.
+ * @param x      The x-coordinate of the first pixel.
+ * @param y      The y-coordinate of the run.
+ * @param length The number of pixels to the right, including the first.
+ * @param color  The premultiplied color (see premultiplyColor()).
+ * @param mode   How the color combines with the frame.
+ */
+void blendSpan(uint8_t *frame, size_t width, size_t height, int x, int y, int length, uint32_t color, MilkyBlendMode mode) {
+    blendRun(frame, width, height, x, y, 0, NULL, length, color, mode);
+}
+
+/**
+ * Blends a constant color over a vertical run of pixels, clipped to the frame.
+ *
+ * @param frame  The frame buffer, in the current draw pixel format.
+ * @param width  The width of the frame in pixels.
+ * @param height The height of the frame in pixels.
+ * @param x      The x-coordinate of the run.
+ * @param y      The y-coordinate of the first pixel.
+ * @param length The number of pixels downwards, including the first.
+ * @param color  The premultiplied color (see premultiplyColor()).
+ * @param mode   How the color combines with the frame.
+ */
+void blendColumn(uint8_t *frame, size_t width, size_t height, int x, int y, int length, uint32_t color, MilkyBlendMode mode) {
+    blendRun(frame, width, height, x, y, 1, NULL, length, color, mode);
+}
+
+/**
+ * Blends a color through a coverage mask over a horizontal run of pixels, clipped to the
+ * frame. Pixel i receives the color scaled by coverage[i] / 255, e.g. from an anti-aliased edge.
+ *
+ * @param frame    The frame buffer, in the current draw pixel format.
+ * @param width    The width of the frame in pixels.
+ * @param height   The height of the frame in pixels.
+ * @param x        The x-coordinate of the first pixel.
+ * @param y        The y-coordinate of the run.
+ * @param coverage One coverage value (0-255) per pixel of the run.
+ * @param length   The number of pixels to the right, including the first.
+ * @param color    The premultiplied color (see premultiplyColor()).
+ * @param mode     How the color combines with the frame.
+ */
+void blendMask(uint8_t *frame, size_t width, size_t height, int x, int y, const uint8_t *coverage, int length, uint32_t color, MilkyBlendMode mode) {
+    blendRun(frame, width, height, x, y, 0, coverage, length, color, mode);
+}
+
+/**
+ * Blends a color through a coverage mask over a vertical run of pixels; the column
+ * counterpart of `blendMask()`.
+ *
+ * @param frame    The frame buffer, in the current draw pixel format.
+ * @param width    The width of the frame in pixels.
+ * @param height   The height of the frame in pixels.
+ * @param x        The x-coordinate of the run.
+ * @param y        The y-coordinate of the first pixel.
+ * @param coverage One coverage value (0-255) per pixel of the run.
+ * @param length   The number of pixels downwards, including the first.
+ * @param color    The premultiplied color (see premultiplyColor()).
+ * @param mode     How the color combines with the frame.
+ */
+void blendColumnMask(uint8_t *frame, size_t width, size_t height, int x, int y, const uint8_t *coverage, int length, uint32_t color, MilkyBlendMode mode) {
+    blendRun(frame, width, height, x, y, 1, coverage, length, color, mode);
+}
@@ -0,0 +1,125 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "draw.h"
+
+// how a drawn color combines with the pixels below it
+typedef enum {
+    MILKY_BLEND_OVER = 0, // source over destination (Porter-Duff)
+    MILKY_BLEND_ADD = 1,  // source added to the destination, saturating at 255
+    MILKY_BLEND_MAX = 2   // per-channel maximum of source and destination
+} MilkyBlendMode;
+
+/**
+ * Scales all four channels of a packed pixel by f / 255, rounded to nearest, two channels
+ * at a time (SWAR). Each channel is widened into a 16-bit lane, so 255 * 255 never overflows.
+ *
+ * @param p The packed pixel.
+ * @param f The factor in 1/255 steps (0..255).
+ * @return  The scaled pixel.
+ */
+static inline uint32_t scalePixel(uint32_t p, uint32_t f) {
+    uint32_t rb = (p & 0x00FF00FFu) * f + 0x00800080u;
+    uint32_t ga = ((p >> 8) & 0x00FF00FFu) * f + 0x00800080u;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FFu)) >> 8) & 0x00FF00FFu;
+    ga = (ga + ((ga >> 8) & 0x00FF00FFu)) & 0xFF00FF00u;
+    return rb | ga;
+}
+
+/**
+ * Packs a straight-alpha color into a premultiplied RGBA pixel, the form all blend
+ * functions take their color in.
+ *
+ * @param r The red component.
+ * @param g The green component.
+ * @param b The blue component.
+ * @param a The alpha component.
+ * @return  The premultiplied pixel.
+ */
+static inline uint32_t premultiplyColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    return scalePixel(((uint32_t)255 << 24) | ((uint32_t)b << 16) | ((uint32_t)g << 8) | r, a);
+}
+
+/**
+ * Divides a product of two 8-bit values by 255, rounded to nearest.
+ */
+static inline uint32_t div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+/**
+ * Adds two packed pixels channel by channel, saturating at 255 (SWAR).
+ */
+static inline uint32_t addPixel(uint32_t a, uint32_t b) {
+    uint32_t rb = (a & 0x00FF00FFu) + (b & 0x00FF00FFu);
+    uint32_t ga = ((a >> 8) & 0x00FF00FFu) + ((b >> 8) & 0x00FF00FFu);
+    rb |= ((rb >> 8) & 0x00010001u) * 0xFF;
+    ga |= ((ga >> 8) & 0x00010001u) * 0xFF;
+    return (rb & 0x00FF00FFu) | ((ga & 0x00FF00FFu) << 8);
+}
+
+/**
+ * Returns the channel-wise maximum of two packed pixels.
+ */
+static inline uint32_t maxPixel(uint32_t a, uint32_t b) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t ca = (a >> shift) & 0xFF;
+        uint32_t cb = (b >> shift) & 0xFF;
+        result |= (ca > cb ? ca : cb) << shift;
+    }
+    return result;
+}
+
+/**
+ * Blends one premultiplied pixel onto another.
+ *
+ * @param dst  The destination pixel.
+ * @param src  The premultiplied source pixel.
+ * @param mode How the source combines with the destination.
+ * @return     The blended pixel.
+ */
+static inline uint32_t blendPixel(uint32_t dst, uint32_t src, MilkyBlendMode mode) {
+    switch (mode) {
+        case MILKY_BLEND_ADD: return addPixel(dst, src);
+        case MILKY_BLEND_MAX: return maxPixel(dst, src);
+        default: return src + scalePixel(dst, 255 - (src >> 24));
+    }
+}
+
+/**
+ * Blends one premultiplied pixel onto an opaque intensity; the single-channel counterpart
+ * of `blendPixel()`.
+ *
+ * @param dst  The destination intensity.
+ * @param src  The premultiplied source pixel; its red channel is blended.
+ * @param mode How the source combines with the destination.
+ * @return     The blended intensity.
+ */
+static inline uint8_t blendIntensity(uint8_t dst, uint32_t src, MilkyBlendMode mode) {
+    uint32_t value = src & 0xFF;
+    switch (mode) {
+        case MILKY_BLEND_ADD: value += dst; return (uint8_t)(value > 255 ? 255 : value);
+        case MILKY_BLEND_MAX: return value > dst ? (uint8_t)value : dst;
+        default: return (uint8_t)(value + div255(dst * (255 - (src >> 24))));
+    }
+}
+
+void blendSpan(uint8_t *frame, size_t width, size_t height, int x, int y, int length, uint32_t color, MilkyBlendMode mode);
+void blendColumn(uint8_t *frame, size_t width, size_t height, int x, int y, int length, uint32_t color, MilkyBlendMode mode);
+void blendMask(uint8_t *frame, size_t width, size_t height, int x, int y, const uint8_t *coverage, int length, uint32_t color, MilkyBlendMode mode);
+void blendColumnMask(uint8_t *frame, size_t width, size_t height, int x, int y, const uint8_t *coverage, int length, uint32_t color, MilkyBlendMode mode);
+
+#endif // BLEND_H
@@ -131,20 +131,86 @@ void boxBlurAndPerspective2(
  * @param frameSize The total size of the frame buffer in bytes.
  */
 void blurFrame(uint8_t *prevFrame, size_t frameSize, size_t step, float factor) {
-    
-    for (size_t i = 0; i < frameSize; i += step) {
-        uint8_t *pixel = &prevFrame[i];
-        for (int channel = 0; channel < 3; channel++) {
-            pixel[channel] = (uint8_t)(pixel[channel] * factor);
+    blurFrameRange(prevFrame, frameSize, 0, frameSize, step, factor);
+}
+
+/**
+ * Builds a lookup table that fades a channel value `touches` times by `factor`,
+ * truncating after every step exactly like repeated `blurFrame()` passes do.
+ *
+ * @param lut     Receives 256 faded values.
+ * @param touches The number of fade steps.
+ * @param factor  The fade factor applied per step.
+ */
+void buildFadeLut(uint8_t *lut, size_t touches, float factor) {
+    for (int value = 0; value < 256; value++) {
+        uint8_t faded = (uint8_t)value;
+        for (size_t t = 0; t < touches; t++) {
+            faded = (uint8_t)(faded * factor);
         }
+        lut[value] = faded;
     }
 }
 
-void preserveMassFade(uint8_t *prevFrame, uint8_t *frame, size_t frameSize) {
-    for (size_t i = 0; i < frameSize; i += 4) {
-        for (int channel = 0; channel < 3; channel++) {  // Only apply to RGB channels
-            uint8_t prevValue = prevFrame[i + channel];
-            frame[i + channel] = (prevValue + (uint8_t)(prevValue * 85)) >> 1;
+/**
+ * Applies the fade of `blurFrame()` to the bytes [first, last) of the frame only.
+ * Every byte is faded as often as the strided walk of `blurFrame()` touches it, so
+ * fading a frame in disjoint ranges (e.g. on several threads) gives the same result
+ * as fading it as a whole. Bytes beyond `frameSize` are never touched.
+ *
+ * @param prevFrame A pointer to the frame buffer containing pixel data in RGBA format.
+ * @param frameSize The total size of the frame buffer in bytes.
+ * @param first     The first byte to fade.
+ * @param last      One past the last byte to fade.
+ * @param step      The stride of the walk, in bytes.
+ * @param factor    The fade factor applied per touch.
+ */
+void blurFrameRange(uint8_t *prevFrame, size_t frameSize, size_t first, size_t last, size_t step, float factor) {
+    if (step == 0) return;
+    if (last > frameSize) last = frameSize;
+
+    // a walk position i fades the bytes i..i+2, so a byte is faded up to three times
+    uint8_t fade[4][256];
+    for (size_t count = 0; count < 4; count++) {
+        buildFadeLut(fade[count], count, factor);
+    }
+
+    // touches per byte, depending on its offset within the stride
+    uint8_t touches[3] = { 0, 0, 0 };
+    for (size_t k = 0; k < 3; k++) {
+        touches[k % step]++;
+    }
+
+    size_t b = first;
+
+    // the first two bytes have no walk positions before them
+    for (; b < last && b < 2; b++) {
+        uint8_t count = 0;
+        for (size_t k = 0; k <= b; k++) {
+            if ((b - k) % step == 0) count++;
+        }
+        prevFrame[b] = fade[count][prevFrame[b]];
+    }
+
+    if (b >= last) return;
+
+    // with a stride of two, even and odd bytes alternate between two fades
+    if (step == 2) {
+        if (b & 1) {
+            prevFrame[b] = fade[touches[1]][prevFrame[b]];
+            b++;
         }
+        getKernels()->mapBytesAlternating(prevFrame + b, last - b, fade[touches[0]], fade[touches[1]]);
+        return;
+    }
+
+    size_t phase = b % step;
+    for (; b < last; b++) {
+        prevFrame[b] = fade[phase < 3 ? touches[phase] : 0][prevFrame[b]];
+        if (++phase == step) phase = 0;
     }
 }
+
+void preserveMassFade(uint8_t *prevFrame, uint8_t *frame, size_t frameSize) {
+    getKernels()->massFade(prevFrame, frame, frameSize);
+}
@@ -6,11 +6,15 @@
 #include <stdio.h>
 #include <math.h>
 
+#include "kernels.h"
+
 #ifdef __ARM_NEON__
 #include <arm_neon.h>
 #endif
 
 void blurFrame(uint8_t *prevFrame, size_t frameSize, size_t step, float factor);
+void blurFrameRange(uint8_t *prevFrame, size_t frameSize, size_t first, size_t last, size_t step, float factor);
+void buildFadeLut(uint8_t *lut, size_t touches, float factor);
 void preserveMassFade(uint8_t *prevFrame, uint8_t *frame, size_t frameSize);
 
 #endif // BLUR_H
@@ -1,4 +1,30 @@
 #include "draw.h"
+#include "blend.h"
+#include "stroke.h"
+
+// layout of the buffers passed to setPixel(), getPixel() and drawLine(); overlays are drawn
+// serially on the thread rendering a context, so the setting is kept per thread
+static __thread MilkyPixelFormat milky_drawPixelFormat = MILKY_PIXEL_FORMAT_RGBA;
+
+/**
+ * Selects the memory layout the drawing primitives expect their buffers in.
+ * In MILKY_PIXEL_FORMAT_INTENSITY, only the red component of a color is stored and every
+ * pixel of the buffer is treated as fully opaque. The setting applies to the calling thread.
+ *
+ * @param format The pixel format of subsequently drawn-to buffers.
+ */
+void setDrawPixelFormat(MilkyPixelFormat format) {
+    milky_drawPixelFormat = format;
+}
+
+/**
+ * Returns the memory layout the drawing primitives of the calling thread expect.
+ *
+ * @return The pixel format set by setDrawPixelFormat().
+ */
+MilkyPixelFormat getDrawPixelFormat(void) {
+    return milky_drawPixelFormat;
+}
 
 /**
  * Clears the entire frame buffer by setting all pixels to black and fully transparent.
@@ -12,12 +38,11 @@ void clearFrame(uint8_t *frame, size_t frameSize) {
 }
 
 /**
- * Sets the RGBA values for a specific pixel in the frame buffer.
- * To do so, it modifies the color and transparency of a pixel located at
- * the specified (x, y) coordinates within the frame buffer. It ensures that
- * the pixel is within the bounds of the frame before setting the values.
+ * Blends a color over a specific pixel in the frame buffer, if it lies within the frame.
+ * Overlays drawing runs of pixels should blend whole spans with blendSpan() and friends,
+ * which clip and pick the pixel format once per run.
  *
- * @param frame  The frame buffer where the pixel is to be set (RGBA format).
+ * @param frame  The frame buffer where the pixel is to be set (premultiplied RGBA format).
  * @param width  The width of the frame in pixels.
  * @param x      The x-coordinate of the pixel to set.
  * @param y      The y-coordinate of the pixel to set.
@@ -30,48 +55,55 @@ void setPixel(uint8_t *frame, size_t canvasWidthPx, size_t canvasHeightPx,
               int x, int y, uint8_t srcR, uint8_t srcG, uint8_t srcB, uint8_t srcA) {
     if (x < 0 || x >= (int)canvasWidthPx || y < 0 || y >= (int)canvasHeightPx) return;
 
-    size_t index = (y * canvasWidthPx + x) * 4; // Assuming RGBA format
-
-    // Existing pixel values
-    uint8_t dstR = frame[index];
-    uint8_t dstG = frame[index + 1];
-    uint8_t dstB = frame[index + 2];
-    uint8_t dstA = frame[index + 3];
-
-    // Convert alpha values to floats in range [0,1]
-    float srcAlpha = srcA / 255.0f;
-    float dstAlpha = dstA / 255.0f;
+    uint32_t color = premultiplyColor(srcR, srcG, srcB, srcA);
+    size_t index = (size_t)y * canvasWidthPx + (size_t)x;
+    if (milky_drawPixelFormat == MILKY_PIXEL_FORMAT_INTENSITY) {
+        frame[index] = blendIntensity(frame[index], color, MILKY_BLEND_OVER);
+    } else {
+        uint32_t *pixel = (uint32_t *)frame + index;
+        *pixel = blendPixel(*pixel, color, MILKY_BLEND_OVER);
+    }
+}
 
-    // Compute the output alpha
-    float outAlpha = srcAlpha + dstAlpha * (1.0f - srcAlpha);
+/**
+ * Reads the color of a pixel in the frame buffer, honouring the current pixel format.
+ * Intensity buffers report their value as an opaque grey.
+ *
+ * @param frame  The frame buffer to read from.
+ * @param width  The width of the frame in pixels.
+ * @param height The height of the frame in pixels.
+ * @param x      The x-coordinate of the pixel.
+ * @param y      The y-coordinate of the pixel.
+ * @param r      Receives the red component.
+ * @param g      Receives the green component.
+ * @param b      Receives the blue component.
+ * @param a      Receives the alpha component.
+ */
+void getPixel(const uint8_t *frame, size_t canvasWidthPx, size_t canvasHeightPx,
+              int x, int y, uint8_t *r, uint8_t *g, uint8_t *b, uint8_t *a) {
+    if (x < 0 || x >= (int)canvasWidthPx || y < 0 || y >= (int)canvasHeightPx) {
+        *r = *g = *b = *a = 0;
+        return;
+    }
 
-    // Avoid division by zero
-    if (outAlpha == 0.0f) {
-        frame[index]     = 0;
-        frame[index + 1] = 0;
-        frame[index + 2] = 0;
-        frame[index + 3] = 0;
+    if (milky_drawPixelFormat == MILKY_PIXEL_FORMAT_INTENSITY) {
+        *r = *g = *b = frame[y * canvasWidthPx + x];
+        *a = 255;
         return;
     }
 
-    // Blend the colors
-    frame[index]     = (uint8_t)(((srcR * srcAlpha) + (dstR * dstAlpha * (1.0f - srcAlpha))) / outAlpha);
-    frame[index + 1] = (uint8_t)(((srcG * srcAlpha) + (dstG * dstAlpha * (1.0f - srcAlpha))) / outAlpha);
-    frame[index + 2] = (uint8_t)(((srcB * srcAlpha) + (dstB * dstAlpha * (1.0f - srcAlpha))) / outAlpha);
-    frame[index + 3] = (uint8_t)(outAlpha * 255.0f);
+    size_t index = (y * canvasWidthPx + x) * 4;
+    *r = frame[index];
+    *g = frame[index + 1];
+    *b = frame[index + 2];
+    *a = frame[index + 3];
 }
 
 /**
- Optimized Bresenham's line algorithm.
- 
- Credits go to Jack Elton Bresenham who developed it in 1962 at IBM.
- https://en.wikipedia.org/wiki/Bresenham%27s_line_algorithm
-
- Draws a line on a screen buffer using the Bresenham's line algorithm.
- It calculates the line's path from (x0, y0) to (x1, y1) and sets the pixel intensity
- directly on the screen buffer. The algorithm is optimized for performance by avoiding
- function calls and using direct memory access. It also ensures that the line stays
- within the bounds of the screen canvas by clamping the coordinates.
+ Draws a one pixel wide anti-aliased line from the center of pixel (x0, y0) to the center
+ of pixel (x1, y1), blending the color over the screen ("over", premultiplied). The line is
+ a two-point polyline for strokePolyline(), so it is clipped to the screen and shares the
+ rasterization of every other stroke.
 
  @param screen The screen buffer to draw the line on.
  @param width  The width of the screen buffer in pixels.
@@ -82,46 +114,10 @@ void setPixel(uint8_t *frame, size_t canvasWidthPx, size_t canvasHeightPx,
  @param y1     The y-coordinate of the ending point of the line.
 */
 void drawLine(uint8_t *screen, size_t width, size_t height, int x0, int y0, int x1, int y1, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    // Precompute pitch and initial position
-    size_t pitch = width * 4; // assuming 4 bytes per pixel (RGBA)
-
-    // Precompute RGBA pixel value in a buffer
-    uint32_t pixel = (a << 24) | (b << 16) | (g << 8) | r;
-
-    // Calculate deltas and step directions
-    int dx = abs(x1 - x0);
-    int dy = -abs(y1 - y0);
-    int sx = x0 < x1 ? 1 : -1;
-    int sy = y0 < y1 ? 1 : -1;
-    int err = dx + dy;
-
-    int x = x0;
-    int y = y0;
-
-    // Pre-check bounds to avoid repeatedly checking inside the loop
-    if (x < 0 || x >= (int)width || y < 0 || y >= (int)height) return;
-
-    while (1) {
-        // Directly write the precomputed RGBA value to the screen buffer
-        size_t index = (size_t)y * pitch + (size_t)x * 4;
-        *((uint32_t*)&screen[index]) = pixel;
-
-        // Break if end point is reached
-        if (x == x1 && y == y1) break;
-
-        // Adjust error and x/y positions based on Bresenham's algorithm
-        int e2 = err << 1;
-        if (e2 >= dy) {
-            err += dy;
-            x += sx;
-        }
-        if (e2 <= dx) {
-            err += dx;
-            y += sy;
-        }
-
-        // If the line moves out of bounds, break out
-        if (x < 0 || x >= (int)width || y < 0 || y >= (int)height) break;
-    }
+    const MilkyStrokePoint points[2] = {
+        { (float)x0 + 0.5f, (float)y0 + 0.5f, 1.0f },
+        { (float)x1 + 0.5f, (float)y1 + 0.5f, 1.0f }
+    };
+    const MilkyStrokeStyle style = { .width = 1.0f, .color = premultiplyColor(r, g, b, a), .mode = MILKY_BLEND_OVER };
+    strokePolyline(screen, width, height, points, 2, &style, 1, 0, height);
 }
-
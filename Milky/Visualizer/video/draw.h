@@ -7,9 +7,19 @@
 #include <math.h>
 #include <string.h>
 
+// memory layout of the buffers the drawing primitives write to
+typedef enum {
+    MILKY_PIXEL_FORMAT_RGBA = 0,      // four bytes per pixel
+    MILKY_PIXEL_FORMAT_INTENSITY = 1  // one byte per pixel, holding the red channel only
+} MilkyPixelFormat;
+
+void setDrawPixelFormat(MilkyPixelFormat format);
+MilkyPixelFormat getDrawPixelFormat(void);
 void clearFrame(uint8_t *frame, size_t frameSize);
 void setPixel(uint8_t *frame, size_t canvasWidthPx, size_t canvasHeightPx,
               int x, int y, uint8_t srcR, uint8_t srcG, uint8_t srcB, uint8_t srcA);
+void getPixel(const uint8_t *frame, size_t canvasWidthPx, size_t canvasHeightPx,
+              int x, int y, uint8_t *r, uint8_t *g, uint8_t *b, uint8_t *a);
 void drawLine(uint8_t *frame, size_t width, size_t height, int x0, int y0, int x1, int y1, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
 #endif // DRAW_H
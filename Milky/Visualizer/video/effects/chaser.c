@@ -1,114 +1,178 @@
 #include "chaser.h"
 
-// structure to represent a chaser, which is a moving point on the screen
-typedef struct {
-    float coeff1; // coefficient for x-axis movement calculation
-    float coeff2; // coefficient for x-axis movement calculation
-    float coeff3; // coefficient for y-axis movement calculation
-    float coeff4; // coefficient for y-axis movement calculation
-    float pathLengthX; // length of the path on the x-axis
-    float pathLengthY; // length of the path on the y-axis
-    int prevX; // previous x-coordinate of the chaser
-    int prevY; // previous y-coordinate of the chaser
-} Chaser;
-
-// array to store the chasers (precomputed coefficients, path lenghts, position cache), limited to MAX_CHASERS
-static Chaser chasers[MILKY_MAX_CHASERS];
-
-// variables to track the last known canvas dimensions
-// used to determine if the chasers need reinitialization
-// this is necessary on sudden canvas size changes
-static size_t lastWidth = 0;
-static size_t lastHeight = 0;
+#include <string.h>
+
+// 2 pi split into a float with few mantissa bits and the rest (Cody-Waite), so the range
+// reduction stays exact for the large arguments of long-running chasers
+#define MILKY_TWO_PI_HIGH 6.28125f
+#define MILKY_TWO_PI_LOW 1.9353071795864769e-3f
+#define MILKY_INVERSE_TWO_PI 0.15915494309189535f
+
+// adding and subtracting 1.5 * 2^23 rounds a float to the nearest integer, without a branch
+#define MILKY_ROUNDING_BIAS 12582912.0f
+
+/**
+ * Approximates cosf() without branches or library calls, so loops over many arguments
+ * vectorize. The argument is reduced to [-pi, pi] and evaluated with the Taylor polynomial
+ * up to x^16; the absolute error stays below 1e-6.
+ *
+ * @param x The angle in radians.
+ * @return  The cosine of x.
+ */
+static inline float polyCos(float x) {
+    float k = (x * MILKY_INVERSE_TWO_PI + MILKY_ROUNDING_BIAS) - MILKY_ROUNDING_BIAS;
+    float r = (x - k * MILKY_TWO_PI_HIGH) - k * MILKY_TWO_PI_LOW;
+
+    float r2 = r * r;
+    float p = 1.0f / 20922789888000.0f;
+    p = p * r2 - 1.0f / 87178291200.0f;
+    p = p * r2 + 1.0f / 479001600.0f;
+    p = p * r2 - 1.0f / 3628800.0f;
+    p = p * r2 + 1.0f / 40320.0f;
+    p = p * r2 - 1.0f / 720.0f;
+    p = p * r2 + 1.0f / 24.0f;
+    p = p * r2 - 0.5f;
+    return p * r2 + 1.0f;
+}
 
 /**
- Renders a set of "chasers" on a screen buffer. 
+ Moves the chasers and starts the trail segments of the current frame.
 
- Each chaser is a moving point that leaves a trail as it moves across the screen. 
- The function takes into account the current time frame, speed, and the number of chasers to render. 
- It also ensures that the chasers are reinitialized if the canvas size changes. 
- For each chaser, it calculates a new position based on trigonometric functions to create a smooth and varied movement pattern. t
- The new position is then used to draw a line from the chaser's previous position to its new position on the screen buffer. 
- The previous position is updated for the next frame.
+ Each chaser follows a smooth and varied path made of two cosines per axis; the current
+ time frame and the chaser's index select the point on the path. The chasers are
+ reinitialized if the canvas size or their count changes. The previous position becomes
+ the start of the new trail segment, which drawChaserRows() then draws.
+ The loop runs over the arrays of the state, with polyCos() in place of cosf(), so the
+ compiler can evaluate several chasers per instruction.
 
+ @param state     The chaser state of the render context.
  @param timeFrame The current time frame for animation (used to create variation in chaser movement).
- @param screen    The screen buffer to render the chasers on.
  @param speed     The speed factor for chaser movement (higher values result in faster movement).
- @param count     The number of chasers to render.
+ @param count     The number of chasers to move (at most MILKY_MAX_CHASERS).
  @param width     The width of the screen buffer in pixels.
  @param height    The height of the screen buffer in pixels.
  @param seed      The seed value for random number generation (used to ensure reproducibility).
 */
-void renderChasers(float timeFrame, uint8_t *screen, float speed, unsigned int count, size_t width, size_t height, unsigned int seed, int thickness) {
+void updateChasers(MilkyChaserState *state, float timeFrame, float speed, unsigned int count, size_t width, size_t height, unsigned int seed) {
+    count = count > MILKY_MAX_CHASERS ? MILKY_MAX_CHASERS : count;
+
     // reinitialize chasers if canvas size changes
     // needed to ensure chasers are correctly positioned on canvas resize
-    if (lastWidth != width || lastHeight != height) {
-        initializeChasers(count, width, height, seed);
-        lastWidth = width;
-        lastHeight = height;
+    if (state->lastWidth != width || state->lastHeight != height || state->count != count) {
+        initializeChasers(state, count, width, height, seed);
+        state->lastWidth = width;
+        state->lastHeight = height;
     }
 
-    for (int k = 0; k < count; k++) {
-        Chaser *chaser = &chasers[k];
+    const float centerX = (float)(width / 2);
+    const float centerY = (float)(height / 2);
+    const int32_t maxX = (int32_t)width - 1;
+    const int32_t maxY = (int32_t)height - 1;
+    const float phase = timeFrame * speed;
 
+    // the last positions start this frame's segments
+    memcpy(state->prevX, state->x, count * sizeof(int32_t));
+    memcpy(state->prevY, state->y, count * sizeof(int32_t));
+
+    for (unsigned int k = 0; k < count; k++) {
         // update frame for this chaser to create variation
-        float chaserTimeFrame = (timeFrame * speed + k) * 50;
+        float chaserTimeFrame = (phase + (float)k) * 50;
 
         // calculate new position
-        int x1 = (int)(width / 2 + chaser->pathLengthX * (cosf(chaserTimeFrame * 0.1102f * chaser->coeff1 + 10.0f) + cosf(chaserTimeFrame * 0.1312f * chaser->coeff2 + 20.0f)));
-        int y1 = (int)(height / 2 + chaser->pathLengthY * (cosf(chaserTimeFrame * 0.1204f * chaser->coeff3 + 40.0f) + cosf(chaserTimeFrame * 0.1715f * chaser->coeff4 + 30.0f)));
+        int32_t x1 = (int32_t)(centerX + state->pathLengthX[k] * (polyCos(chaserTimeFrame * 0.1102f * state->coeff1[k] + 10.0f) + polyCos(chaserTimeFrame * 0.1312f * state->coeff2[k] + 20.0f)));
+        int32_t y1 = (int32_t)(centerY + state->pathLengthY[k] * (polyCos(chaserTimeFrame * 0.1204f * state->coeff3[k] + 40.0f) + polyCos(chaserTimeFrame * 0.1715f * state->coeff4[k] + 30.0f)));
 
         // ensure coordinates are within canvas bounds
-        x1 = (x1 < 0) ? 0 : (x1 >= (int)width ? (int)width - 1 : x1);
-        y1 = (y1 < 0) ? 0 : (y1 >= (int)height ? (int)height - 1 : y1);
-
-        // draw line from previous position to new position with specified thickness
-        for (int offset = -thickness / 2; offset <= thickness / 2; offset++) {
-            drawLine(screen, width, height, chaser->prevX, chaser->prevY + offset, x1, y1 + offset, MILKY_CHASER_INTENSITY, MILKY_CHASER_INTENSITY, MILKY_CHASER_INTENSITY, 255);
-
-            // add antialiasing effect at the edges
-            if (offset == -thickness / 2 || offset == thickness / 2) {
-                // apply a lighter intensity for antialiasing
-                drawLine(screen, width, height, chaser->prevX, chaser->prevY + offset - 1, x1, y1 + offset - 1, MILKY_CHASER_INTENSITY, MILKY_CHASER_INTENSITY, MILKY_CHASER_INTENSITY, 127);
-                drawLine(screen, width, height, chaser->prevX, chaser->prevY + offset + 1, x1, y1 + offset + 1, MILKY_CHASER_INTENSITY, MILKY_CHASER_INTENSITY, MILKY_CHASER_INTENSITY, 127);
-            }
-        }
-
-        // update previous position
-        chaser->prevX = x1;
-        chaser->prevY = y1;
+        x1 = x1 < 0 ? 0 : (x1 > maxX ? maxX : x1);
+        y1 = y1 < 0 ? 0 : (y1 > maxY ? maxY : y1);
+        state->x[k] = x1;
+        state->y[k] = y1;
+    }
+
+    for (unsigned int k = 0; k < count; k++) {
+        state->trail[2 * k] = (MilkyStrokePoint){ (float)state->prevX[k] + 0.5f, (float)state->prevY[k] + 0.5f, 1.0f };
+        state->trail[2 * k + 1] = (MilkyStrokePoint){ (float)state->x[k] + 0.5f, (float)state->y[k] + 0.5f, 1.0f };
     }
 }
 
 /**
- Initializes an array of 'Chaser' structures with random coefficients and path lengths
- based on the given canvas dimensions. it seeds the random number generator with a specified seed
- to ensure reproducibility. Each chaser is assigned random coefficients that influence its movement
+ Draws the trail segments of all chasers, clipped to the rows [firstRow, lastRow), so
+ bands of rows can be drawn on separate threads.
+
+ The segments run from the center of the previous pixel to the center of the current one
+ and are stroked with strokeLines(), as anti-aliased lines with round ends, so successive
+ segments join without gaps and every pixel of a segment is blended once, however steep it
+ is. Segments that miss the band are skipped before they are prepared.
+
+ @param state     The chaser state, moved by updateChasers().
+ @param screen    The screen buffer to render the chasers on, in the current draw pixel format.
+ @param width     The width of the screen buffer in pixels.
+ @param height    The height of the screen buffer in pixels.
+ @param thickness The thickness of the trails in pixels, not counting the anti-aliased rim.
+ @param firstRow  The first row to draw.
+ @param lastRow   One past the last row to draw.
+*/
+void drawChaserRows(const MilkyChaserState *state, uint8_t *screen, size_t width, size_t height, int thickness, size_t firstRow, size_t lastRow) {
+    const MilkyStrokeStyle style = {
+        .width = (float)(thickness + 1),
+        .color = premultiplyColor(MILKY_CHASER_INTENSITY, MILKY_CHASER_INTENSITY, MILKY_CHASER_INTENSITY, 255),
+        .mode = MILKY_BLEND_OVER
+    };
+    strokeLines(screen, width, height, state->trail, 2 * (size_t)state->count, &style, 1, firstRow, lastRow);
+}
+
+/**
+ Renders a set of "chasers" on a screen buffer: moves them with updateChasers() and draws
+ their trails over the whole screen with drawChaserRows(), on the calling thread.
+
+ @param state     The chaser state of the render context.
+ @param timeFrame The current time frame for animation (used to create variation in chaser movement).
+ @param screen    The screen buffer to render the chasers on.
+ @param speed     The speed factor for chaser movement (higher values result in faster movement).
+ @param count     The number of chasers to render.
+ @param width     The width of the screen buffer in pixels.
+ @param height    The height of the screen buffer in pixels.
+ @param seed      The seed value for random number generation (used to ensure reproducibility).
+ @param thickness The thickness of the trails in pixels.
+*/
+void renderChasers(MilkyChaserState *state, float timeFrame, uint8_t *screen, float speed, unsigned int count, size_t width, size_t height, unsigned int seed, int thickness) {
+    updateChasers(state, timeFrame, speed, count, width, height, seed);
+    drawChaserRows(state, screen, width, height, thickness, 0, height);
+}
+
+/**
+ Initializes the chasers with random coefficients and path lengths
+ based on the given canvas dimensions. it draws from a random stream seeded with the specified seed
+ to ensure reproducibility, without touching the random state of any other subsystem. Each chaser is assigned random coefficients that influence its movement
  pattern. the path length for each chaser is calculated as a percentage of the canvas size, ensuring
  that the chaser's movement is proportional to the canvas dimensions. Initially, all chasers are
  positioned at the center of the canvas.
 
- @param count  The number of chasers to initialize.
+ @param state  The chaser state to initialize.
+ @param count  The number of chasers to initialize (at most MILKY_MAX_CHASERS).
  @param width  The width of the canvas in pixels.
  @param height The height of the canvas in pixels.
- @param seed   The seed value for random number generation.
+ @param seed   The seed of the chasers' random stream.
 */
-void initializeChasers(unsigned int count, size_t width, size_t height, unsigned int seed) {
-    srand(seed); // seed the random number generator for stable randomness
+void initializeChasers(MilkyChaserState *state, unsigned int count, size_t width, size_t height, unsigned int seed) {
+    MilkyRandom random;
+    seedRandom(&random, seed, MILKY_RANDOM_CHASERS); // seed a private stream for stable randomness
 
-    for (int k = 0; k < count; k++) {
+    count = count > MILKY_MAX_CHASERS ? MILKY_MAX_CHASERS : count;
+    for (unsigned int k = 0; k < count; k++) {
         // generate random coefficients for the chasers
-        chasers[k].coeff1 = ((float)(rand() % 100)) * 0.01f;
-        chasers[k].coeff2 = ((float)(rand() % 100)) * 0.01f;
-        chasers[k].coeff3 = ((float)(rand() % 100)) * 0.01f;
-        chasers[k].coeff4 = ((float)(rand() % 100)) * 0.01f;
+        state->coeff1[k] = ((float)nextRandomBelow(&random, 100)) * 0.01f;
+        state->coeff2[k] = ((float)nextRandomBelow(&random, 100)) * 0.01f;
+        state->coeff3[k] = ((float)nextRandomBelow(&random, 100)) * 0.01f;
+        state->coeff4[k] = ((float)nextRandomBelow(&random, 100)) * 0.01f;
 
         // calculate the chaser path length as a percentage of the canvas size
-        chasers[k].pathLengthX = ((float)(rand() % 61 + 20)) * 0.01f * width / 4;  // 20% to 80% of width
-        chasers[k].pathLengthY = ((float)(rand() % 61 + 20)) * 0.01f * height / 4; // 20% to 80% of height
+        state->pathLengthX[k] = ((float)(nextRandomBelow(&random, 61) + 20)) * 0.01f * width / 4;  // 20% to 80% of width
+        state->pathLengthY[k] = ((float)(nextRandomBelow(&random, 61) + 20)) * 0.01f * height / 4; // 20% to 80% of height
 
-        // initialize previous positions at the center
-        chasers[k].prevX = (int) width / 2;
-        chasers[k].prevY = (int) height / 2;
+        // initialize positions at the center
+        state->prevX[k] = state->x[k] = (int32_t)width / 2;
+        state->prevY[k] = state->y[k] = (int32_t)height / 2;
     }
+    state->count = count;
 }
@@ -11,15 +11,56 @@
 #endif
 
 #include "../draw.h"
+#include "../blend.h"
+#include "../stroke.h"
+#include "../../random.h"
 
 // maximum number of chasers that can be rendered simultaneously
-#define MILKY_MAX_CHASERS 20
+#define MILKY_MAX_CHASERS 4096
+
+// number of chasers and thickness of their trails in render()
+#define MILKY_CHASER_COUNT 2
+#define MILKY_CHASER_THICKNESS 2
 
 // intensity of the chaser's trail on the screen
 #define MILKY_CHASER_INTENSITY 255
 
+// chasers of one render context, zero-initialized before first use
+// every chaser is a moving point that leaves a trail; its fields are stored as one array per
+// field (structure of arrays), so the position update runs over contiguous floats
+typedef struct {
+    // precomputed coefficients of the x- and y-axis movement
+    float coeff1[MILKY_MAX_CHASERS];
+    float coeff2[MILKY_MAX_CHASERS];
+    float coeff3[MILKY_MAX_CHASERS];
+    float coeff4[MILKY_MAX_CHASERS];
+
+    // length of the path on the x- and y-axis
+    float pathLengthX[MILKY_MAX_CHASERS];
+    float pathLengthY[MILKY_MAX_CHASERS];
+
+    // the trail segment of the current frame, from the previous to the current position
+    int32_t prevX[MILKY_MAX_CHASERS];
+    int32_t prevY[MILKY_MAX_CHASERS];
+    int32_t x[MILKY_MAX_CHASERS];
+    int32_t y[MILKY_MAX_CHASERS];
+
+    // the same segments as pairs of end points for strokeLines(), at the pixel centers
+    MilkyStrokePoint trail[2 * MILKY_MAX_CHASERS];
+
+    // number of chasers in use
+    unsigned int count;
+
+    // last known canvas dimensions, used to determine if the chasers need reinitialization
+    // this is necessary on sudden canvas size changes
+    size_t lastWidth;
+    size_t lastHeight;
+} MilkyChaserState;
+
 // Function prototypes
-void initializeChasers(unsigned int count, size_t width, size_t height, unsigned int seed);
-void renderChasers(float timeFrame, uint8_t *screen, float speed, unsigned int count, size_t width, size_t height, unsigned int seed, int thickness);
+void initializeChasers(MilkyChaserState *state, unsigned int count, size_t width, size_t height, unsigned int seed);
+void updateChasers(MilkyChaserState *state, float timeFrame, float speed, unsigned int count, size_t width, size_t height, unsigned int seed);
+void drawChaserRows(const MilkyChaserState *state, uint8_t *screen, size_t width, size_t height, int thickness, size_t firstRow, size_t lastRow);
+void renderChasers(MilkyChaserState *state, float timeFrame, uint8_t *screen, float speed, unsigned int count, size_t width, size_t height, unsigned int seed, int thickness);
 
 #endif // CHASER_H
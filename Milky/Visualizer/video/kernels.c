@@ -0,0 +1,692 @@
+#include "kernels.h"
+
+/*
+ Per-pixel kernels of the full-frame stages, with one implementation per instruction set.
+
+ The scalar set is the reference: every other set has to produce bit-identical output.
+ The best set the CPU supports is picked once, on first use, and checked against the
+ scalar set before it is trusted. A set that fails the check is never used.
+
+ Table lookups need either a gather (AVX2) or a wide byte shuffle (NEON's TBL). SSE2 has
+ neither, so the SSE2 set only vectorizes the arithmetic: the mass fade, and the saturating
+ bias of the dither, ahead of scalar lookups. SSSE3's PSHUFB only indexes 16 entries; a
+ 256-entry table takes 16 shuffles and selects per 16 bytes, which measured over twice as
+ slow as scalar loads, so there is no SSSE3 set. The byte maps, the RGB map and the table
+ expansion thus stay scalar on SSE2, and with them the fade of the feedback blur, which is
+ a byte map. NEON has no gather, so the 32-bit table expansion stays scalar there.
+*/
+
+// ---------------------------------------------------------------------------------------
+// scalar reference
+
+static void mapBytesScalar(const uint8_t *src, uint8_t *dst, size_t count, const uint8_t *lut) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = lut[src[i]];
+    }
+}
+
+static void mapBytesAlternatingScalar(uint8_t *buf, size_t count, const uint8_t *evenLut, const uint8_t *oddLut) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        buf[i] = evenLut[buf[i]];
+        buf[i + 1] = oddLut[buf[i + 1]];
+    }
+    if (i < count) {
+        buf[i] = evenLut[buf[i]];
+    }
+}
+
+static void mapRgbScalar(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *lut) {
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        dst[i] = lut[src[i]];
+        dst[i + 1] = lut[src[i + 1]];
+        dst[i + 2] = lut[src[i + 2]];
+    }
+}
+
+static void massFadeScalar(const uint8_t *prevFrame, uint8_t *frame, size_t size) {
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        for (int channel = 0; channel < 3; channel++) {  // Only apply to RGB channels
+            uint8_t prevValue = prevFrame[i + channel];
+            frame[i + channel] = (prevValue + (uint8_t)(prevValue * 85)) >> 1;
+        }
+    }
+}
+
+static void expandBytesScalar(const uint8_t *src, size_t stride, uint32_t *out, size_t count, const uint32_t *lut) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = lut[src[i * stride]];
+    }
+}
+
+static void ditherBytesScalar(const uint8_t *src, uint8_t *dst, size_t count, const uint8_t *bias, const uint8_t *lut) {
+    for (size_t i = 0; i < count; i++) {
+        unsigned value = (unsigned)src[i] + bias[i & 31];
+        dst[i] = lut[value > 255 ? 255 : value];
+    }
+}
+
+static void ditherRgbScalar(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *bias, const uint8_t *lut) {
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        for (size_t c = 0; c < 3; c++) {
+            unsigned value = (unsigned)src[i + c] + bias[(i + c) & 31];
+            dst[i + c] = lut[value > 255 ? 255 : value];
+        }
+    }
+}
+
+static const MilkyKernels milky_kernelsScalar = {
+    .name = "scalar",
+    .mapBytes = mapBytesScalar,
+    .mapBytesAlternating = mapBytesAlternatingScalar,
+    .mapRgb = mapRgbScalar,
+    .massFade = massFadeScalar,
+    .expandBytes = expandBytesScalar,
+    .ditherBytes = ditherBytesScalar,
+    .ditherRgb = ditherRgbScalar
+};
+
+// ---------------------------------------------------------------------------------------
+// SSE2
+
+#if defined(__SSE2__)
+#define MILKY_KERNELS_SSE2 1
+
+static void massFadeSse2(const uint8_t *prevFrame, uint8_t *frame, size_t size) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i factor = _mm_set1_epi16(85);
+    const __m128i lowByte = _mm_set1_epi16(0x00FF);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(prevFrame + i));
+        __m128i lo = _mm_and_si128(_mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), factor), lowByte);
+        __m128i hi = _mm_and_si128(_mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), factor), lowByte);
+        __m128i m = _mm_packus_epi16(lo, hi);
+
+        // (p + m) >> 1: the rounding average minus the odd bit it rounded up
+        __m128i faded = _mm_sub_epi8(_mm_avg_epu8(p, m), _mm_and_si128(_mm_xor_si128(p, m), one));
+        __m128i kept = _mm_loadu_si128((const __m128i *)(frame + i));
+        _mm_storeu_si128((__m128i *)(frame + i), _mm_or_si128(_mm_andnot_si128(alpha, faded), _mm_and_si128(alpha, kept)));
+    }
+    massFadeScalar(prevFrame + i, frame + i, size - i);
+}
+
+static void ditherBytesSse2(const uint8_t *src, uint8_t *dst, size_t count, const uint8_t *bias, const uint8_t *lut) {
+    const __m128i pattern0 = _mm_loadu_si128((const __m128i *)bias);
+    const __m128i pattern1 = _mm_loadu_si128((const __m128i *)(bias + 16));
+
+    // 32 bytes per step, so the bias pattern stays in phase; only the lookups are scalar
+    size_t i = 0;
+    uint8_t biased[32];
+    for (; i + 32 <= count; i += 32) {
+        _mm_storeu_si128((__m128i *)biased, _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(src + i)), pattern0));
+        _mm_storeu_si128((__m128i *)(biased + 16), _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(src + i + 16)), pattern1));
+        for (int k = 0; k < 32; k++) {
+            dst[i + k] = lut[biased[k]];
+        }
+    }
+    ditherBytesScalar(src + i, dst + i, count - i, bias, lut);
+}
+
+static void ditherRgbSse2(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *bias, const uint8_t *lut) {
+    const __m128i pattern0 = _mm_loadu_si128((const __m128i *)bias);
+    const __m128i pattern1 = _mm_loadu_si128((const __m128i *)(bias + 16));
+
+    size_t i = 0;
+    uint8_t biased[32];
+    for (; i + 32 <= size; i += 32) {
+        _mm_storeu_si128((__m128i *)biased, _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(src + i)), pattern0));
+        _mm_storeu_si128((__m128i *)(biased + 16), _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(src + i + 16)), pattern1));
+        for (int k = 0; k < 32; k += 4) {
+            dst[i + k] = lut[biased[k]];
+            dst[i + k + 1] = lut[biased[k + 1]];
+            dst[i + k + 2] = lut[biased[k + 2]];
+        }
+    }
+    ditherRgbScalar(src + i, dst + i, size - i, bias, lut);
+}
+
+static const MilkyKernels milky_kernelsSse2 = {
+    .name = "sse2",
+    .mapBytes = mapBytesScalar,
+    .mapBytesAlternating = mapBytesAlternatingScalar,
+    .mapRgb = mapRgbScalar,
+    .massFade = massFadeSse2,
+    .expandBytes = expandBytesScalar,
+    .ditherBytes = ditherBytesSse2,
+    .ditherRgb = ditherRgbSse2
+};
+#endif
+
+// ---------------------------------------------------------------------------------------
+// AVX2, compiled for the function only and picked at runtime
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MILKY_KERNELS_AVX2 1
+#define MILKY_AVX2 __attribute__((target("avx2")))
+
+/**
+ * Widens a byte table to 32-bit entries, so it can be read with gathers.
+ */
+static void widenLut(const uint8_t *lut, uint32_t *wide) {
+    for (int i = 0; i < 256; i++) {
+        wide[i] = lut[i];
+    }
+}
+
+/**
+ * Looks up 32 bytes in a widened table, eight gathered entries at a time.
+ */
+static inline MILKY_AVX2 __m256i lookupAvx2(const uint8_t *src, const uint32_t *wide) {
+    __m256i a = _mm256_i32gather_epi32((const int *)wide, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src)), 4);
+    __m256i b = _mm256_i32gather_epi32((const int *)wide, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + 8))), 4);
+    __m256i c = _mm256_i32gather_epi32((const int *)wide, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + 16))), 4);
+    __m256i d = _mm256_i32gather_epi32((const int *)wide, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + 24))), 4);
+
+    // the packs work within 128-bit lanes, the permute restores the byte order
+    __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_packus_epi32(c, d));
+    return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+static MILKY_AVX2 void mapBytesAvx2(const uint8_t *src, uint8_t *dst, size_t count, const uint8_t *lut) {
+    uint32_t wide[256];
+    widenLut(lut, wide);
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        _mm256_storeu_si256((__m256i *)(dst + i), lookupAvx2(src + i, wide));
+    }
+    mapBytesScalar(src + i, dst + i, count - i, lut);
+}
+
+static MILKY_AVX2 void mapBytesAlternatingAvx2(uint8_t *buf, size_t count, const uint8_t *evenLut, const uint8_t *oddLut) {
+    uint32_t evenWide[256], oddWide[256];
+    widenLut(evenLut, evenWide);
+    widenLut(oddLut, oddWide);
+    const __m256i lowByte = _mm256_set1_epi16(0x00FF);
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        // split the 16 byte pairs into even and odd indices, 16 bits each
+        __m256i v = _mm256_loadu_si256((const __m256i *)(buf + i));
+        __m256i even = _mm256_and_si256(v, lowByte);
+        __m256i odd = _mm256_srli_epi16(v, 8);
+
+        __m256i pairs0 = _mm256_or_si256(
+            _mm256_i32gather_epi32((const int *)evenWide, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(even)), 4),
+            _mm256_slli_epi32(_mm256_i32gather_epi32((const int *)oddWide, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(odd)), 4), 8));
+        __m256i pairs1 = _mm256_or_si256(
+            _mm256_i32gather_epi32((const int *)evenWide, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(even, 1)), 4),
+            _mm256_slli_epi32(_mm256_i32gather_epi32((const int *)oddWide, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(odd, 1)), 4), 8));
+
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(pairs0, pairs1), 0xD8);
+        _mm256_storeu_si256((__m256i *)(buf + i), packed);
+    }
+    mapBytesAlternatingScalar(buf + i, count - i, evenLut, oddLut);
+}
+
+static MILKY_AVX2 void mapRgbAvx2(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *lut) {
+    uint32_t wide[256];
+    widenLut(lut, wide);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i mapped = lookupAvx2(src + i, wide);
+        __m256i kept = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_blendv_epi8(mapped, kept, alpha));
+    }
+    mapRgbScalar(src + i, dst + i, size - i, lut);
+}
+
+static MILKY_AVX2 void massFadeAvx2(const uint8_t *prevFrame, uint8_t *frame, size_t size) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i factor = _mm256_set1_epi16(85);
+    const __m256i lowByte = _mm256_set1_epi16(0x00FF);
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i p = _mm256_loadu_si256((const __m256i *)(prevFrame + i));
+        __m256i lo = _mm256_and_si256(_mm256_mullo_epi16(_mm256_unpacklo_epi8(p, zero), factor), lowByte);
+        __m256i hi = _mm256_and_si256(_mm256_mullo_epi16(_mm256_unpackhi_epi8(p, zero), factor), lowByte);
+        __m256i m = _mm256_packus_epi16(lo, hi);
+
+        __m256i faded = _mm256_sub_epi8(_mm256_avg_epu8(p, m), _mm256_and_si256(_mm256_xor_si256(p, m), one));
+        __m256i kept = _mm256_loadu_si256((const __m256i *)(frame + i));
+        _mm256_storeu_si256((__m256i *)(frame + i), _mm256_blendv_epi8(faded, kept, alpha));
+    }
+    massFadeScalar(prevFrame + i, frame + i, size - i);
+}
+
+static MILKY_AVX2 void expandBytesAvx2(const uint8_t *src, size_t stride, uint32_t *out, size_t count, const uint32_t *lut) {
+    size_t i = 0;
+    if (stride == 1) {
+        for (; i + 8 <= count; i += 8) {
+            __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+            _mm256_storeu_si256((__m256i *)(out + i), _mm256_i32gather_epi32((const int *)lut, index, 4));
+        }
+    } else if (stride == 4) {
+        // the index is the first byte of each pixel, so the table may overwrite it in place
+        const __m256i lowByte = _mm256_set1_epi32(0xFF);
+        for (; i + 8 <= count; i += 8) {
+            __m256i index = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(src + i * 4)), lowByte);
+            _mm256_storeu_si256((__m256i *)(out + i), _mm256_i32gather_epi32((const int *)lut, index, 4));
+        }
+    }
+    expandBytesScalar(src + i * stride, stride, out + i, count - i, lut);
+}
+
+static MILKY_AVX2 void ditherBytesAvx2(const uint8_t *src, uint8_t *dst, size_t count, const uint8_t *bias, const uint8_t *lut) {
+    uint32_t wide[256];
+    widenLut(lut, wide);
+    const __m256i pattern = _mm256_loadu_si256((const __m256i *)bias);
+
+    // 32 bytes per step, so the bias pattern stays in phase
+    size_t i = 0;
+    uint8_t biased[32];
+    for (; i + 32 <= count; i += 32) {
+        _mm256_storeu_si256((__m256i *)biased, _mm256_adds_epu8(_mm256_loadu_si256((const __m256i *)(src + i)), pattern));
+        _mm256_storeu_si256((__m256i *)(dst + i), lookupAvx2(biased, wide));
+    }
+    ditherBytesScalar(src + i, dst + i, count - i, bias, lut);
+}
+
+static MILKY_AVX2 void ditherRgbAvx2(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *bias, const uint8_t *lut) {
+    uint32_t wide[256];
+    widenLut(lut, wide);
+    const __m256i pattern = _mm256_loadu_si256((const __m256i *)bias);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+
+    size_t i = 0;
+    uint8_t biased[32];
+    for (; i + 32 <= size; i += 32) {
+        _mm256_storeu_si256((__m256i *)biased, _mm256_adds_epu8(_mm256_loadu_si256((const __m256i *)(src + i)), pattern));
+        __m256i mapped = lookupAvx2(biased, wide);
+        __m256i kept = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_blendv_epi8(mapped, kept, alpha));
+    }
+    ditherRgbScalar(src + i, dst + i, size - i, bias, lut);
+}
+
+static const MilkyKernels milky_kernelsAvx2 = {
+    .name = "avx2",
+    .mapBytes = mapBytesAvx2,
+    .mapBytesAlternating = mapBytesAlternatingAvx2,
+    .mapRgb = mapRgbAvx2,
+    .massFade = massFadeAvx2,
+    .expandBytes = expandBytesAvx2,
+    .ditherBytes = ditherBytesAvx2,
+    .ditherRgb = ditherRgbAvx2
+};
+#endif
+
+// ---------------------------------------------------------------------------------------
+// NEON (AArch64, where it is part of the baseline)
+
+#if defined(__ARM_NEON__) && defined(__aarch64__)
+#define MILKY_KERNELS_NEON 1
+
+/**
+ * Loads a 256-entry table into four 64-byte lookup tables.
+ */
+static inline void loadLutNeon(const uint8_t *lut, uint8x16x4_t *tables) {
+    for (int t = 0; t < 4; t++) {
+        for (int r = 0; r < 4; r++) {
+            tables[t].val[r] = vld1q_u8(lut + 64 * t + 16 * r);
+        }
+    }
+}
+
+/**
+ * Looks up 16 bytes in a 256-entry table. Indices outside of a 64-byte table leave the
+ * lane untouched, so each quarter only fills in its own range.
+ */
+static inline uint8x16_t lookupNeon(uint8x16_t v, const uint8x16x4_t *tables) {
+    uint8x16_t result = vqtbl4q_u8(tables[0], v);
+    result = vqtbx4q_u8(result, tables[1], vsubq_u8(v, vdupq_n_u8(64)));
+    result = vqtbx4q_u8(result, tables[2], vsubq_u8(v, vdupq_n_u8(128)));
+    return vqtbx4q_u8(result, tables[3], vsubq_u8(v, vdupq_n_u8(192)));
+}
+
+static void mapBytesNeon(const uint8_t *src, uint8_t *dst, size_t count, const uint8_t *lut) {
+    uint8x16x4_t tables[4];
+    loadLutNeon(lut, tables);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        vst1q_u8(dst + i, lookupNeon(vld1q_u8(src + i), tables));
+    }
+    mapBytesScalar(src + i, dst + i, count - i, lut);
+}
+
+static void mapBytesAlternatingNeon(uint8_t *buf, size_t count, const uint8_t *evenLut, const uint8_t *oddLut) {
+    uint8x16x4_t evenTables[4], oddTables[4];
+    loadLutNeon(evenLut, evenTables);
+    loadLutNeon(oddLut, oddTables);
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        uint8x16x2_t v = vld2q_u8(buf + i);
+        v.val[0] = lookupNeon(v.val[0], evenTables);
+        v.val[1] = lookupNeon(v.val[1], oddTables);
+        vst2q_u8(buf + i, v);
+    }
+    mapBytesAlternatingScalar(buf + i, count - i, evenLut, oddLut);
+}
+
+static void mapRgbNeon(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *lut) {
+    uint8x16x4_t tables[4];
+    loadLutNeon(lut, tables);
+    const uint8x16_t alpha = vreinterpretq_u8_u32(vdupq_n_u32(0xFF000000u));
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t mapped = lookupNeon(vld1q_u8(src + i), tables);
+        vst1q_u8(dst + i, vbslq_u8(alpha, vld1q_u8(dst + i), mapped));
+    }
+    mapRgbScalar(src + i, dst + i, size - i, lut);
+}
+
+static void massFadeNeon(const uint8_t *prevFrame, uint8_t *frame, size_t size) {
+    const uint8x16_t factor = vdupq_n_u8(85);
+    const uint8x16_t alpha = vreinterpretq_u8_u32(vdupq_n_u32(0xFF000000u));
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t p = vld1q_u8(prevFrame + i);
+        // the 8-bit multiply wraps exactly like the (uint8_t) cast, the halving add truncates
+        uint8x16_t faded = vhaddq_u8(p, vmulq_u8(p, factor));
+        vst1q_u8(frame + i, vbslq_u8(alpha, vld1q_u8(frame + i), faded));
+    }
+    massFadeScalar(prevFrame + i, frame + i, size - i);
+}
+
+static void ditherBytesNeon(const uint8_t *src, uint8_t *dst, size_t count, const uint8_t *bias, const uint8_t *lut) {
+    uint8x16x4_t tables[4];
+    loadLutNeon(lut, tables);
+    const uint8x16_t pattern0 = vld1q_u8(bias);
+    const uint8x16_t pattern1 = vld1q_u8(bias + 16);
+
+    // 32 bytes per step, so the bias pattern stays in phase
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        vst1q_u8(dst + i, lookupNeon(vqaddq_u8(vld1q_u8(src + i), pattern0), tables));
+        vst1q_u8(dst + i + 16, lookupNeon(vqaddq_u8(vld1q_u8(src + i + 16), pattern1), tables));
+    }
+    ditherBytesScalar(src + i, dst + i, count - i, bias, lut);
+}
+
+static void ditherRgbNeon(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *bias, const uint8_t *lut) {
+    uint8x16x4_t tables[4];
+    loadLutNeon(lut, tables);
+    const uint8x16_t pattern0 = vld1q_u8(bias);
+    const uint8x16_t pattern1 = vld1q_u8(bias + 16);
+    const uint8x16_t alpha = vreinterpretq_u8_u32(vdupq_n_u32(0xFF000000u));
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        uint8x16_t mapped0 = lookupNeon(vqaddq_u8(vld1q_u8(src + i), pattern0), tables);
+        uint8x16_t mapped1 = lookupNeon(vqaddq_u8(vld1q_u8(src + i + 16), pattern1), tables);
+        vst1q_u8(dst + i, vbslq_u8(alpha, vld1q_u8(dst + i), mapped0));
+        vst1q_u8(dst + i + 16, vbslq_u8(alpha, vld1q_u8(dst + i + 16), mapped1));
+    }
+    ditherRgbScalar(src + i, dst + i, size - i, bias, lut);
+}
+
+static const MilkyKernels milky_kernelsNeon = {
+    .name = "neon",
+    .mapBytes = mapBytesNeon,
+    .mapBytesAlternating = mapBytesAlternatingNeon,
+    .mapRgb = mapRgbNeon,
+    .massFade = massFadeNeon,
+    .expandBytes = expandBytesScalar,
+    .ditherBytes = ditherBytesNeon,
+    .ditherRgb = ditherRgbNeon
+};
+#endif
+
+// ---------------------------------------------------------------------------------------
+// selection
+
+static const MilkyKernels *milky_kernelsActive = &milky_kernelsScalar;
+static pthread_once_t milky_kernelsOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Lists the kernel sets this CPU can run, the preferred one first and scalar last.
+ *
+ * @param variants    Receives up to `maxVariants` kernel sets.
+ * @param maxVariants The capacity of `variants`.
+ * @return            The number of kernel sets written.
+ */
+size_t getKernelVariants(const MilkyKernels **variants, size_t maxVariants) {
+    const MilkyKernels *supported[MILKY_KERNELS_MAX_VARIANTS];
+    size_t count = 0;
+
+#ifdef MILKY_KERNELS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        supported[count++] = &milky_kernelsAvx2;
+    }
+#endif
+#ifdef MILKY_KERNELS_SSE2
+    supported[count++] = &milky_kernelsSse2;
+#endif
+#ifdef MILKY_KERNELS_NEON
+    supported[count++] = &milky_kernelsNeon;
+#endif
+    supported[count++] = &milky_kernelsScalar;
+
+    if (count > maxVariants) count = maxVariants;
+    memcpy(variants, supported, count * sizeof(const MilkyKernels *));
+    return count;
+}
+
+/**
+ * Fills a buffer with reproducible pseudo-random bytes (xorshift32).
+ */
+static void fillTestBytes(uint8_t *buf, size_t size, uint32_t seed) {
+    uint32_t state = seed ? seed : 1;
+    for (size_t i = 0; i < size; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        buf[i] = (uint8_t)(state >> 24);
+    }
+}
+
+// the inputs verifyKernels() runs on: random data and three edge cases
+#define MILKY_KERNELS_TEST_CASES 4
+
+/**
+ * Fills the source bytes of one test case: random bytes, or one of the edge cases random
+ * data hardly hits, all zeros, all 255s and a ramp over every value.
+ */
+static void fillTestSource(int testCase, uint8_t *src, size_t size, uint32_t seed) {
+    switch (testCase) {
+        case 1: memset(src, 0, size); break;
+        case 2: memset(src, 255, size); break;
+        case 3: for (size_t i = 0; i < size; i++) src[i] = (uint8_t)i; break;
+        default: fillTestBytes(src, size, seed); break;
+    }
+}
+
+/**
+ * Fills the tables and the dither bias of one test case: random ones, or edge cases that
+ * make a wrong index or a wrapped bias show up: identity tables without a bias next to the
+ * zeros, reversed tables with the largest bias next to the 255s, and reversed and identity
+ * tables with a rising bias next to the ramp.
+ */
+static void fillTestTables(int testCase, uint8_t *lut, uint8_t *oddLut, uint32_t *wideLut, uint8_t *bias) {
+    if (testCase == 0) {
+        fillTestBytes(lut, 256, 0x1234u);
+        fillTestBytes(oddLut, 256, 0x5678u);
+        fillTestBytes((uint8_t *)wideLut, 256 * sizeof(uint32_t), 0x9ABCu);
+        fillTestBytes(bias, 32, 0xDEF0u);
+        return;
+    }
+    for (int i = 0; i < 256; i++) {
+        lut[i] = (uint8_t)(testCase == 1 ? i : 255 - i);
+        oddLut[i] = (uint8_t)(testCase == 2 ? 255 - i : i);
+        wideLut[i] = testCase == 1 ? (uint32_t)i : 0xFFFFFFFFu - (uint32_t)i * 0x01010101u;
+    }
+    for (int i = 0; i < 32; i++) {
+        bias[i] = (uint8_t)(testCase == 1 ? 0 : (testCase == 2 ? 255 : i * 8));
+    }
+}
+
+/**
+ * Runs every kernel of a set against the scalar reference on random data and on edge
+ * cases, with lengths and offsets that exercise the vector bodies as well as their scalar
+ * tails.
+ *
+ * @param kernels The kernel set to check.
+ * @return        The number of kernels whose output differs from the reference.
+ */
+size_t verifyKernels(const MilkyKernels *kernels) {
+    static const size_t lengths[] = { 0, 1, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 257, 1031 };
+    enum { MAX_PIXELS = 1031 + 4, BUFFER_SIZE = MAX_PIXELS * 4 };
+
+    const MilkyKernels *reference = &milky_kernelsScalar;
+    uint8_t *src = (uint8_t *)malloc(BUFFER_SIZE);
+    uint8_t *expected = (uint8_t *)malloc(BUFFER_SIZE);
+    uint8_t *actual = (uint8_t *)malloc(BUFFER_SIZE);
+    if (!src || !expected || !actual) {
+        fprintf(stderr, "Failed to allocate kernel test buffers\n");
+        free(src);
+        free(expected);
+        free(actual);
+        return 1;
+    }
+
+    uint8_t lut[256], oddLut[256];
+    uint32_t wideLut[256];
+    uint8_t bias[32];
+
+    size_t failures[7] = { 0 };
+    for (int testCase = 0; testCase < MILKY_KERNELS_TEST_CASES; testCase++) {
+        fillTestTables(testCase, lut, oddLut, wideLut, bias);
+
+        for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+            for (size_t offset = 0; offset < 4; offset++) {
+                size_t n = lengths[l];
+                uint32_t seed = (uint32_t)(l * 4 + offset + 1);
+
+                // byte kernels, at unaligned offsets
+                fillTestSource(testCase, src, BUFFER_SIZE, seed);
+                reference->mapBytes(src + offset, expected, n, lut);
+                kernels->mapBytes(src + offset, actual, n, lut);
+                failures[0] += memcmp(expected, actual, n) != 0;
+
+                fillTestSource(testCase, expected, BUFFER_SIZE, seed);
+                fillTestSource(testCase, actual, BUFFER_SIZE, seed);
+                reference->mapBytesAlternating(expected + offset, n, lut, oddLut);
+                kernels->mapBytesAlternating(actual + offset, n, lut, oddLut);
+                failures[1] += memcmp(expected, actual, BUFFER_SIZE) != 0;
+
+                // pixel kernels, on whole pixels at unaligned offsets, with the destination alpha kept
+                fillTestBytes(expected, BUFFER_SIZE, seed + 1000);
+                fillTestBytes(actual, BUFFER_SIZE, seed + 1000);
+                reference->mapRgb(src + offset, expected + offset, n * 4, lut);
+                kernels->mapRgb(src + offset, actual + offset, n * 4, lut);
+                failures[2] += memcmp(expected, actual, BUFFER_SIZE) != 0;
+
+                fillTestBytes(expected, BUFFER_SIZE, seed + 2000);
+                fillTestBytes(actual, BUFFER_SIZE, seed + 2000);
+                reference->massFade(src + offset, expected + offset, n * 4);
+                kernels->massFade(src + offset, actual + offset, n * 4);
+                failures[3] += memcmp(expected, actual, BUFFER_SIZE) != 0;
+
+                // table expansion, from a plane and in place from the red channel
+                reference->expandBytes(src + offset, 1, (uint32_t *)expected, n, wideLut);
+                kernels->expandBytes(src + offset, 1, (uint32_t *)actual, n, wideLut);
+                failures[4] += memcmp(expected, actual, n * 4) != 0;
+
+                fillTestSource(testCase, expected, BUFFER_SIZE, seed + 3000);
+                fillTestSource(testCase, actual, BUFFER_SIZE, seed + 3000);
+                reference->expandBytes(expected, 4, (uint32_t *)expected, n, wideLut);
+                kernels->expandBytes(actual, 4, (uint32_t *)actual, n, wideLut);
+                failures[4] += memcmp(expected, actual, BUFFER_SIZE) != 0;
+
+                // ordered dither, with a bias that saturates part of the values
+                reference->ditherBytes(src + offset, expected, n, bias, lut);
+                kernels->ditherBytes(src + offset, actual, n, bias, lut);
+                failures[5] += memcmp(expected, actual, n) != 0;
+
+                fillTestBytes(expected, BUFFER_SIZE, seed + 4000);
+                fillTestBytes(actual, BUFFER_SIZE, seed + 4000);
+                reference->ditherRgb(src + offset, expected + offset, n * 4, bias, lut);
+                kernels->ditherRgb(src + offset, actual + offset, n * 4, bias, lut);
+                failures[6] += memcmp(expected, actual, BUFFER_SIZE) != 0;
+            }
+        }
+    }
+
+    free(src);
+    free(expected);
+    free(actual);
+
+    static const char *names[7] = { "mapBytes", "mapBytesAlternating", "mapRgb", "massFade", "expandBytes", "ditherBytes", "ditherRgb" };
+    size_t failed = 0;
+    for (int k = 0; k < 7; k++) {
+        if (failures[k]) {
+            fprintf(stderr, "Kernel %s/%s differs from the scalar reference\n", kernels->name, names[k]);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+/**
+ * Picks the preferred kernel set that passes the self-check.
+ */
+static void selectKernels(void) {
+    const MilkyKernels *variants[MILKY_KERNELS_MAX_VARIANTS];
+    size_t count = getKernelVariants(variants, MILKY_KERNELS_MAX_VARIANTS);
+
+    for (size_t v = 0; v < count; v++) {
+        if (variants[v] == &milky_kernelsScalar || verifyKernels(variants[v]) == 0) {
+            milky_kernelsActive = variants[v];
+            return;
+        }
+    }
+}
+
+/**
+ * Returns the kernel set the full-frame stages run with.
+ * The set is picked on first use, from the instruction sets the CPU reports.
+ *
+ * @return The active kernel set.
+ */
+const MilkyKernels *getKernels(void) {
+    pthread_once(&milky_kernelsOnce, selectKernels);
+    return milky_kernelsActive;
+}
+
+/**
+ * Forces a kernel set by name ("avx2", "sse2", "neon" or "scalar"), e.g. to compare them.
+ * Must not be called while a frame is rendering.
+ *
+ * @param name The name of the kernel set.
+ * @return     1 if the set is supported and passed the self-check, 0 otherwise.
+ */
+int setKernels(const char *name) {
+    const MilkyKernels *variants[MILKY_KERNELS_MAX_VARIANTS];
+    size_t count = getKernelVariants(variants, MILKY_KERNELS_MAX_VARIANTS);
+
+    pthread_once(&milky_kernelsOnce, selectKernels);
+    for (size_t v = 0; v < count; v++) {
+        if (strcmp(variants[v]->name, name) != 0) continue;
+        if (variants[v] != &milky_kernelsScalar && verifyKernels(variants[v]) != 0) return 0;
+
+        milky_kernelsActive = variants[v];
+        return 1;
+    }
+
+    fprintf(stderr, "Kernel set %s is not supported on this CPU\n", name);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// upper bound for the number of kernel sets compiled into one binary
+#define MILKY_KERNELS_MAX_VARIANTS 4
+
+// per-pixel kernels of the full-frame stages, one set per instruction set
+typedef struct {
+    const char *name;
+
+    // dst[i] = lut[src[i]]; src and dst may be the same buffer
+    void (*mapBytes)(const uint8_t *src, uint8_t *dst, size_t count, const uint8_t *lut);
+
+    // buf[i] = (i even ? evenLut : oddLut)[buf[i]]
+    void (*mapBytesAlternating)(uint8_t *buf, size_t count, const uint8_t *evenLut, const uint8_t *oddLut);
+
+    // RGBA: dst RGB = lut[src RGB], dst alpha is kept; src and dst may be the same buffer
+    void (*mapRgb)(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *lut);
+
+    // RGBA: frame RGB = (prev + (uint8_t)(prev * 85)) >> 1, frame alpha is kept
+    void (*massFade)(const uint8_t *prevFrame, uint8_t *frame, size_t size);
+
+    // out[i] = lut[src[i * stride]]; with stride 4 the expansion may run in place
+    void (*expandBytes)(const uint8_t *src, size_t stride, uint32_t *out, size_t count, const uint32_t *lut);
+
+    // dst[i] = lut[min(src[i] + bias[i % 32], 255)]; src and dst may be the same buffer
+    void (*ditherBytes)(const uint8_t *src, uint8_t *dst, size_t count, const uint8_t *bias, const uint8_t *lut);
+
+    // RGBA: the same for RGB, dst alpha is kept; src and dst may be the same buffer
+    void (*ditherRgb)(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *bias, const uint8_t *lut);
+} MilkyKernels;
+
+const MilkyKernels *getKernels(void);
+int setKernels(const char *name);
+size_t getKernelVariants(const MilkyKernels **variants, size_t maxVariants);
+size_t verifyKernels(const MilkyKernels *kernels);
+
+#endif // KERNELS_H
@@ -0,0 +1,354 @@
+#include "mesh.h"
+
+/*
+ Coarse warp mesh, modelled after MilkDrop's per-vertex motion grid.
+
+ The motion function (zoom, rotation, center, ripple, drift, damping) is only evaluated at the
+ vertices of a coarse grid. Per pixel, the source position is interpolated bilinearly between
+ the four surrounding vertices, which boils down to two additions per pixel along a row.
+ Rich, preset-driven motion fields therefore cost the same as a plain zoom.
+*/
+
+/**
+ * Initializes an empty mesh with the default resolution.
+ *
+ * @param mesh The mesh to initialize.
+ */
+void initWarpMesh(MilkyWarpMesh *mesh) {
+    memset(mesh, 0, sizeof(MilkyWarpMesh));
+    mesh->resolutionCols = MILKY_MESH_DEFAULT_COLS;
+    mesh->resolutionRows = MILKY_MESH_DEFAULT_ROWS;
+}
+
+/**
+ * Sets the number of mesh cells used by subsequent calls to `meshEvaluate()`.
+ * Values are clamped to 1..MILKY_MESH_MAX_COLS and 1..MILKY_MESH_MAX_ROWS.
+ *
+ * @param mesh The mesh to configure.
+ * @param cols The number of cells horizontally.
+ * @param rows The number of cells vertically.
+ */
+void setMeshResolution(MilkyWarpMesh *mesh, size_t cols, size_t rows) {
+    mesh->resolutionCols = cols < 1 ? 1 : (cols > MILKY_MESH_MAX_COLS ? MILKY_MESH_MAX_COLS : cols);
+    mesh->resolutionRows = rows < 1 ? 1 : (rows > MILKY_MESH_MAX_ROWS ? MILKY_MESH_MAX_ROWS : rows);
+}
+
+/**
+ * Turns elapsed milliseconds into the animation time of the motion function. The time is
+ * reduced to one period of the motion in double precision, so it keeps millisecond
+ * resolution however large the count grows; epoch milliseconds as float seconds would
+ * advance in steps of 128 s.
+ *
+ * @param elapsedMillis The milliseconds since the animation started.
+ * @return              The animation time in seconds, in [0, MILKY_MOTION_PERIOD).
+ */
+float motionTime(size_t elapsedMillis) {
+    return (float)fmod((double)elapsedMillis / 1000.0, MILKY_MOTION_PERIOD);
+}
+
+/**
+ * Evaluates the motion function at every vertex of the mesh.
+ * For a destination position the source position is found by moving it relative to the
+ * motion center, zooming it, applying a radial ripple of strength `magic`, rotating it
+ * by `theta`, adding the vertical `shift` and finally pulling the result back towards
+ * the destination position by `damping`.
+ *
+ * @param mesh   The mesh to fill, initialized by `initWarpMesh()`.
+ * @param params The motion parameters.
+ * @param width  The width of the canvas in pixels.
+ * @param height The height of the canvas in pixels.
+ */
+void meshEvaluate(MilkyWarpMesh *mesh, const MilkyMotionParams *params, size_t width, size_t height) {
+    size_t cols = mesh->resolutionCols < width ? mesh->resolutionCols : (width > 0 ? width : 1);
+    size_t rows = mesh->resolutionRows < height ? mesh->resolutionRows : (height > 0 ? height : 1);
+
+    mesh->cols = cols;
+    mesh->rows = rows;
+    mesh->width = width;
+    mesh->height = height;
+
+    // vertex positions on integer pixel columns/rows, the last one sits one past the edge
+    for (size_t i = 0; i <= cols; i++) mesh->cellX[i] = i * width / cols;
+    for (size_t j = 0; j <= rows; j++) mesh->cellY[j] = j * height / rows;
+
+    float damping = params->damping < 0.0f ? 0.0f : (params->damping > 1.0f ? 1.0f : params->damping);
+    float cx = (0.5f + params->centerX) * width;
+    float cy = (0.5f + params->centerY) * height;
+    float invZoom = 1.0f / params->zoom;
+    float sinTheta = sinf(params->theta), cosTheta = cosf(params->theta);
+    float invRadius = 2.0f / sqrtf((float)(width * width + height * height));
+    float drift = params->shift * height;
+
+    // the zoom-only tap stays separable, so it only carries a (damped) zoom around the center
+    float zoomInv = invZoom + (1.0f - invZoom) * damping;
+    mesh->zoom = 1.0f / zoomInv;
+    mesh->zoomCenterX = cx;
+    mesh->zoomCenterY = cy;
+
+    for (size_t j = 0; j <= rows; j++) {
+        for (size_t i = 0; i <= cols; i++) {
+            float px = (float)mesh->cellX[i];
+            float py = (float)mesh->cellY[j];
+
+            // zoom towards the motion center
+            float dx = (px - cx) * invZoom;
+            float dy = (py - cy) * invZoom;
+
+            // radial ripple, travelling outwards over time
+            if (params->magic != 0.0f) {
+                float r = sqrtf(dx * dx + dy * dy) * invRadius;
+                float ripple = 1.0f + params->magic * 0.05f * sinf(r * 12.0f - params->time * 2.0f);
+                dx *= ripple;
+                dy *= ripple;
+            }
+
+            // rotate around the motion center and drift
+            float sx = cosTheta * dx - sinTheta * dy + cx;
+            float sy = sinTheta * dx + cosTheta * dy + cy + drift;
+
+            // damping pulls the source back onto the destination
+            sx += (px - sx) * damping;
+            sy += (py - sy) * damping;
+
+            size_t index = j * (cols + 1) + i;
+            mesh->u[index] = (int32_t)lrintf(sx * 65536.0f);
+            mesh->v[index] = (int32_t)lrintf(sy * 65536.0f);
+        }
+    }
+}
+
+/**
+ * Interpolates the source positions of all vertex columns for one pixel row.
+ * Pixels between two vertex columns then interpolate linearly between these edges.
+ *
+ * @param mesh  The evaluated mesh.
+ * @param y     The pixel row.
+ * @param edgeU Receives `cols + 1` source x-coordinates in 16.16 fixed point.
+ * @param edgeV Receives `cols + 1` source y-coordinates in 16.16 fixed point.
+ */
+void meshRowEdges(const MilkyWarpMesh *mesh, size_t y, int32_t *edgeU, int32_t *edgeV) {
+    // find the cell row containing y
+    size_t j = y * mesh->rows / mesh->height;
+    while (j > 0 && mesh->cellY[j] > y) j--;
+    while (j + 1 < mesh->rows && mesh->cellY[j + 1] <= y) j++;
+
+    int64_t span = (int64_t)(mesh->cellY[j + 1] - mesh->cellY[j]);
+    int64_t t = (int64_t)(y - mesh->cellY[j]);
+    const int32_t *u0 = mesh->u + j * (mesh->cols + 1);
+    const int32_t *v0 = mesh->v + j * (mesh->cols + 1);
+    const int32_t *u1 = u0 + mesh->cols + 1;
+    const int32_t *v1 = v0 + mesh->cols + 1;
+
+    for (size_t i = 0; i <= mesh->cols; i++) {
+        edgeU[i] = u0[i] + (int32_t)(((int64_t)(u1[i] - u0[i]) * t) / span);
+        edgeV[i] = v0[i] + (int32_t)(((int64_t)(v1[i] - v0[i]) * t) / span);
+    }
+}
+
+/**
+ * Applies the mesh warp to a frame in a single pass.
+ * Every destination pixel blends the zoom-only tap with the full motion tap, whose source
+ * position is interpolated from the mesh; this replaces `rotate()` followed by `scale()`.
+ *
+ * @param mesh     The evaluated mesh, its size defines the frame size.
+ * @param src      The source frame (RGBA format), left untouched.
+ * @param dst      The destination frame (RGBA format), must not alias `src`.
+ * @param blend    The weight of the full motion tap (0..1).
+ * @param sampling Nearest-neighbour or bilinear sampling.
+ */
+void meshWarp(const MilkyWarpMesh *mesh, const uint8_t *src, uint8_t *dst, float blend, MilkyWarpSampling sampling) {
+    meshWarpRows(mesh, src, dst, blend, sampling, 0, mesh->height);
+}
+
+/**
+ * Checks whether a 16.16 fixed-point position, already rounded by +0.5, hits a pixel of the frame.
+ */
+static inline int isInside(int32_t fx, int32_t fy, size_t width, size_t height) {
+    return (uint32_t)(fx >> 16) < (uint32_t)width && (uint32_t)(fy >> 16) < (uint32_t)height;
+}
+
+/**
+ * Applies the mesh warp to the destination rows [firstRow, lastRow) only.
+ * The source is read as a whole, so it must be complete before any band is warped.
+ *
+ * @param mesh     The evaluated mesh, its size defines the frame size.
+ * @param src      The source frame (RGBA format), left untouched.
+ * @param dst      The destination frame (RGBA format), must not alias `src`.
+ * @param blend    The weight of the full motion tap (0..1).
+ * @param sampling Nearest-neighbour or bilinear sampling.
+ * @param firstRow The first destination row to write.
+ * @param lastRow  One past the last destination row to write.
+ */
+void meshWarpRows(const MilkyWarpMesh *mesh, const uint8_t *src, uint8_t *dst, float blend, MilkyWarpSampling sampling, size_t firstRow, size_t lastRow) {
+    const uint32_t *srcPx = (const uint32_t *)src;
+    uint32_t *dstPx = (uint32_t *)dst;
+    size_t width = mesh->width, height = mesh->height;
+    uint32_t blendWeight = (uint32_t)(blend * 256.0f + 0.5f);
+
+    float invZoom = 1.0f / mesh->zoom;
+    int32_t zoomStep = (int32_t)lrintf(invZoom * 65536.0f);
+    int32_t zoomStartX = (int32_t)lrintf((mesh->zoomCenterX - mesh->zoomCenterX * invZoom) * 65536.0f);
+
+    int32_t edgeU[MILKY_MESH_MAX_COLS + 1];
+    int32_t edgeV[MILKY_MESH_MAX_COLS + 1];
+
+    if (lastRow > height) lastRow = height;
+
+    // nearest-neighbour sampling, the render loop's, fetches the zoom tap from one source row
+    if (sampling == MILKY_WARP_SAMPLE_NEAREST) {
+        for (size_t y = firstRow; y < lastRow; y++) {
+            meshRowEdges(mesh, y, edgeU, edgeV);
+
+            int32_t zoomX = zoomStartX + 0x8000;
+            int32_t zoomY = (int32_t)lrintf((((float)y - mesh->zoomCenterY) * invZoom + mesh->zoomCenterY) * 65536.0f);
+            int32_t zoomRow = (zoomY + 0x8000) >> 16;
+            const uint32_t *zoomSrc = (uint32_t)zoomRow < (uint32_t)height ? srcPx + (size_t)zoomRow * width : NULL;
+            uint32_t *out = dstPx + y * width;
+
+            for (size_t i = 0; i < mesh->cols; i++) {
+                size_t x0 = mesh->cellX[i], x1 = mesh->cellX[i + 1];
+                int32_t span = (int32_t)(x1 - x0);
+                int32_t u = edgeU[i] + 0x8000, v = edgeV[i] + 0x8000;
+                int32_t stepU = (edgeU[i + 1] - edgeU[i]) / span;
+                int32_t stepV = (edgeV[i + 1] - edgeV[i]) / span;
+
+                // positions move linearly along a cell, so both ends inside means all inside
+                int32_t lastU = u + stepU * (span - 1), lastV = v + stepV * (span - 1);
+                int32_t lastZoomX = zoomX + zoomStep * (span - 1);
+                if (zoomSrc && isInside(zoomX, 0, width, height) && isInside(lastZoomX, 0, width, height)
+                    && isInside(u, v, width, height) && isInside(lastU, lastV, width, height)) {
+                    for (size_t x = x0; x < x1; x++, zoomX += zoomStep, u += stepU, v += stepV) {
+                        out[x] = lerpPixel(zoomSrc[zoomX >> 16], srcPx[(size_t)(v >> 16) * width + (u >> 16)], blendWeight);
+                    }
+                    continue;
+                }
+
+                for (size_t x = x0; x < x1; x++, zoomX += zoomStep, u += stepU, v += stepV) {
+                    int32_t zoomCol = zoomX >> 16;
+                    int32_t xi = u >> 16, yi = v >> 16;
+                    uint32_t zoomed = zoomSrc && (uint32_t)zoomCol < (uint32_t)width ? zoomSrc[zoomCol] : 0;
+                    uint32_t moved = (uint32_t)xi < (uint32_t)width && (uint32_t)yi < (uint32_t)height ? srcPx[(size_t)yi * width + xi] : 0;
+                    out[x] = lerpPixel(zoomed, moved, blendWeight);
+                }
+            }
+        }
+        return;
+    }
+
+    for (size_t y = firstRow; y < lastRow; y++) {
+        meshRowEdges(mesh, y, edgeU, edgeV);
+
+        int32_t zoomX = zoomStartX;
+        int32_t zoomY = (int32_t)lrintf((((float)y - mesh->zoomCenterY) * invZoom + mesh->zoomCenterY) * 65536.0f);
+        uint32_t *out = dstPx + y * width;
+
+        for (size_t i = 0; i < mesh->cols; i++) {
+            size_t x0 = mesh->cellX[i], x1 = mesh->cellX[i + 1];
+            int32_t span = (int32_t)(x1 - x0);
+            int32_t u = edgeU[i], v = edgeV[i];
+            int32_t stepU = (edgeU[i + 1] - u) / span;
+            int32_t stepV = (edgeV[i + 1] - v) / span;
+
+            for (size_t x = x0; x < x1; x++) {
+                uint32_t zoomed = samplePixel(srcPx, width, height, zoomX, zoomY, sampling);
+                uint32_t moved = samplePixel(srcPx, width, height, u, v, sampling);
+                out[x] = lerpPixel(zoomed, moved, blendWeight);
+
+                zoomX += zoomStep;
+                u += stepU;
+                v += stepV;
+            }
+        }
+    }
+}
+
+/**
+ * Applies the mesh warp to the rows [firstRow, lastRow) of an 8-bit intensity plane;
+ * the single-channel counterpart of `meshWarpRows()`.
+ *
+ * @param mesh     The evaluated mesh, its size defines the plane size.
+ * @param src      The source plane (one byte per pixel), left untouched.
+ * @param dst      The destination plane (one byte per pixel), must not alias `src`.
+ * @param blend    The weight of the full motion tap (0..1).
+ * @param sampling Nearest-neighbour or bilinear sampling.
+ * @param firstRow The first destination row to write.
+ * @param lastRow  One past the last destination row to write.
+ */
+void meshWarpPlaneRows(const MilkyWarpMesh *mesh, const uint8_t *src, uint8_t *dst, float blend, MilkyWarpSampling sampling, size_t firstRow, size_t lastRow) {
+    size_t width = mesh->width, height = mesh->height;
+    uint32_t blendWeight = (uint32_t)(blend * 256.0f + 0.5f);
+
+    float invZoom = 1.0f / mesh->zoom;
+    int32_t zoomStep = (int32_t)lrintf(invZoom * 65536.0f);
+    int32_t zoomStartX = (int32_t)lrintf((mesh->zoomCenterX - mesh->zoomCenterX * invZoom) * 65536.0f);
+
+    int32_t edgeU[MILKY_MESH_MAX_COLS + 1];
+    int32_t edgeV[MILKY_MESH_MAX_COLS + 1];
+
+    if (lastRow > height) lastRow = height;
+
+    if (sampling == MILKY_WARP_SAMPLE_NEAREST) {
+        for (size_t y = firstRow; y < lastRow; y++) {
+            meshRowEdges(mesh, y, edgeU, edgeV);
+
+            int32_t zoomX = zoomStartX + 0x8000;
+            int32_t zoomY = (int32_t)lrintf((((float)y - mesh->zoomCenterY) * invZoom + mesh->zoomCenterY) * 65536.0f);
+            int32_t zoomRow = (zoomY + 0x8000) >> 16;
+            const uint8_t *zoomSrc = (uint32_t)zoomRow < (uint32_t)height ? src + (size_t)zoomRow * width : NULL;
+            uint8_t *out = dst + y * width;
+
+            for (size_t i = 0; i < mesh->cols; i++) {
+                size_t x0 = mesh->cellX[i], x1 = mesh->cellX[i + 1];
+                int32_t span = (int32_t)(x1 - x0);
+                int32_t u = edgeU[i] + 0x8000, v = edgeV[i] + 0x8000;
+                int32_t stepU = (edgeU[i + 1] - edgeU[i]) / span;
+                int32_t stepV = (edgeV[i + 1] - edgeV[i]) / span;
+
+                int32_t lastU = u + stepU * (span - 1), lastV = v + stepV * (span - 1);
+                int32_t lastZoomX = zoomX + zoomStep * (span - 1);
+                if (zoomSrc && isInside(zoomX, 0, width, height) && isInside(lastZoomX, 0, width, height)
+                    && isInside(u, v, width, height) && isInside(lastU, lastV, width, height)) {
+                    for (size_t x = x0; x < x1; x++, zoomX += zoomStep, u += stepU, v += stepV) {
+                        out[x] = lerpIntensity(zoomSrc[zoomX >> 16], src[(size_t)(v >> 16) * width + (u >> 16)], blendWeight);
+                    }
+                    continue;
+                }
+
+                for (size_t x = x0; x < x1; x++, zoomX += zoomStep, u += stepU, v += stepV) {
+                    int32_t zoomCol = zoomX >> 16;
+                    int32_t xi = u >> 16, yi = v >> 16;
+                    uint8_t zoomed = zoomSrc && (uint32_t)zoomCol < (uint32_t)width ? zoomSrc[zoomCol] : 0;
+                    uint8_t moved = (uint32_t)xi < (uint32_t)width && (uint32_t)yi < (uint32_t)height ? src[(size_t)yi * width + xi] : 0;
+                    out[x] = lerpIntensity(zoomed, moved, blendWeight);
+                }
+            }
+        }
+        return;
+    }
+
+    for (size_t y = firstRow; y < lastRow; y++) {
+        meshRowEdges(mesh, y, edgeU, edgeV);
+
+        int32_t zoomX = zoomStartX;
+        int32_t zoomY = (int32_t)lrintf((((float)y - mesh->zoomCenterY) * invZoom + mesh->zoomCenterY) * 65536.0f);
+        uint8_t *out = dst + y * width;
+
+        for (size_t i = 0; i < mesh->cols; i++) {
+            size_t x0 = mesh->cellX[i], x1 = mesh->cellX[i + 1];
+            int32_t span = (int32_t)(x1 - x0);
+            int32_t u = edgeU[i], v = edgeV[i];
+            int32_t stepU = (edgeU[i + 1] - u) / span;
+            int32_t stepV = (edgeV[i + 1] - v) / span;
+
+            for (size_t x = x0; x < x1; x++) {
+                uint8_t zoomed = sampleIntensity(src, width, height, zoomX, zoomY, sampling);
+                uint8_t moved = sampleIntensity(src, width, height, u, v, sampling);
+                out[x] = lerpIntensity(zoomed, moved, blendWeight);
+
+                zoomX += zoomStep;
+                u += stepU;
+                v += stepV;
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "transform.h"
+
+// default number of mesh cells, as in MilkDrop's per-vertex warp grid
+#define MILKY_MESH_DEFAULT_COLS 32
+#define MILKY_MESH_DEFAULT_ROWS 24
+
+// upper bound for configurable mesh resolutions
+#define MILKY_MESH_MAX_COLS 128
+#define MILKY_MESH_MAX_ROWS 96
+
+// parameters of the feedback motion function, evaluated once per mesh vertex
+typedef struct {
+    float zoom;    // zoom factor (> 1 zooms in)
+    float theta;   // rotation angle in radians
+    float centerX; // offset of the motion center, fraction of the width (0 = middle)
+    float centerY; // offset of the motion center, fraction of the height (0 = middle)
+    float magic;   // strength of the radial ripple (0 = none)
+    float shift;   // vertical drift per frame, fraction of the height
+    float damping; // 0..1, pulls the motion back towards the identity
+    float time;    // animation time in seconds, see motionTime()
+} MilkyMotionParams;
+
+// the motion function repeats after this many seconds (the period of its ripple)
+#define MILKY_MOTION_PERIOD M_PI
+
+// coarse warp mesh: source positions of the full motion at every grid vertex
+typedef struct {
+    size_t resolutionCols; // requested number of cells, see setMeshResolution()
+    size_t resolutionRows;
+    size_t cols;      // number of cells horizontally
+    size_t rows;      // number of cells vertically
+    size_t width;     // canvas width the mesh was evaluated for
+    size_t height;    // canvas height the mesh was evaluated for
+    float zoom;       // zoom factor of the (separable) zoom-only tap
+    float zoomCenterX; // center of the zoom-only tap in pixels
+    float zoomCenterY;
+    size_t cellX[MILKY_MESH_MAX_COLS + 1]; // pixel column of each vertex column
+    size_t cellY[MILKY_MESH_MAX_ROWS + 1]; // pixel row of each vertex row
+    int32_t u[(MILKY_MESH_MAX_ROWS + 1) * (MILKY_MESH_MAX_COLS + 1)]; // source x, 16.16 fixed point
+    int32_t v[(MILKY_MESH_MAX_ROWS + 1) * (MILKY_MESH_MAX_COLS + 1)]; // source y, 16.16 fixed point
+} MilkyWarpMesh;
+
+void initWarpMesh(MilkyWarpMesh *mesh);
+void setMeshResolution(MilkyWarpMesh *mesh, size_t cols, size_t rows);
+float motionTime(size_t elapsedMillis);
+void meshEvaluate(MilkyWarpMesh *mesh, const MilkyMotionParams *params, size_t width, size_t height);
+void meshRowEdges(const MilkyWarpMesh *mesh, size_t y, int32_t *edgeU, int32_t *edgeV);
+void meshWarp(const MilkyWarpMesh *mesh, const uint8_t *src, uint8_t *dst, float blend, MilkyWarpSampling sampling);
+void meshWarpRows(const MilkyWarpMesh *mesh, const uint8_t *src, uint8_t *dst, float blend, MilkyWarpSampling sampling, size_t firstRow, size_t lastRow);
+void meshWarpPlaneRows(const MilkyWarpMesh *mesh, const uint8_t *src, uint8_t *dst, float blend, MilkyWarpSampling sampling, size_t firstRow, size_t lastRow);
+
+#endif // MESH_H
@@ -1,109 +1,232 @@
 #include "palette.h"
 
-// Define a palette as an array of 256 RGB color values
-uint8_t milky_palettePalette[MILKY_PALETTE_SIZE][3];
-static clock_t milky_paletteLastPaletteInitTime = 0;
-
 /**
- * Sets the RGB values for a specific index in the palette.
+ * Sets the RGB values for a specific index of the palette being generated.
  *
+ * @param palette The palette to modify.
  * @param index The index in the palette to set the RGB values.
  * @param r The red component value.
  * @param g The green component value.
  * @param b The blue component value.
  */
-void setRGB(uint8_t index, uint8_t r, uint8_t g, uint8_t b) {
-    milky_palettePalette[index][0] = r; // Set red component
-    milky_palettePalette[index][1] = g; // Set green component
-    milky_palettePalette[index][2] = b; // Set blue component
+static void setRGB(MilkyPalette *palette, uint8_t index, uint8_t r, uint8_t g, uint8_t b) {
+    palette->target[index] = (255u << 24) | ((uint32_t)b << 16) | ((uint32_t)g << 8) | (uint32_t)r;
 }
 
 /**
- * Generates a random color palette based on predefined types.
- * The palette is filled with different gradient effects depending on the selected type.
+ * Generates a random color palette based on predefined types into `palette->target`.
+ * The palette is filled with different gradient effects depending on the selected type,
+ * drawn from the palette's own random stream. updatePalette() fades over to it.
+ *
+ * @param palette The palette to fill.
  */
-void generatePalette(void) {
-    // seed the random number generator with the current time to ensure different results each time
-    srand((unsigned int)time(NULL));
-
+void generatePalette(MilkyPalette *palette) {
     // randomly select a palette type from 0 to 3
-    int paletteType = rand() % 4;
+    int paletteType = (int)nextRandomBelow(&palette->random, 4);
 
     // generate the palette based on the selected type
     switch (paletteType) {
         case 0: // "purple majik"
             // fill the first 64 colors with a gradient effect
             for (int a = 0; a < 64; a++) {
-                setRGB(a, a, a * a / 64, (uint8_t)(sqrtf(a) * 8));
+                setRGB(palette, a, a, a * a / 64, (uint8_t)(sqrtf(a) * 8));
             }
             // set the remaining colors to maximum intensity white
             for (int a = 64; a < MILKY_PALETTE_SIZE; a++) {
-                setRGB(a, MILKY_MAX_COLOR, MILKY_MAX_COLOR, MILKY_MAX_COLOR);
+                setRGB(palette, a, MILKY_MAX_COLOR, MILKY_MAX_COLOR, MILKY_MAX_COLOR);
             }
             break;
 
         case 1: // "green lantern II"
             // fill the first 64 colors with a different gradient effect
             for (int a = 0; a < 64; a++) {
-                setRGB(a, a * a / 64, (uint8_t)(sqrtf(a) * 8), a);
+                setRGB(palette, a, a * a / 64, (uint8_t)(sqrtf(a) * 8), a);
             }
             // set the remaining colors to maximum intensity white
             for (int a = 64; a < MILKY_PALETTE_SIZE; a++) {
-                setRGB(a, MILKY_MAX_COLOR, MILKY_MAX_COLOR, MILKY_MAX_COLOR);
+                setRGB(palette, a, MILKY_MAX_COLOR, MILKY_MAX_COLOR, MILKY_MAX_COLOR);
             }
             break;
 
         case 2: // "amber sun"
             // fill the first 64 colors with yet another gradient effect
             for (int a = 0; a < 64; a++) {
-                setRGB(a, (uint8_t)(sqrtf(a) * 8), a, a * a / 64);
+                setRGB(palette, a, (uint8_t)(sqrtf(a) * 8), a, a * a / 64);
             }
             // gradually fade the remaining colors to darkness
             for (int a = 64; a < MILKY_PALETTE_SIZE; a++) {
                 uint8_t fadeValue = (uint8_t)((MILKY_PALETTE_SIZE - a) * MILKY_MAX_COLOR / (MILKY_PALETTE_SIZE - 64));
-                setRGB(a, fadeValue, fadeValue, fadeValue);
+                setRGB(palette, a, fadeValue, fadeValue, fadeValue);
             }
             break;
 
         case 3: // "frosty"
             // fill the first 64 colors with a cool gradient effect
             for (int a = 0; a < 64; a++) {
-                setRGB(a, a * a / 64, a, (uint8_t)(sqrtf(a) * 8));
+                setRGB(palette, a, a * a / 64, a, (uint8_t)(sqrtf(a) * 8));
             }
             // set the remaining colors to maximum intensity white
             for (int a = 64; a < MILKY_PALETTE_SIZE; a++) {
-                setRGB(a, MILKY_MAX_COLOR, MILKY_MAX_COLOR, MILKY_MAX_COLOR);
+                setRGB(palette, a, MILKY_MAX_COLOR, MILKY_MAX_COLOR, MILKY_MAX_COLOR);
             }
             break;
     }
 }
 
+/**
+ * Blends two packed colors, two channels per 32-bit lane pair at a time.
+ *
+ * @param from   The color at weight 0.
+ * @param to     The color at weight 256.
+ * @param weight The weight of `to`, 0..256.
+ */
+static uint32_t blendColor(uint32_t from, uint32_t to, uint32_t weight) {
+    uint32_t inverse = 256 - weight;
+    uint32_t redBlue = (((from & 0x00FF00FFu) * inverse + (to & 0x00FF00FFu) * weight) >> 8) & 0x00FF00FFu;
+    uint32_t greenAlpha = (((from >> 8) & 0x00FF00FFu) * inverse + ((to >> 8) & 0x00FF00FFu) * weight) & 0xFF00FF00u;
+    return redBlue | greenAlpha;
+}
+
+/**
+ * Regenerates the palette if an energy spike is detected and sufficient time has elapsed,
+ * and advances the cross-fade to the new palette. The first palette shows up at once; later
+ * ones fade in over MILKY_PALETTE_FADE_MS. The fade runs once per frame on the 256 entries,
+ * so it adds nothing to the per-pixel cost.
+ *
+ * @param palette             The palette to update.
+ * @param currentTime         The current time in milliseconds.
+ * @param energySpikeDetected Whether the energy detector fired on the last frame.
+ */
+void updatePalette(MilkyPalette *palette, size_t currentTime, int energySpikeDetected) {
+    if (palette->lastInitTime == 0) {
+        generatePalette(palette);
+        memcpy(palette->colors, palette->target, sizeof(palette->colors));
+        palette->fading = 0;
+        palette->lastInitTime = currentTime;
+        return;
+    }
+
+    // check if it's time to regenerate the palette based on energy spikes and time elapsed
+    if (energySpikeDetected && currentTime - palette->lastInitTime > 10 * 1000) {
+        // fade from whatever is on screen, even if the previous fade is still running
+        memcpy(palette->source, palette->colors, sizeof(palette->source));
+        generatePalette(palette);
+        palette->fading = 1;
+        palette->fadeStartTime = currentTime;
+        palette->lastInitTime = currentTime;
+    }
+
+    if (palette->fading) {
+        size_t elapsed = currentTime - palette->fadeStartTime;
+        if (elapsed >= MILKY_PALETTE_FADE_MS) {
+            memcpy(palette->colors, palette->target, sizeof(palette->colors));
+            palette->fading = 0;
+            return;
+        }
+
+        uint32_t weight = (uint32_t)(elapsed * 256 / MILKY_PALETTE_FADE_MS);
+        for (int i = 0; i < MILKY_PALETTE_SIZE; i++) {
+            palette->colors[i] = blendColor(palette->source[i], palette->target[i], weight);
+        }
+    }
+}
+
+/**
+ * Applies the current palette to the rows [firstRow, lastRow) of the canvas.
+ *
+ * @param palette  The palette to apply.
+ * @param canvas   The canvas buffer to apply the palette to.
+ * @param width    The width of the canvas in pixels.
+ * @param firstRow The first row to update.
+ * @param lastRow  One past the last row to update.
+ */
+void applyPaletteToRows(const MilkyPalette *palette, uint8_t *canvas, size_t width, size_t firstRow, size_t lastRow) {
+    // use the red channel as the intensity index, whole pixels are replaced in place
+    size_t first = firstRow * width;
+    getKernels()->expandBytes(canvas + first * 4, 4, (uint32_t *)canvas + first, (lastRow - firstRow) * width, palette->colors);
+}
+
 /**
  * Applies the current palette to the canvas, updating each pixel's color.
  * Regenerates the palette if an energy spike is detected and sufficient time has elapsed.
  *
+ * @param palette The palette to update and apply.
  * @param currentTime The current time in milliseconds.
+ * @param energySpikeDetected Whether the energy detector fired on the last frame.
  * @param canvas The canvas buffer to apply the palette to.
  * @param width The width of the canvas in pixels.
  * @param height The height of the canvas in pixels.
  */
-void applyPaletteToCanvas(size_t currentTime, uint8_t *canvas, size_t width, size_t height) {
-    size_t frameSize = width * height;
+void applyPaletteToCanvas(MilkyPalette *palette, size_t currentTime, int energySpikeDetected, uint8_t *canvas, size_t width, size_t height) {
+    updatePalette(palette, currentTime, energySpikeDetected);
+    applyPaletteToRows(palette, canvas, width, 0, height);
+}
 
-    // check if it's time to regenerate the palette based on energy spikes and time elapsed
-    if ((milky_energyEnergySpikeDetected && currentTime - milky_paletteLastPaletteInitTime > 10 * 1000) || milky_paletteLastPaletteInitTime == 0) {
-        generatePalette(); // reinitialize the palette
-        milky_paletteLastPaletteInitTime = currentTime; // update the last initialization time
+/**
+ * Builds the per-frame lookup table of the intensity feedback loop.
+ * An intensity plane holds the red channel of the RGBA pipeline: the faded value picks
+ * a palette entry, whose red component becomes the new intensity. Fade and palette lookup
+ * therefore collapse into a single table.
+ *
+ * @param palette The current palette.
+ * @param fadeLut The fade applied to the red channel before the palette lookup.
+ * @param lut     Receives 256 entries, new intensity per previous intensity.
+ */
+void buildFeedbackLut(const MilkyPalette *palette, const uint8_t *fadeLut, uint8_t *lut) {
+    for (int value = 0; value < 256; value++) {
+        lut[value] = paletteChannel(palette->colors[fadeLut[value]], 0);
+    }
+}
+
+/**
+ * Builds the lookup table expanding an intensity plane to RGBA pixels.
+ * Every intensity shows the average color of the palette entries with that red
+ * component; the 64 gradient entries take precedence, as those are the ones the
+ * feedback loop runs through. Intensities the palette never produces (overlays and
+ * their blends) are shown as grey. Green and blue are quantized to `bitDepth`, the red
+ * component already is by the time the plane is expanded.
+ *
+ * @param palette  The current palette.
+ * @param lut      Receives 256 packed RGBA pixels.
+ * @param bitDepth The bit depth of the rendering.
+ */
+void buildDisplayLut(const MilkyPalette *palette, uint32_t *lut, uint8_t bitDepth) {
+    uint8_t quantized[256];
+    for (int value = 0; value < 256; value++) {
+        quantized[value] = quantizeChannel((uint8_t)value, bitDepth);
     }
-    
-    // apply the current palette to each pixel in the canvas
-    for (size_t i = 0; i < frameSize; i++) {
-        uint8_t colorIndex = canvas[i * 4]; // use the red channel as the intensity index
-
-        // map the palette colors to the RGBA format in the canvas
-        canvas[i * 4] = milky_palettePalette[colorIndex][0];       // R
-        canvas[i * 4 + 1] = milky_palettePalette[colorIndex][1];   // G
-        canvas[i * 4 + 2] = milky_palettePalette[colorIndex][2];   // B
-        canvas[i * 4 + 3] = 255;                      // A (fully opaque)
+
+    for (int value = 0; value < 256; value++) {
+        uint32_t sumG = 0, sumB = 0, count = 0;
+
+        // prefer the gradient part of the palette, fall back to all of it
+        for (int pass = 0; pass < 2 && count == 0; pass++) {
+            int last = pass == 0 ? 64 : MILKY_PALETTE_SIZE;
+            for (int a = 0; a < last; a++) {
+                if (paletteChannel(palette->colors[a], 0) != value) continue;
+                sumG += paletteChannel(palette->colors[a], 1);
+                sumB += paletteChannel(palette->colors[a], 2);
+                count++;
+            }
+        }
+
+        uint8_t g = count ? quantized[(sumG + count / 2) / count] : (uint8_t)value;
+        uint8_t b = count ? quantized[(sumB + count / 2) / count] : (uint8_t)value;
+        lut[value] = (255u << 24) | ((uint32_t)b << 16) | ((uint32_t)g << 8) | (uint32_t)value;
     }
 }
+
+/**
+ * Expands the rows [firstRow, lastRow) of an intensity plane into the RGBA canvas.
+ *
+ * @param plane      The intensity plane, one byte per pixel.
+ * @param canvas     The canvas buffer to write (RGBA format).
+ * @param width      The width of the canvas in pixels.
+ * @param firstRow   The first row to expand.
+ * @param lastRow    One past the last row to expand.
+ * @param displayLut The table built by `buildDisplayLut()`.
+ */
+void expandIntensityRows(const uint8_t *plane, uint8_t *canvas, size_t width, size_t firstRow, size_t lastRow, const uint32_t *displayLut) {
+    size_t first = firstRow * width;
+    getKernels()->expandBytes(plane + first, 1, (uint32_t *)canvas + first, (lastRow - firstRow) * width, displayLut);
+}
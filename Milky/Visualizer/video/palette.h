@@ -8,11 +8,40 @@
 #include <time.h>
 
 #include "../audio/energy.h"
+#include "bitdepth.h"
+#include "kernels.h"
+#include "../random.h"
 
 #define MILKY_PALETTE_SIZE 256
 #define MILKY_MAX_COLOR 63
 
-void generatePalette(void);
-void applyPaletteToCanvas(size_t currentTime, uint8_t *canvas, size_t width, size_t height);
+// duration of the cross-fade between two palettes in milliseconds
+#define MILKY_PALETTE_FADE_MS 1500
+
+// 256 colors, indexed by the red channel of the canvas, packed as RGBA pixels (alpha 255)
+typedef struct {
+    uint32_t colors[MILKY_PALETTE_SIZE]; // palette in use, blended while a cross-fade runs
+    uint32_t source[MILKY_PALETTE_SIZE]; // palette the cross-fade starts from
+    uint32_t target[MILKY_PALETTE_SIZE]; // palette the cross-fade ends at, see generatePalette()
+    size_t fadeStartTime; // start of the running cross-fade in milliseconds
+    int fading;           // whether a cross-fade is running
+    size_t lastInitTime;  // time of the last regeneration in milliseconds, 0 = never
+    MilkyRandom random;   // picks the palette type
+} MilkyPalette;
+
+/**
+ * Returns one channel (0 = red, 1 = green, 2 = blue) of a packed palette color.
+ */
+static inline uint8_t paletteChannel(uint32_t color, int channel) {
+    return (uint8_t)(color >> (channel * 8));
+}
+
+void generatePalette(MilkyPalette *palette);
+void updatePalette(MilkyPalette *palette, size_t currentTime, int energySpikeDetected);
+void applyPaletteToRows(const MilkyPalette *palette, uint8_t *canvas, size_t width, size_t firstRow, size_t lastRow);
+void buildFeedbackLut(const MilkyPalette *palette, const uint8_t *fadeLut, uint8_t *lut);
+void buildDisplayLut(const MilkyPalette *palette, uint32_t *lut, uint8_t bitDepth);
+void expandIntensityRows(const uint8_t *plane, uint8_t *canvas, size_t width, size_t firstRow, size_t lastRow, const uint32_t *displayLut);
+void applyPaletteToCanvas(MilkyPalette *palette, size_t currentTime, int energySpikeDetected, uint8_t *canvas, size_t width, size_t height);
 
 #endif // PALETTE_H
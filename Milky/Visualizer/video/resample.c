@@ -0,0 +1,149 @@
+#include "resample.h"
+
+/**
+ * Maps a destination coordinate to its source tap (pixel centers aligned), as
+ * source index << 8 | 8-bit fraction towards the next source pixel.
+ */
+static uint32_t sourceTap(size_t dst, size_t dstSize, size_t srcSize) {
+    // 24.8 fixed point: (dst + 0.5) * srcSize / dstSize - 0.5
+    int64_t position = (int64_t)(((2 * (uint64_t)dst + 1) * srcSize * 256) / (2 * dstSize)) - 128;
+    int64_t last = (int64_t)(srcSize - 1) << 8;
+    if (position < 0) position = 0;
+    if (position > last) position = last;
+    return (uint32_t)position;
+}
+
+/**
+ * Prepares a scaler for the given sizes; the column taps are only rebuilt when a size changes.
+ *
+ * @param scaler    The scaler to prepare.
+ * @param srcWidth  The width of the source frame.
+ * @param srcHeight The height of the source frame.
+ * @param dstWidth  The width of the destination frame.
+ * @param dstHeight The height of the destination frame.
+ * @return          0 on success, -1 if memory ran out or a size is zero; the caller reports it.
+ */
+int prepareScaler(MilkyScaler *scaler, size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight) {
+    if (srcWidth == 0 || srcHeight == 0 || dstWidth == 0 || dstHeight == 0 || srcWidth >= (1u << 24)) {
+        return -1;
+    }
+    if (scaler->columns && scaler->srcWidth == srcWidth && scaler->srcHeight == srcHeight &&
+        scaler->dstWidth == dstWidth && scaler->dstHeight == dstHeight) {
+        return 0;
+    }
+
+    uint32_t *columns = (uint32_t *)realloc(scaler->columns, dstWidth * sizeof(uint32_t));
+    if (!columns) {
+        return -1;
+    }
+    scaler->columns = columns;
+    for (size_t x = 0; x < dstWidth; x++) {
+        scaler->columns[x] = sourceTap(x, dstWidth, srcWidth);
+    }
+
+    scaler->srcWidth = srcWidth;
+    scaler->srcHeight = srcHeight;
+    scaler->dstWidth = dstWidth;
+    scaler->dstHeight = dstHeight;
+    return 0;
+}
+
+/**
+ * Blends two RGBA pixels, two channels per 32-bit lane pair at a time.
+ *
+ * @param a        The first pixel.
+ * @param b        The second pixel.
+ * @param fraction The weight of `b`, 0..256.
+ */
+static inline uint32_t lerpPixel(uint32_t a, uint32_t b, uint32_t fraction) {
+    uint32_t inverse = 256 - fraction;
+    uint32_t redBlue = (((a & 0x00FF00FFu) * inverse + (b & 0x00FF00FFu) * fraction) >> 8) & 0x00FF00FFu;
+    uint32_t greenAlpha = (((a >> 8) & 0x00FF00FFu) * inverse + ((b >> 8) & 0x00FF00FFu) * fraction) & 0xFF00FF00u;
+    return redBlue | greenAlpha;
+}
+
+/**
+ * Scales one source row horizontally to the destination width.
+ */
+static void scaleRowHorizontally(const MilkyScaler *scaler, const uint32_t *row, uint32_t *out) {
+    const size_t lastColumn = scaler->srcWidth - 1;
+    for (size_t x = 0; x < scaler->dstWidth; x++) {
+        uint32_t columnTap = scaler->columns[x];
+        size_t left = columnTap >> 8;
+        size_t right = left < lastColumn ? left + 1 : left;
+        out[x] = lerpPixel(row[left], row[right], columnTap & 0xFF);
+    }
+}
+
+/**
+ * Scales the destination rows [firstRow, lastRow) of an RGBA frame with bilinear filtering,
+ * in 8-bit fixed point. Source rows are scaled horizontally once and reused by all the
+ * destination rows between them. Rows are independent, so bands can be scaled in parallel.
+ *
+ * @param scaler   A scaler prepared for the frame sizes.
+ * @param src      The source RGBA frame.
+ * @param dst      The destination RGBA frame.
+ * @param firstRow The first destination row.
+ * @param lastRow  The destination row after the last one.
+ */
+void scaleRowsBilinear(const MilkyScaler *scaler, const uint8_t *src, uint8_t *dst, size_t firstRow, size_t lastRow) {
+    const uint32_t *source = (const uint32_t *)src;
+    uint32_t rows[2][scaler->dstWidth];
+    size_t cachedRows[2] = { SIZE_MAX, SIZE_MAX };
+
+    for (size_t y = firstRow; y < lastRow; y++) {
+        uint32_t rowTap = sourceTap(y, scaler->dstHeight, scaler->srcHeight);
+        size_t sy = rowTap >> 8;
+        size_t below = sy + 1 < scaler->srcHeight ? sy + 1 : sy;
+        uint32_t fy = rowTap & 0xFF;
+
+        // the two horizontally scaled rows live in rows[r & 1] for source row r
+        size_t needed[2] = { sy, below };
+        for (size_t n = 0; n < 2; n++) {
+            size_t slot = needed[n] & 1;
+            if (cachedRows[slot] != needed[n]) {
+                scaleRowHorizontally(scaler, source + needed[n] * scaler->srcWidth, rows[slot]);
+                cachedRows[slot] = needed[n];
+            }
+        }
+
+        const uint32_t *upper = rows[sy & 1];
+        const uint32_t *lower = rows[below & 1];
+        uint32_t *out = (uint32_t *)dst + y * scaler->dstWidth;
+        for (size_t x = 0; x < scaler->dstWidth; x++) {
+            out[x] = lerpPixel(upper[x], lower[x], fy);
+        }
+    }
+}
+
+/**
+ * Releases the taps of a scaler; the scaler can be prepared again afterwards.
+ *
+ * @param scaler The scaler to release.
+ */
+void freeScaler(MilkyScaler *scaler) {
+    free(scaler->columns);
+    memset(scaler, 0, sizeof(MilkyScaler));
+}
+
+/**
+ * Resamples a frame or plane to another size with nearest-neighbor sampling.
+ * Used to carry the feedback buffers over a resolution change instead of clearing them.
+ *
+ * @param src           The source pixels.
+ * @param srcWidth      The width of the source.
+ * @param srcHeight     The height of the source.
+ * @param dst           Receives the resampled pixels, must not overlap `src`.
+ * @param dstWidth      The width of the destination.
+ * @param dstHeight     The height of the destination.
+ * @param bytesPerPixel 1 for intensity planes, 4 for RGBA frames.
+ */
+void resampleNearest(const uint8_t *src, size_t srcWidth, size_t srcHeight, uint8_t *dst, size_t dstWidth, size_t dstHeight, size_t bytesPerPixel) {
+    for (size_t y = 0; y < dstHeight; y++) {
+        const uint8_t *row = src + (y * srcHeight / dstHeight) * srcWidth * bytesPerPixel;
+        uint8_t *out = dst + y * dstWidth * bytesPerPixel;
+        for (size_t x = 0; x < dstWidth; x++) {
+            memcpy(out + x * bytesPerPixel, row + (x * srcWidth / dstWidth) * bytesPerPixel, bytesPerPixel);
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// column taps of a bilinear RGBA scaler, cached until the sizes change; zero-initialized before first use
+typedef struct {
+    size_t srcWidth;
+    size_t srcHeight;
+    size_t dstWidth;
+    size_t dstHeight;
+    uint32_t *columns; // per destination column: left source pixel << 8 | 8-bit horizontal fraction
+} MilkyScaler;
+
+int prepareScaler(MilkyScaler *scaler, size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight);
+void scaleRowsBilinear(const MilkyScaler *scaler, const uint8_t *src, uint8_t *dst, size_t firstRow, size_t lastRow);
+void freeScaler(MilkyScaler *scaler);
+void resampleNearest(const uint8_t *src, size_t srcWidth, size_t srcHeight, uint8_t *dst, size_t dstWidth, size_t dstHeight, size_t bytesPerPixel);
+
+#endif // RESAMPLE_H
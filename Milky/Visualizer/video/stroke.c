@@ -0,0 +1,528 @@
+#include "stroke.h"
+
+/*
+ Stroke engine.
+
+ A polyline is stroked by its distance field: a pixel is covered by the stroke as far as
+ its center lies within half the width of the nearest segment, with a one pixel wide
+ anti-aliased falloff, and by the glow around it at the glow's opacity:
+
+   coverage = max(clamp(width / 2 + 0.5 - distance, 0, 1),
+                  clamp(width / 2 + glow + 0.5 - distance, 0, 1) * glowAlpha)
+
+ Taking the nearest segment per pixel unites the segments, so joins and caps come out
+ round and no pixel is blended twice where segments overlap. On a row, a segment only
+ evaluates the pixels within the band of the radius around its line and within its
+ horizontal extent, a bound that is linear in the row and needs no square root; the
+ pixels evaluated in vain are a few next to the round caps. The frame is swept once,
+ row by row: segments are bucketed by their first row and kept in an active list while
+ they reach the current row, each active segment writes its coverage (times the vertex
+ alpha interpolated along it) into a row buffer by maximum, and the covered part of the
+ row is handed to blendMask() as a few spans. The row is tracked in chunks of
+ MILKY_STROKE_CHUNK columns, marked as the segments cover them, so only the marked runs
+ of chunks are blended, and the gaps between distant parts of the polyline are skipped.
+
+ A polyline can be stroked in several layers at once (a bright core and a wider faint
+ glow, say), each with its own width, color and offset. The layers share the segments and
+ the sweep; each has its own row buffer, and the marked runs are blended layer by layer,
+ so every layer lands on a pixel in order, as if it had been stroked on its own.
+
+ Many short separate lines (the chaser trails) are not worth the buckets of a sweep:
+ strokeLines() rasterizes each line's capsule on its own, row by row within the same
+ bound, into a small row buffer. The pixel loop is shared, and runs four pixels at a time
+ with SSE2 or NEON.
+*/
+
+// scratch memory up to this size is taken from the stack, larger polylines allocate
+#define MILKY_STROKE_STACK_BYTES 16384
+
+// columns per chunk of the row that is marked as covered
+#define MILKY_STROKE_CHUNK 8
+
+// columns of the row buffer of strokeLines(), longer rows of a line take several pieces
+#define MILKY_STROKE_LINE_COLUMNS 256
+
+// rounds a scratch size up to a multiple of 8 bytes, so every part of the scratch is
+// aligned for the widest type it holds (uint64_t)
+#define MILKY_STROKE_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+// one segment of the polyline, prepared for the row sweep
+typedef struct {
+    float x0;
+    float y0;
+    float dx;
+    float dy;
+    float inverseLength2; // 1 / |(dx, dy)|^2, 0 for a single point
+    float unitX;          // direction of the segment, normalized; 0 for a single point
+    float unitY;
+    float inverseUnitY;   // 1 / unitY, where it is not 0
+    float left;           // horizontal extent of the segment, relative to x0
+    float right;
+    float alpha0;
+    float alphaDelta;
+    int32_t top;          // first and last row the stroke of the segment can touch
+    int32_t bottom;
+    int32_t next;         // next segment in the bucket of the same first row, -1 = none
+} MilkyStrokeSegment;
+
+/**
+ * Prepares the segment from a to b for the coverage evaluation; top, bottom and next are
+ * left to the caller.
+ */
+static void prepareSegment(MilkyStrokeSegment *segment, const MilkyStrokePoint *a, const MilkyStrokePoint *b) {
+    segment->x0 = a->x;
+    segment->y0 = a->y;
+    segment->dx = b->x - a->x;
+    segment->dy = b->y - a->y;
+    float length2 = segment->dx * segment->dx + segment->dy * segment->dy;
+    float length = sqrtf(length2);
+    segment->inverseLength2 = length2 > 0.0f ? 1.0f / length2 : 0.0f;
+    segment->unitX = length2 > 0.0f ? segment->dx / length : 0.0f;
+    segment->unitY = length2 > 0.0f ? segment->dy / length : 0.0f;
+    segment->inverseUnitY = segment->unitY != 0.0f ? 1.0f / segment->unitY : 0.0f;
+    segment->left = segment->dx < 0.0f ? segment->dx : 0.0f;
+    segment->right = segment->dx > 0.0f ? segment->dx : 0.0f;
+    segment->alpha0 = a->alpha;
+    segment->alphaDelta = b->alpha - a->alpha;
+}
+
+/**
+ * Bounds where a horizontal line crosses the capsule of the given radius around a segment,
+ * relative to its start: within the band of the radius around the infinite line through
+ * the segment, and within the segment's horizontal extent widened by the radius. Along the
+ * line, the offset across the segment is linear in x, so the band is bounded by products
+ * with the precomputed inverse direction, without a division or a square root per row.
+ * The bound may include a few pixels next to the round caps that turn out uncovered.
+ *
+ * @return Whether the line may cross the capsule, the crossing within [*from, *to].
+ */
+static int segmentSpan(const MilkyStrokeSegment *segment, float y, float radius, float *from, float *to) {
+    float low = segment->left - radius;
+    float high = segment->right + radius;
+
+    // |offset across| < radius
+    float across = (y - segment->y0) * segment->unitX;
+    if (segment->unitY != 0.0f) {
+        float a = (across - radius) * segment->inverseUnitY;
+        float b = (across + radius) * segment->inverseUnitY;
+        float bandLow = a < b ? a : b;
+        float bandHigh = a > b ? a : b;
+        low = bandLow > low ? bandLow : low;
+        high = bandHigh < high ? bandHigh : high;
+    } else if (across <= -radius || across >= radius) {
+        return 0;
+    }
+
+    *from = low;
+    *to = high;
+    return low <= high;
+}
+
+/**
+ * Rounds down to an integer without a library call; floorf() is one on targets without
+ * SSE4.1. The value must lie well within the range of int.
+ */
+static inline int floorToInt(float value) {
+    int i = (int)value;
+    return i - (value < (float)i);
+}
+
+/**
+ * Computes the radius around the polyline beyond which the pixel centers are not covered
+ * by a layer: half its width, its glow and the anti-aliased falloff.
+ */
+static float layerRadius(const MilkyStrokeStyle *layer) {
+    return layer->width * 0.5f + (layer->glow > 0.0f ? layer->glow : 0.0f) + 0.5f;
+}
+
+/**
+ * Writes the distance-based coverage of one segment to `count` pixels of a row, keeping the
+ * larger coverage where the row already holds some, or replacing it. The clamps compile to
+ * min/max instructions, so the loop runs without branches; with SSE2 or NEON, four pixels
+ * are evaluated at once, with the same operations in the same order as the scalar loop, so
+ * both give the same coverage.
+ *
+ * @param rowCenter  The y-coordinate of the row's pixel centers, relative to the layer's offset.
+ * @param columnLeft The x-coordinate of the left edge of the first pixel, relative to the layer's offset.
+ * @param replace    Whether to overwrite the row rather than keep the larger coverage; the
+ *                   row then takes whole groups of four pixels, up to 3 beyond `count`.
+ */
+static void coverPixels(const MilkyStrokeSegment *segment, const MilkyStrokeStyle *layer, float rowCenter,
+                        float columnLeft, int count, uint8_t *coverage, int replace) {
+    // the fields are loaded once, as the stores to coverage could alias them
+    const float dx = segment->dx;
+    const float dy = segment->dy;
+    const float inverseLength2 = segment->inverseLength2;
+    const float alpha0 = segment->alpha0 * 255.0f;
+    const float alphaDelta = segment->alphaDelta * 255.0f;
+    const float edge = layer->width * 0.5f + 0.5f;
+    const float glowEdge = edge + layer->glow;
+    const float glowAlpha = layer->glow > 0.0f ? layer->glowAlpha : 0.0f;
+    const float fy = rowCenter - segment->y0;
+    const float fx0 = columnLeft + 0.5f - segment->x0;
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 vdx = _mm_set1_ps(dx);
+    const __m128 vdy = _mm_set1_ps(dy);
+    const __m128 vfy = _mm_set1_ps(fy);
+    const __m128 vfx0 = _mm_set1_ps(fx0);
+    const __m128 fyDy = _mm_mul_ps(vfy, vdy);
+    const __m128 vInverseLength2 = _mm_set1_ps(inverseLength2);
+    const __m128 vAlpha0 = _mm_set1_ps(alpha0);
+    const __m128 vAlphaDelta = _mm_set1_ps(alphaDelta);
+    const __m128 vEdge = _mm_set1_ps(edge);
+    const __m128 vGlowEdge = _mm_set1_ps(glowEdge);
+    const __m128 vGlowAlpha = _mm_set1_ps(glowAlpha);
+    for (; i < (replace ? count : count - 3); i += 4) {
+        __m128 fx = _mm_add_ps(vfx0, _mm_cvtepi32_ps(_mm_setr_epi32(i, i + 1, i + 2, i + 3)));
+        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(fx, vdx), fyDy), vInverseLength2);
+        t = _mm_min_ps(_mm_max_ps(t, zero), one);
+        __m128 ex = _mm_sub_ps(fx, _mm_mul_ps(vdx, t));
+        __m128 ey = _mm_sub_ps(vfy, _mm_mul_ps(vdy, t));
+
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)));
+        __m128 covered = _mm_min_ps(_mm_max_ps(_mm_sub_ps(vEdge, distance), zero), one);
+        __m128 glowed = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_sub_ps(vGlowEdge, distance), zero), one), vGlowAlpha);
+        covered = _mm_max_ps(covered, glowed);
+
+        __m128 alpha = _mm_add_ps(vAlpha0, _mm_mul_ps(vAlphaDelta, t));
+        __m128i values = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(covered, alpha), half));
+        values = _mm_packus_epi16(_mm_packs_epi32(values, values), values);
+        int32_t kept = 0;
+        if (!replace) memcpy(&kept, coverage + i, sizeof(kept));
+        kept = _mm_cvtsi128_si32(_mm_max_epu8(values, _mm_cvtsi32_si128(kept)));
+        memcpy(coverage + i, &kept, sizeof(kept));
+    }
+#elif defined(__ARM_NEON__) && defined(__aarch64__)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t vdx = vdupq_n_f32(dx);
+    const float32x4_t vdy = vdupq_n_f32(dy);
+    const float32x4_t vfy = vdupq_n_f32(fy);
+    const float32x4_t vfx0 = vdupq_n_f32(fx0);
+    const float32x4_t fyDy = vmulq_f32(vfy, vdy);
+    const float32x4_t vInverseLength2 = vdupq_n_f32(inverseLength2);
+    const float32x4_t vAlpha0 = vdupq_n_f32(alpha0);
+    const float32x4_t vAlphaDelta = vdupq_n_f32(alphaDelta);
+    const float32x4_t vEdge = vdupq_n_f32(edge);
+    const float32x4_t vGlowEdge = vdupq_n_f32(glowEdge);
+    const float32x4_t vGlowAlpha = vdupq_n_f32(glowAlpha);
+    const int32_t steps[4] = { 0, 1, 2, 3 };
+    const int32x4_t vsteps = vld1q_s32(steps);
+    for (; i < (replace ? count : count - 3); i += 4) {
+        float32x4_t fx = vaddq_f32(vfx0, vcvtq_f32_s32(vaddq_s32(vdupq_n_s32(i), vsteps)));
+        float32x4_t t = vmulq_f32(vaddq_f32(vmulq_f32(fx, vdx), fyDy), vInverseLength2);
+        t = vminq_f32(vmaxq_f32(t, zero), one);
+        float32x4_t ex = vsubq_f32(fx, vmulq_f32(vdx, t));
+        float32x4_t ey = vsubq_f32(vfy, vmulq_f32(vdy, t));
+
+        float32x4_t distance = vsqrtq_f32(vaddq_f32(vmulq_f32(ex, ex), vmulq_f32(ey, ey)));
+        float32x4_t covered = vminq_f32(vmaxq_f32(vsubq_f32(vEdge, distance), zero), one);
+        float32x4_t glowed = vmulq_f32(vminq_f32(vmaxq_f32(vsubq_f32(vGlowEdge, distance), zero), one), vGlowAlpha);
+        covered = vmaxq_f32(covered, glowed);
+
+        float32x4_t alpha = vaddq_f32(vAlpha0, vmulq_f32(vAlphaDelta, t));
+        uint32x4_t values = vcvtq_u32_f32(vaddq_f32(vmulq_f32(covered, alpha), half));
+        uint16x4_t narrow = vmovn_u32(values);
+        uint8x8_t bytes = vmovn_u16(vcombine_u16(narrow, narrow));
+        uint32_t kept = 0;
+        if (!replace) memcpy(&kept, coverage + i, sizeof(kept));
+        bytes = vmax_u8(bytes, vreinterpret_u8_u32(vdup_n_u32(kept)));
+        kept = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+        memcpy(coverage + i, &kept, sizeof(kept));
+    }
+#endif
+
+    for (; i < count; i++) {
+        float fx = fx0 + (float)i;
+        float t = (fx * dx + fy * dy) * inverseLength2;
+        t = t > 0.0f ? t : 0.0f;
+        t = t < 1.0f ? t : 1.0f;
+        float ex = fx - dx * t;
+        float ey = fy - dy * t;
+
+        // coverage of the stroke and of its glow, whichever is larger
+        float distance = sqrtf(ex * ex + ey * ey);
+        float covered = edge - distance;
+        covered = covered > 0.0f ? covered : 0.0f;
+        covered = covered < 1.0f ? covered : 1.0f;
+        float glowed = glowEdge - distance;
+        glowed = glowed > 0.0f ? glowed : 0.0f;
+        glowed = (glowed < 1.0f ? glowed : 1.0f) * glowAlpha;
+        covered = covered > glowed ? covered : glowed;
+
+        uint8_t value = (uint8_t)(covered * (alpha0 + alphaDelta * t) + 0.5f);
+        coverage[i] = replace || value > coverage[i] ? value : coverage[i];
+    }
+}
+
+/**
+ * Finds the columns of the frame whose pixel centers a layer of a segment may cover on one
+ * row, clipped to [left, right].
+ *
+ * @param y The y-coordinate of the row's pixel centers, relative to the layer's offset.
+ * @return  Whether there are any, the first in *from and the last in *to.
+ */
+static int segmentColumns(const MilkyStrokeSegment *segment, const MilkyStrokeStyle *layer, float y,
+                          int left, int right, int *from, int *to) {
+    float low, high;
+    if (!segmentSpan(segment, y, layerRadius(layer), &low, &high)) return 0;
+
+    // pixel x is inside if its center x + 0.5 is
+    low += segment->x0 + layer->offsetX - 0.5f;
+    high += segment->x0 + layer->offsetX - 0.5f;
+    if (high < (float)left || low > (float)right) return 0;
+    *from = low > (float)left ? -floorToInt(-low) : left;
+    *to = high < (float)right ? floorToInt(high) : right;
+    return *from <= *to;
+}
+
+/**
+ * Writes the coverage of one segment in one layer on one row into the layer's row buffer,
+ * keeping the larger coverage where the row already holds some. The row buffer holds the
+ * columns [left, right] of the frame. Only the pixels within the bound of segmentColumns()
+ * can be covered, so only those are evaluated.
+ *
+ * @return The first column the segment may have covered, with the last in *last; -1 if none.
+ */
+static int coverSegmentRow(const MilkyStrokeSegment *segment, const MilkyStrokeStyle *layer, float rowCenter,
+                           int left, int right, uint8_t *coverage, int *last) {
+    const float y = rowCenter - layer->offsetY;
+    int from, to;
+    if (!segmentColumns(segment, layer, y, left, right, &from, &to)) return -1;
+
+    coverPixels(segment, layer, y, (float)from - layer->offsetX, to - from + 1, coverage + (from - left), 0);
+    *last = to;
+    return from;
+}
+
+/**
+ * Strokes a polyline with one or more layers, each a thick anti-aliased line with round joins
+ * and round caps and an optional glow around it, within the rows [firstRow, lastRow) of the
+ * frame. A single point is drawn as a dot. The layers share one sweep over the rows and are
+ * blended in order, so several emphasis strokes of one polyline cost a single traversal.
+ * Bands of rows may be stroked on separate threads; every band yields exactly its part of
+ * the whole stroke.
+ *
+ * @param frame      The frame buffer, in the current draw pixel format.
+ * @param width      The width of the frame in pixels.
+ * @param height     The height of the frame in pixels.
+ * @param points     The vertices of the polyline.
+ * @param count      The number of vertices.
+ * @param layers     The width, glow, color, blend mode and offset of every stroke, in the order they are blended.
+ * @param layerCount The number of layers.
+ * @param firstRow   The first row to draw.
+ * @param lastRow    One past the last row to draw.
+ */
+void strokePolyline(uint8_t *frame, size_t width, size_t height, const MilkyStrokePoint *points, size_t count,
+                    const MilkyStrokeStyle *layers, size_t layerCount, size_t firstRow, size_t lastRow) {
+    if (count == 0 || width == 0 || layerCount == 0) return;
+
+    // pixels with centers beyond a layer's radius are not covered; rows and columns beyond
+    // the reach of every layer are not touched
+    float reachX = 0.0f;
+    float reachY = 0.0f;
+    for (size_t l = 0; l < layerCount; l++) {
+        float radius = layerRadius(&layers[l]) + 0.5f;
+        float x = radius + fabsf(layers[l].offsetX);
+        float y = radius + fabsf(layers[l].offsetY);
+        reachX = x > reachX ? x : reachX;
+        reachY = y > reachY ? y : reachY;
+    }
+
+    // the pixels the stroke can touch, clipped to the frame and the rows
+    float minPointX = points[0].x, maxPointX = points[0].x;
+    float minPointY = points[0].y, maxPointY = points[0].y;
+    for (size_t i = 1; i < count; i++) {
+        minPointX = points[i].x < minPointX ? points[i].x : minPointX;
+        maxPointX = points[i].x > maxPointX ? points[i].x : maxPointX;
+        minPointY = points[i].y < minPointY ? points[i].y : minPointY;
+        maxPointY = points[i].y > maxPointY ? points[i].y : maxPointY;
+    }
+    const float rowLimit = (float)(lastRow < height ? lastRow : height);
+    if (maxPointY + reachY < (float)firstRow || minPointY - reachY >= rowLimit) return;
+    if (maxPointX + reachX < 0.0f || minPointX - reachX >= (float)width) return;
+
+    const int rowFrom = minPointY - reachY > (float)firstRow ? (int)floorf(minPointY - reachY) : (int)firstRow;
+    const int rowTo = maxPointY + reachY < rowLimit ? (int)ceilf(maxPointY + reachY) : (int)rowLimit - 1;
+    const int left = minPointX - reachX > 0.0f ? (int)floorf(minPointX - reachX) : 0;
+    const int right = maxPointX + reachX < (float)width ? (int)ceilf(maxPointX + reachX) : (int)width - 1;
+    if (rowFrom > rowTo) return;
+
+    // scratch: the segments, the active list, the row buckets, the marked chunks of a row
+    // and one row of coverage per layer
+    const size_t segmentCount = count > 1 ? count - 1 : 1;
+    const size_t rowCount = (size_t)(rowTo - rowFrom + 1);
+    const size_t columnCount = (size_t)(right - left + 1);
+    const size_t chunkWords = (columnCount + 64 * MILKY_STROKE_CHUNK - 1) / (64 * MILKY_STROKE_CHUNK);
+    const size_t chunksOffset = 0;
+    const size_t segmentsOffset = chunksOffset + MILKY_STROKE_ALIGN(chunkWords * sizeof(uint64_t));
+    const size_t activeOffset = segmentsOffset + MILKY_STROKE_ALIGN(segmentCount * sizeof(MilkyStrokeSegment));
+    const size_t bucketsOffset = activeOffset + MILKY_STROKE_ALIGN(segmentCount * sizeof(int32_t));
+    const size_t coverageOffset = bucketsOffset + MILKY_STROKE_ALIGN(rowCount * sizeof(int32_t));
+    const size_t scratchSize = coverageOffset + layerCount * columnCount;
+    uint64_t stackScratch[MILKY_STROKE_STACK_BYTES / sizeof(uint64_t)];
+    unsigned char *scratch = scratchSize <= sizeof(stackScratch) ? (unsigned char *)stackScratch : (unsigned char *)malloc(scratchSize);
+    if (!scratch) {
+        fprintf(stderr, "Failed to allocate stroke scratch memory\n");
+        return;
+    }
+    uint64_t *chunks = (uint64_t *)(scratch + chunksOffset);
+    MilkyStrokeSegment *segments = (MilkyStrokeSegment *)(scratch + segmentsOffset);
+    int32_t *active = (int32_t *)(scratch + activeOffset);
+    int32_t *buckets = (int32_t *)(scratch + bucketsOffset);
+    uint8_t *coverage = scratch + coverageOffset;
+    memset(chunks, 0, chunkWords * sizeof(uint64_t));
+    memset(buckets, 0xFF, rowCount * sizeof(int32_t));
+    memset(coverage, 0, layerCount * columnCount);
+
+    // prepare the segments that reach the rows, bucketed by their first row
+    for (size_t i = 0; i < segmentCount; i++) {
+        const MilkyStrokePoint *a = &points[i];
+        const MilkyStrokePoint *b = count > 1 ? &points[i + 1] : a;
+        MilkyStrokeSegment *segment = &segments[i];
+
+        segment->top = (int32_t)floorf((a->y < b->y ? a->y : b->y) - reachY);
+        segment->bottom = (int32_t)ceilf((a->y > b->y ? a->y : b->y) + reachY);
+        if (segment->bottom < rowFrom || segment->top > rowTo) continue;
+
+        prepareSegment(segment, a, b);
+        int first = segment->top < rowFrom ? rowFrom : segment->top;
+        segment->next = buckets[first - rowFrom];
+        buckets[first - rowFrom] = (int32_t)i;
+    }
+
+    // sweep the rows once
+    size_t activeCount = 0;
+    for (int row = rowFrom; row <= rowTo; row++) {
+        for (int32_t s = buckets[row - rowFrom]; s >= 0; s = segments[s].next) {
+            active[activeCount++] = s;
+        }
+
+        // coverage of the active segments in every layer, marking the chunks they cover
+        const float rowCenter = (float)row + 0.5f;
+        size_t kept = 0;
+        for (size_t i = 0; i < activeCount; i++) {
+            const MilkyStrokeSegment *segment = &segments[active[i]];
+            if (segment->bottom < row) continue;
+            active[kept++] = active[i];
+
+            for (size_t l = 0; l < layerCount; l++) {
+                if (layers[l].width <= 0.0f) continue;
+                int last = 0;
+                int first = coverSegmentRow(segment, &layers[l], rowCenter, left, right, coverage + l * columnCount, &last);
+                if (first < 0) continue;
+                for (int c = (first - left) / MILKY_STROKE_CHUNK; c <= (last - left) / MILKY_STROKE_CHUNK; c++) {
+                    chunks[c / 64] |= (uint64_t)1 << (c % 64);
+                }
+            }
+        }
+        activeCount = kept;
+
+        // blend the runs of marked chunks, layer by layer, and clear them for the next row
+        for (size_t w = 0; w < chunkWords; w++) {
+            uint64_t bits = chunks[w];
+            chunks[w] = 0;
+            while (bits) {
+                int start = __builtin_ctzll(bits);
+                uint64_t rest = ~(bits >> start);
+                int run = rest ? __builtin_ctzll(rest) : 64 - start;
+                bits &= run + start < 64 ? ~(uint64_t)0 << (run + start) : 0;
+
+                int from = left + ((int)w * 64 + start) * MILKY_STROKE_CHUNK;
+                int to = from + run * MILKY_STROKE_CHUNK - 1;
+                to = to > right ? right : to;
+                for (size_t l = 0; l < layerCount; l++) {
+                    uint8_t *layerCoverage = coverage + l * columnCount + (from - left);
+                    blendMask(frame, width, height, from, row, layerCoverage, to - from + 1, layers[l].color, layers[l].mode);
+                    memset(layerCoverage, 0, (size_t)(to - from + 1));
+                }
+            }
+        }
+    }
+
+    if (scratch != (unsigned char *)stackScratch) free(scratch);
+}
+
+/**
+ * Blends the coverage of one line in one layer on the columns [from, to] of a row, through
+ * a row buffer of MILKY_STROKE_LINE_COLUMNS (+ 3) bytes; longer runs go in pieces.
+ */
+static void blendLineRow(uint8_t *frame, size_t width, size_t height, const MilkyStrokeSegment *segment,
+                         const MilkyStrokeStyle *layer, float y, int row, int from, int to, uint8_t *coverage) {
+    for (int start = from; start <= to; start += MILKY_STROKE_LINE_COLUMNS) {
+        int length = to - start + 1 < MILKY_STROKE_LINE_COLUMNS ? to - start + 1 : MILKY_STROKE_LINE_COLUMNS;
+        coverPixels(segment, layer, y, (float)start - layer->offsetX, length, coverage, 1);
+
+        // the buffer holds whole groups of four, and the pixels past the bound come out
+        // uncovered, so the last piece blends whole groups where they lie within the frame
+        int groups = (length + 3) & ~3;
+        length = start + length > to && (size_t)(start + groups) <= width ? groups : length;
+        blendMask(frame, width, height, start, row, coverage, length, layer->color, layer->mode);
+    }
+}
+
+/**
+ * Strokes separate lines, like two-point polylines, with one or more layers within the rows
+ * [firstRow, lastRow) of the frame. Each line is rasterized on its own, row by row, without
+ * the buckets and scratch memory of a polyline's sweep, which makes many short lines cheap;
+ * where lines overlap, each one is blended.
+ *
+ * @param frame      The frame buffer, in the current draw pixel format.
+ * @param width      The width of the frame in pixels.
+ * @param height     The height of the frame in pixels.
+ * @param points     The end points of the lines, two per line.
+ * @param count      The number of points; an odd last point is ignored.
+ * @param layers     The width, glow, color, blend mode and offset of every stroke, in the order they are blended.
+ * @param layerCount The number of layers.
+ * @param firstRow   The first row to draw.
+ * @param lastRow    One past the last row to draw.
+ */
+void strokeLines(uint8_t *frame, size_t width, size_t height, const MilkyStrokePoint *points, size_t count,
+                 const MilkyStrokeStyle *layers, size_t layerCount, size_t firstRow, size_t lastRow) {
+    if (width == 0 || layerCount == 0) return;
+
+    // rows beyond the reach of every layer are not touched
+    float reachY = 0.0f;
+    for (size_t l = 0; l < layerCount; l++) {
+        float y = layerRadius(&layers[l]) + 0.5f + fabsf(layers[l].offsetY);
+        reachY = y > reachY ? y : reachY;
+    }
+    const int rowLimit = (int)(lastRow < height ? lastRow : height);
+    const int right = (int)width - 1;
+    uint8_t coverage[MILKY_STROKE_LINE_COLUMNS + 3];
+
+    for (size_t i = 0; i + 1 < count; i += 2) {
+        const MilkyStrokePoint *a = &points[i];
+        const MilkyStrokePoint *b = &points[i + 1];
+        const float minY = a->y < b->y ? a->y : b->y;
+        const float maxY = a->y > b->y ? a->y : b->y;
+        if (maxY + reachY < (float)firstRow || minY - reachY >= (float)rowLimit) continue;
+
+        MilkyStrokeSegment segment;
+        prepareSegment(&segment, a, b);
+
+        for (size_t l = 0; l < layerCount; l++) {
+            const MilkyStrokeStyle *layer = &layers[l];
+            if (layer->width <= 0.0f) continue;
+
+            const float reach = layerRadius(layer) + 0.5f;
+            int top = floorToInt(minY + layer->offsetY - reach);
+            int bottom = -floorToInt(-(maxY + layer->offsetY + reach));
+            top = top > (int)firstRow ? top : (int)firstRow;
+            bottom = bottom < rowLimit ? bottom : rowLimit - 1;
+
+            for (int row = top; row <= bottom; row++) {
+                const float y = (float)row + 0.5f - layer->offsetY;
+                int from, to;
+                if (!segmentColumns(&segment, layer, y, 0, right, &from, &to)) continue;
+                blendLineRow(frame, width, height, &segment, layer, y, row, from, to, coverage);
+            }
+        }
+    }
+}
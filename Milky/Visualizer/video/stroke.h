@@ -0,0 +1,44 @@
+#ifndef STROKE_H
+#define STROKE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "blend.h"
+
+// one vertex of a stroked polyline
+typedef struct {
+    float x;     // position in pixels; pixel (i, j) covers [i, i + 1) x [j, j + 1)
+    float y;
+    float alpha; // opacity at this vertex (0-1), interpolated along the adjacent segments
+} MilkyStrokePoint;
+
+// how a polyline is stroked; one layer of the stroke
+typedef struct {
+    float width;         // stroke width in pixels, 0 to skip the layer
+    float glow;          // width in pixels of a faint rim on either side of the stroke, 0 for none
+    float glowAlpha;     // opacity of the rim (0-1)
+    uint32_t color;      // premultiplied color (see premultiplyColor()), scaled by coverage and vertex alpha
+    MilkyBlendMode mode; // how the stroke combines with the frame
+    float offsetX;       // offset of the layer from the polyline in pixels
+    float offsetY;
+} MilkyStrokeStyle;
+
+void strokePolyline(uint8_t *frame, size_t width, size_t height, const MilkyStrokePoint *points, size_t count,
+                    const MilkyStrokeStyle *layers, size_t layerCount, size_t firstRow, size_t lastRow);
+void strokeLines(uint8_t *frame, size_t width, size_t height, const MilkyStrokePoint *points, size_t count,
+                 const MilkyStrokeStyle *layers, size_t layerCount, size_t firstRow, size_t lastRow);
+
+#endif // STROKE_H
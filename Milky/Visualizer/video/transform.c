@@ -1,38 +1,44 @@
 #include "transform.h"
 
-// global variable to store the last theta value
-static float milky_transformLastTheta = 0.0f;
-static float milky_transformTargetTheta = 0.0f;
+/**
+ * Advances the feedback rotation angle by one frame.
+ * Whenever the current angle has (almost) reached its target, a new target is picked
+ * randomly between -45 and 45 degrees. The angle then eases towards that target by
+ * 0.5% of the remaining distance per frame, so the rotation direction changes smoothly.
+ *
+ * @param state The rotation state of the render context.
+ * @return The rotation angle (in radians) to use for the current frame.
+ */
+float nextRotationTheta(MilkyRotationState *state) {
+    // if the difference between lastTheta and targetTheta is small, update targetTheta
+    // this ensures that the rotation direction changes smoothly and randomly
+    if (fabs(state->lastTheta - state->targetTheta) < 0.01f) {
+        // set a new targetTheta randomly between -45 and 45 degrees
+        state->targetTheta = ((int)nextRandomBelow(&state->random, 90) - 45) * (M_PI / 180.0f);
+    }
+
+    // interpolate theta towards targetTheta for smooth transition
+    float theta = state->lastTheta + (state->targetTheta - state->lastTheta) * 0.005f;
+    state->lastTheta = theta; // update lastTheta for the next frame
+    return theta;
+}
 
 /**
  * Rotates the given frame buffer by a calculated angle and blends the result back into the frame.
  * Therefore, applies a smooth rotation transformation to the frame buffer using a temporary buffer.
- * The rotation angle is determined by the speed and angle parameters, and it smoothly transitions
+ * The rotation angle comes from nextRotationTheta(), so it smoothly transitions
  * towards a randomly set target angle. The rotated image is then blended back into the original frame
  * with a specified alpha value for smooth visual effects.
  *
- * @param timeFrame The time frame for the current rendering cycle.
+ * @param state The rotation state of the render context.
  * @param tempBuffer A temporary buffer used for storing the rotated image.
  * @param frame The frame buffer (RGBA format) to be rotated.
- * @param speed The speed factor influencing the rotation angle.
- * @param angle The base angle for rotation.
  * @param width The width of the frame buffer in pixels.
  * @param height The height of the frame buffer in pixels.
  */
-void rotate(float timeFrame, uint8_t *tempBuffer, uint8_t *frame, float speed, float angle, size_t width, size_t height) {
-    // calculate the initial rotation angle based on speed and angle
-    float theta = speed * angle;
-
-    // if the difference between lastTheta and targetTheta is small, update targetTheta
-    // this ensures that the rotation direction changes smoothly and randomly
-    if (fabs(milky_transformLastTheta - milky_transformTargetTheta) < 0.01f) {
-        // set a new targetTheta randomly between -45 and 45 degrees
-        milky_transformTargetTheta = (rand() % 90 - 45) * (M_PI / 180.0f);
-    }
-
-    // interpolate theta towards targetTheta for smooth transition
-    theta = milky_transformLastTheta + (milky_transformTargetTheta - milky_transformLastTheta) * 0.005f;
-    milky_transformLastTheta = theta; // update lastTheta for the next frame
+void rotate(MilkyRotationState *state, uint8_t *tempBuffer, uint8_t *frame, size_t width, size_t height) {
+    // advance the rotation angle towards its (randomly chosen) target
+    float theta = nextRotationTheta(state);
 
     // precompute sine and cosine of the current theta for rotation
     float sin_theta = sinf(theta), cos_theta = cosf(theta);
@@ -174,3 +180,59 @@ void scale(
     memcpy(frame, tempBuffer, frameSize);
 #endif
 }
+
+/**
+ * Applies the per-frame feedback transform in a single inverse-mapped pass.
+ * This fuses what `rotate()` followed by `scale()` do: for every destination pixel the
+ * zoomed source position is computed, the frame is sampled there and at the same position
+ * rotated around the frame center, and both samples are blended with `blend`.
+ * The source is read once and the destination written once; no temporary buffer,
+ * memset or copy-back is needed. Source positions are stepped incrementally in
+ * 16.16 fixed point, so the inner loop is free of float math.
+ *
+ * @param src      The source frame (RGBA format), left untouched.
+ * @param dst      The destination frame (RGBA format), must not alias `src`.
+ * @param width    The width of the frame in pixels.
+ * @param height   The height of the frame in pixels.
+ * @param theta    The rotation angle in radians.
+ * @param zoom     The zoom factor (> 1 zooms in).
+ * @param blend    The weight of the rotated sample (0..1).
+ * @param sampling Nearest-neighbour or bilinear sampling.
+ */
+void warpAffine(const uint8_t *src, uint8_t *dst, size_t width, size_t height, float theta, float zoom, float blend, MilkyWarpSampling sampling) {
+    const uint32_t *srcPx = (const uint32_t *)src;
+    uint32_t *dstPx = (uint32_t *)dst;
+
+    // calculate center, inverse zoom and the rotation matrix once per frame
+    float cx = width * 0.5f, cy = height * 0.5f;
+    float invZoom = 1.0f / zoom;
+    float sinTheta = sinf(theta), cosTheta = cosf(theta);
+    uint32_t blendWeight = (uint32_t)(blend * 256.0f + 0.5f);
+
+    // per-pixel increments of both source positions along a destination row
+    int32_t zoomStepX = (int32_t)lrintf(invZoom * 65536.0f);
+    int32_t rotStepX = (int32_t)lrintf(cosTheta * invZoom * 65536.0f);
+    int32_t rotStepY = (int32_t)lrintf(sinTheta * invZoom * 65536.0f);
+
+    for (size_t y = 0; y < height; y++) {
+        // source position of the first pixel in this row, relative to the center
+        float px = -cx * invZoom;
+        float py = ((float)y - cy) * invZoom;
+
+        int32_t zoomX = (int32_t)lrintf((px + cx) * 65536.0f);
+        int32_t zoomY = (int32_t)lrintf((py + cy) * 65536.0f);
+        int32_t rotX = (int32_t)lrintf((cosTheta * px - sinTheta * py + cx) * 65536.0f);
+        int32_t rotY = (int32_t)lrintf((sinTheta * px + cosTheta * py + cy) * 65536.0f);
+
+        uint32_t *out = dstPx + y * width;
+        for (size_t x = 0; x < width; x++) {
+            uint32_t zoomed = samplePixel(srcPx, width, height, zoomX, zoomY, sampling);
+            uint32_t rotated = samplePixel(srcPx, width, height, rotX, rotY, sampling);
+            out[x] = lerpPixel(zoomed, rotated, blendWeight);
+
+            zoomX += zoomStepX;
+            rotX += rotStepX;
+            rotY += rotStepY;
+        }
+    }
+}
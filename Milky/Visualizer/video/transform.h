@@ -12,7 +12,131 @@
 #include <arm_neon.h>
 #endif
 
-void rotate(float timeFrame, uint8_t *tempBuffer, uint8_t *screen, float speed, float angle, size_t width, size_t height);
+#include "../random.h"
+
+// sampling filters supported by the fused feedback warp
+typedef enum {
+    MILKY_WARP_SAMPLE_NEAREST = 0,
+    MILKY_WARP_SAMPLE_BILINEAR = 1
+} MilkyWarpSampling;
+
+/**
+ * Linearly interpolates two packed RGBA pixels, two channels at a time (SWAR).
+ * Each 8-bit channel is widened into a 16-bit lane, so a weight of 0..256 never overflows.
+ *
+ * @param a The pixel returned for weight 0.
+ * @param b The pixel returned for weight 256.
+ * @param w The weight of `b` in 1/256 steps (0..256).
+ * @return  The interpolated pixel.
+ */
+static inline uint32_t lerpPixel(uint32_t a, uint32_t b, uint32_t w) {
+    uint32_t iw = 256 - w;
+    uint32_t rb = (((a & 0x00FF00FFu) * iw + (b & 0x00FF00FFu) * w) >> 8) & 0x00FF00FFu;
+    uint32_t ga = ((((a >> 8) & 0x00FF00FFu) * iw + ((b >> 8) & 0x00FF00FFu) * w)) & 0xFF00FF00u;
+    return rb | ga;
+}
+
+/**
+ * Fetches one pixel at a 16.16 fixed-point source position.
+ * Positions outside of the frame yield a fully transparent black pixel, just like the
+ * cleared temporary buffers of `rotate()` and `scale()` did.
+ *
+ * @param src      The source frame (packed RGBA pixels).
+ * @param width    The width of the frame in pixels.
+ * @param height   The height of the frame in pixels.
+ * @param fx       The x-coordinate in 16.16 fixed point.
+ * @param fy       The y-coordinate in 16.16 fixed point.
+ * @param sampling Nearest-neighbour or bilinear sampling.
+ * @return         The sampled pixel.
+ */
+static inline uint32_t samplePixel(const uint32_t *src, size_t width, size_t height, int32_t fx, int32_t fy, MilkyWarpSampling sampling) {
+    if (sampling == MILKY_WARP_SAMPLE_NEAREST) {
+        int32_t xi = (fx + 0x8000) >> 16;
+        int32_t yi = (fy + 0x8000) >> 16;
+        if ((uint32_t)xi >= (uint32_t)width || (uint32_t)yi >= (uint32_t)height) return 0;
+        return src[(size_t)yi * width + xi];
+    }
+
+    int32_t xi = fx >> 16;
+    int32_t yi = fy >> 16;
+    if (xi < -1 || yi < -1 || xi >= (int32_t)width || yi >= (int32_t)height) return 0;
+
+    // clamp the 2x2 footprint to the frame so edge pixels stay defined
+    int32_t x0 = xi < 0 ? 0 : xi;
+    int32_t y0 = yi < 0 ? 0 : yi;
+    int32_t x1 = xi + 1 >= (int32_t)width ? (int32_t)width - 1 : xi + 1;
+    int32_t y1 = yi + 1 >= (int32_t)height ? (int32_t)height - 1 : yi + 1;
+    uint32_t wx = (fx >> 8) & 0xFF;
+    uint32_t wy = (fy >> 8) & 0xFF;
+
+    const uint32_t *row0 = src + (size_t)y0 * width;
+    const uint32_t *row1 = src + (size_t)y1 * width;
+    uint32_t top = lerpPixel(row0[x0], row0[x1], wx);
+    uint32_t bottom = lerpPixel(row1[x0], row1[x1], wx);
+    return lerpPixel(top, bottom, wy);
+}
+
+/**
+ * Linearly interpolates two 8-bit intensities; matches one channel of `lerpPixel()`.
+ *
+ * @param a The intensity returned for weight 0.
+ * @param b The intensity returned for weight 256.
+ * @param w The weight of `b` in 1/256 steps (0..256).
+ * @return  The interpolated intensity.
+ */
+static inline uint8_t lerpIntensity(uint32_t a, uint32_t b, uint32_t w) {
+    return (uint8_t)((a * (256 - w) + b * w) >> 8);
+}
+
+/**
+ * Fetches one intensity of an 8-bit plane at a 16.16 fixed-point source position;
+ * the single-channel counterpart of `samplePixel()`.
+ *
+ * @param src      The source plane (one byte per pixel).
+ * @param width    The width of the plane in pixels.
+ * @param height   The height of the plane in pixels.
+ * @param fx       The x-coordinate in 16.16 fixed point.
+ * @param fy       The y-coordinate in 16.16 fixed point.
+ * @param sampling Nearest-neighbour or bilinear sampling.
+ * @return         The sampled intensity, 0 outside of the plane.
+ */
+static inline uint8_t sampleIntensity(const uint8_t *src, size_t width, size_t height, int32_t fx, int32_t fy, MilkyWarpSampling sampling) {
+    if (sampling == MILKY_WARP_SAMPLE_NEAREST) {
+        int32_t xi = (fx + 0x8000) >> 16;
+        int32_t yi = (fy + 0x8000) >> 16;
+        if ((uint32_t)xi >= (uint32_t)width || (uint32_t)yi >= (uint32_t)height) return 0;
+        return src[(size_t)yi * width + xi];
+    }
+
+    int32_t xi = fx >> 16;
+    int32_t yi = fy >> 16;
+    if (xi < -1 || yi < -1 || xi >= (int32_t)width || yi >= (int32_t)height) return 0;
+
+    int32_t x0 = xi < 0 ? 0 : xi;
+    int32_t y0 = yi < 0 ? 0 : yi;
+    int32_t x1 = xi + 1 >= (int32_t)width ? (int32_t)width - 1 : xi + 1;
+    int32_t y1 = yi + 1 >= (int32_t)height ? (int32_t)height - 1 : yi + 1;
+    uint32_t wx = (fx >> 8) & 0xFF;
+    uint32_t wy = (fy >> 8) & 0xFF;
+
+    const uint8_t *row0 = src + (size_t)y0 * width;
+    const uint8_t *row1 = src + (size_t)y1 * width;
+    uint8_t top = lerpIntensity(row0[x0], row0[x1], wx);
+    uint8_t bottom = lerpIntensity(row1[x0], row1[x1], wx);
+    return lerpIntensity(top, bottom, wy);
+}
+
+// easing state of the feedback rotation angle
+typedef struct {
+    float lastTheta;   // angle of the previous frame
+    float targetTheta; // angle the rotation eases towards
+    MilkyRandom random; // picks the target angles
+} MilkyRotationState;
+
+float nextRotationTheta(MilkyRotationState *state);
+void warpAffine(const uint8_t *src, uint8_t *dst, size_t width, size_t height, float theta, float zoom, float blend, MilkyWarpSampling sampling);
+
+void rotate(MilkyRotationState *state, uint8_t *tempBuffer, uint8_t *screen, size_t width, size_t height);
 
 void scale(
     unsigned char *screen,     // Frame buffer (RGBA format)
@@ -0,0 +1,215 @@
+#include "workers.h"
+
+/*
+ Persistent worker pool for the band-parallel render pipeline.
+
+ Every full-frame stage is split into horizontal bands of rows. The workers sleep on a
+ condition variable between stages; `runRowBands()` wakes them, takes part in the work
+ itself and returns once every band is done, which doubles as the barrier between stages.
+ Bands are claimed dynamically, so a slow core does not hold up the whole frame.
+ Each render context owns its own pool, so independent visualizers never share workers.
+*/
+
+/**
+ * Initializes an empty pool; the worker threads are started on first use.
+ *
+ * @param pool The pool to initialize.
+ */
+void initWorkerPool(MilkyWorkerPool *pool) {
+    memset(pool, 0, sizeof(MilkyWorkerPool));
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+}
+
+/**
+ * Stops the workers of a pool and releases its synchronization primitives.
+ *
+ * @param pool The pool to destroy.
+ */
+void destroyWorkerPool(MilkyWorkerPool *pool) {
+    stopWorkerPool(pool);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+}
+
+/**
+ * Claims and processes bands of the current stage until none are left.
+ *
+ * @param pool The pool whose stage is processed.
+ */
+static void drainBands(MilkyWorkerPool *pool) {
+    for (;;) {
+        size_t band = __sync_fetch_and_add(&pool->nextBand, 1);
+        if (band >= pool->bandCount) return;
+
+        size_t firstRow = band * pool->bandRows;
+        size_t lastRow = firstRow + pool->bandRows;
+        if (lastRow > pool->rowCount) lastRow = pool->rowCount;
+        pool->job(pool->context, firstRow, lastRow);
+    }
+}
+
+/**
+ * Main loop of a worker thread: waits for the next stage, helps processing it,
+ * reports completion and goes back to sleep.
+ */
+static void *workerLoop(void *arg) {
+    MilkyWorkerPool *pool = (MilkyWorkerPool *)arg;
+
+    pthread_mutex_lock(&pool->mutex);
+    // stages dispatched after the workers were started are picked up
+    size_t seenGeneration = pool->spawnGeneration;
+    for (;;) {
+        while (pool->generation == seenGeneration && !pool->shutdown) {
+            pthread_cond_wait(&pool->wake, &pool->mutex);
+        }
+        if (pool->shutdown) break;
+        seenGeneration = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        drainBands(pool);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+/**
+ * Resolves the configured thread count, 0 meaning one thread per online core.
+ *
+ * @param pool The pool to inspect.
+ * @return     The number of threads to render with, including the calling thread.
+ */
+static size_t resolveThreadCount(const MilkyWorkerPool *pool) {
+    size_t count = pool->requestedThreads;
+    if (count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cores > 0 ? (size_t)cores : 1;
+    }
+    return count > MILKY_WORKERS_MAX_THREADS ? MILKY_WORKERS_MAX_THREADS : count;
+}
+
+/**
+ * Resolves the thread count and starts the worker threads.
+ * The calling thread always takes part, so `threads - 1` workers are started.
+ *
+ * @param pool The pool to start.
+ */
+static void startWorkers(MilkyWorkerPool *pool) {
+    pool->threadCount = resolveThreadCount(pool);
+    pool->shutdown = 0;
+    pool->spawnGeneration = pool->generation;
+
+    for (size_t i = 0; i + 1 < pool->threadCount; i++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+#ifdef __APPLE__
+        // match the render thread's QoS so the workers land on performance cores
+        pthread_attr_set_qos_class_np(&attr, QOS_CLASS_USER_INTERACTIVE, 0);
+#endif
+        if (pthread_create(&pool->threads[i], &attr, workerLoop, pool) != 0) {
+            fprintf(stderr, "Failed to create render worker %zu\n", i);
+            pthread_attr_destroy(&attr);
+            break;
+        }
+        pthread_attr_destroy(&attr);
+        pool->running++;
+    }
+}
+
+/**
+ * Stops and joins all worker threads. They are restarted on the next `runRowBands()`.
+ *
+ * @param pool The pool to stop.
+ */
+void stopWorkerPool(MilkyWorkerPool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (size_t i = 0; i < pool->running; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pool->running = 0;
+    pool->threadCount = 0;
+}
+
+/**
+ * Sets the number of threads the pool runs stages on (including the calling thread).
+ * 0 selects one thread per online core, 1 runs single-threaded.
+ * Must not be called while a stage is running.
+ *
+ * @param pool        The pool to configure.
+ * @param threadCount The number of threads.
+ */
+void setWorkerPoolThreadCount(MilkyWorkerPool *pool, size_t threadCount) {
+    stopWorkerPool(pool);
+    pool->requestedThreads = threadCount;
+}
+
+/**
+ * Returns the number of threads the pool runs stages on.
+ *
+ * @param pool The pool to inspect.
+ * @return     The number of threads, including the calling thread.
+ */
+size_t getWorkerPoolThreadCount(const MilkyWorkerPool *pool) {
+    return pool->threadCount ? pool->threadCount : resolveThreadCount(pool);
+}
+
+/**
+ * Runs one pipeline stage over all rows of a frame, split into horizontal bands.
+ * The calling thread processes bands as well and the function returns only once all
+ * bands are done, so consecutive calls are separated by a barrier.
+ *
+ * @param pool     The pool to run the stage on.
+ * @param job      The stage to run; called once per band.
+ * @param context  Passed through to `job`.
+ * @param rowCount The number of rows of the frame.
+ */
+void runRowBands(MilkyWorkerPool *pool, MilkyRowJob job, void *context, size_t rowCount) {
+    if (rowCount < MILKY_WORKERS_MIN_ROWS) {
+        job(context, 0, rowCount);
+        return;
+    }
+
+    // the thread count is resolved once per start, not on every stage
+    if (pool->threadCount == 0) {
+        startWorkers(pool);
+    }
+    if (pool->running == 0) {
+        job(context, 0, rowCount);
+        return;
+    }
+
+    size_t bandCount = (pool->running + 1) * MILKY_WORKERS_BANDS_PER_THREAD;
+    if (bandCount > rowCount) bandCount = rowCount;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->job = job;
+    pool->context = context;
+    pool->rowCount = rowCount;
+    pool->bandRows = (rowCount + bandCount - 1) / bandCount;
+    pool->bandCount = (rowCount + pool->bandRows - 1) / pool->bandRows;
+    pool->nextBand = 0;
+    pool->pending = pool->running;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    drainBands(pool);
+
+    // barrier: wait for the workers to finish their last bands
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,55 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// upper bound for the number of render threads (including the calling thread)
+#define MILKY_WORKERS_MAX_THREADS 64
+
+// number of bands handed out per thread, so uneven bands balance out
+#define MILKY_WORKERS_BANDS_PER_THREAD 4
+
+// frames smaller than this many rows are processed on the calling thread only
+#define MILKY_WORKERS_MIN_ROWS 64
+
+// a stage of the render pipeline, processing the rows [firstRow, lastRow)
+typedef void (*MilkyRowJob)(void *context, size_t firstRow, size_t lastRow);
+
+// persistent pool of render workers, one per render context
+typedef struct {
+    pthread_t threads[MILKY_WORKERS_MAX_THREADS];
+    size_t running;           // number of started worker threads
+    size_t requestedThreads;  // 0 = one thread per online core
+    size_t threadCount;       // threads resolved when the workers were started, 0 = not started
+    size_t spawnGeneration;   // generation current when the workers were started
+    int shutdown;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+
+    // the stage currently being processed
+    MilkyRowJob job;
+    void *context;
+    size_t rowCount;
+    size_t bandRows;
+    size_t bandCount;
+    volatile size_t nextBand;
+    size_t generation;
+    size_t pending;
+} MilkyWorkerPool;
+
+void initWorkerPool(MilkyWorkerPool *pool);
+void destroyWorkerPool(MilkyWorkerPool *pool);
+void setWorkerPoolThreadCount(MilkyWorkerPool *pool, size_t threadCount);
+size_t getWorkerPoolThreadCount(const MilkyWorkerPool *pool);
+void runRowBands(MilkyWorkerPool *pool, MilkyRowJob job, void *context, size_t rowCount);
+void stopWorkerPool(MilkyWorkerPool *pool);
+
+#endif // WORKERS_H